@@ -0,0 +1,1535 @@
+/* ============================================================================
+ * BENCHMARKS
+ * 1. Heap: compares the binary MinHeap with 4-ary and 8-ary layouts on the
+ *    operations the balancer performs: per-task replaceTop and rebalance-time
+ *    updateHeap.
+ * 2. Assignment modes: rebalances and migrated load of ASSIGN_BY_LOAD vs
+ *    ASSIGN_BY_UTILIZATION on identical fleets and task streams.
+ * 3. Rebalance modes: single-pair vs multi-pair vs topology-aware migration,
+ *    including the load x hops cost of topology-constrained migration,
+ *    after a multi-pair plan check on a fleet with two out-of-band donors
+ *    (a failed check makes the run exit with status 1).
+ * 4. Throughput: tasks/sec, p50/p99/p999 per-assignment latency and
+ *    rebalance pass cost across server counts and task-load distributions,
+ *    plus end-to-end simulateTaskAssignment throughput.
+ * 5. Sharded: multi-producer throughput of simulateSharded at 1-8 producer
+ *    threads against the single-threaded assignTask loop.
+ * 6. Selection policies: heap vs power-of-d-choices imbalance (max/avg) and
+ *    throughput, single-threaded and with concurrent d-choices producers.
+ * 7. Batch assignment: assignBatch (LPT order) vs one-at-a-time placement,
+ *    packing (max/avg) and throughput by batch size and tasks per server.
+ * 8. Instance allocation: construction + teardown time of a whole balancer
+ *    instance (table, topology, heap, task table) with malloc vs an Arena.
+ * 9. Random numbers: task loads per second from rand() vs the per-thread
+ *    Rng (single draws and rngFillUniform), on 1 and 4 threads.
+ * 10. Imbalance tracking: cost of a rebalance check that finds the fleet
+ *    balanced (full scan vs ImbalanceTracker), and task throughput with the
+ *    tracked single-pair check after every task.
+ * 11. Trace capture and replay: binary trace write rate, streaming read rate
+ *    of the memory-mapped reader, and simulateTaskAssignment throughput
+ *    replaying a trace vs generating the same tasks.
+ * 12. Multi-resource loads: rebalance check cost of the scalar load scan vs
+ *    the 3-dimension dominant-share scan, and simulateTaskAssignment
+ *    throughput with scalar utilization keys vs vector dominant-share keys.
+ * 13. Hierarchical balancer: steady-state simulateTaskAssignment throughput
+ *    and max/avg load of the flat heap (with an ImbalanceTracker) vs the
+ *    two-level rack hierarchy.
+ * 14. Snapshot and restore: time to build a fresh instance (n inserts and a
+ *    new topology) vs restoring a saved one with its heap copied or rebuilt
+ *    by Floyd's buildHeap, plus the snapshot write time and size.
+ * 15. Specialized heaps: replaceTop / update cost of MinHeap vs the
+ *    heap_template.h heaps at arity 4 - float keys with the comparator
+ *    inlined or called through a function pointer, and a struct key with
+ *    a tie-break.
+ *
+ * Build: gcc -O2 -pthread -o benchmark benchmark.c -lm
+ * Usage: ./benchmark [--json FILE] [--label TEXT] [--throughput-only]
+ *        --json writes every result row as one JSON document for tracking
+ *        across versions; --label tags that document (e.g. a git revision).
+ *        --throughput-only runs sections 4 and 5 alone.
+ * ============================================================================ */
+#define _POSIX_C_SOURCE 200112L
+#ifndef LOAD_BALANCER_METRICS
+#define LOAD_BALANCER_METRICS 0   // Time the bare hot path; -DLOAD_BALANCER_METRICS=1 to include
+#endif
+#include "load_balancer.c"
+#include "heap_template.h"
+
+#include <unistd.h>
+
+#define BENCH_OPERATIONS 2000000
+#define BENCH_SEED 12345
+#define BENCH_TASKS 1000000       // Tasks per throughput configuration
+#define JSON_SCHEMA_VERSION 1
+
+/* Task-load distributions for the throughput sweep */
+typedef enum {
+    DIST_UNIFORM,   // MIN_TASK_LOAD .. MAX_TASK_LOAD, as in the simulation
+    DIST_BIMODAL,   // 90% small tasks, 10% tasks ~4x MAX_TASK_LOAD
+    DIST_PARETO     // Heavy tail: Pareto(alpha = 1.5) from MIN_TASK_LOAD
+} TaskDistribution;
+
+static const char* distributionNames[] = {"uniform", "bimodal", "pareto"};
+
+/* Machine-readable output (NULL = text tables only) */
+static FILE* jsonOut = NULL;
+static int jsonRecords = 0;
+
+/* Monotonic wall-clock time in nanoseconds */
+static double nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/* Start one JSON result object; the caller prints fields, then jsonEnd */
+static void jsonBegin(const char* bench) {
+    if (jsonOut) {
+        fprintf(jsonOut, "%s\n    {\"bench\": \"%s\"", jsonRecords ? "," : "", bench);
+        jsonRecords++;
+    }
+}
+
+static void jsonEnd(void) {
+    if (jsonOut) {
+        fprintf(jsonOut, "}");
+    }
+}
+
+/* Close the JSON document, if one is open; returns the exit code */
+static int finishJson(void) {
+    if (jsonOut) {
+        fprintf(jsonOut, "\n  ]\n}\n");
+        fclose(jsonOut);
+    }
+    return 0;
+}
+
+/* Fill a heap with numServers random initial loads
+ * Time Complexity: O(n log n)
+ */
+static MinHeap* buildBenchHeap(int numServers, int arity) {
+    MinHeap* heap = createDaryHeap(numServers, arity);
+    seedThreadRng(BENCH_SEED);
+    for (int i = 0; i < numServers; i++) {
+        insertHeap(heap, i, rngRange(threadRng(), 0.0f, MAX_CAPACITY));
+    }
+    return heap;
+}
+
+/* Time BENCH_OPERATIONS task assignments (peekMin + replaceTop)
+ * Returns nanoseconds per operation.
+ */
+static double benchReplaceTop(int numServers, int arity, const float* taskLoads) {
+    MinHeap* heap = buildBenchHeap(numServers, arity);
+
+    double start = nowNs();
+    for (int op = 0; op < BENCH_OPERATIONS; op++) {
+        HeapNode minServer = peekMin(heap);
+        replaceTop(heap, minServer.load + taskLoads[op]);
+    }
+    double elapsed = nowNs() - start;
+
+    freeMinHeap(heap);
+    return elapsed / BENCH_OPERATIONS;
+}
+
+/* Time BENCH_OPERATIONS random-server key updates (rebalance migrations)
+ * Returns nanoseconds per operation.
+ */
+static double benchUpdateHeap(int numServers, int arity, const int* serverIds,
+                              const float* newLoads) {
+    MinHeap* heap = buildBenchHeap(numServers, arity);
+
+    double start = nowNs();
+    for (int op = 0; op < BENCH_OPERATIONS; op++) {
+        updateHeap(heap, serverIds[op] % numServers, newLoads[op]);
+    }
+    double elapsed = nowNs() - start;
+
+    freeMinHeap(heap);
+    return elapsed / BENCH_OPERATIONS;
+}
+
+/* Random capacities and an empty heap keyed for mode (uses the thread Rng)
+ * Time Complexity: O(n log n)
+ */
+static ServerTable* createBenchFleet(int numServers, AssignmentMode mode,
+                                     MinHeap** heapOut) {
+    ServerTable* servers = createServerTable(numServers);
+    for (int i = 0; i < numServers; i++) {
+        setServerCapacity(servers, i, rngRange(threadRng(), MIN_CAPACITY, MAX_CAPACITY));
+    }
+
+    MinHeap* heap = createDaryHeap(numServers, HEAP_ARITY);
+    for (int i = 0; i < numServers; i++) {
+        insertHeap(heap, i, serverHeapKey(servers, i, mode));
+    }
+    *heapOut = heap;
+    return servers;
+}
+
+/* Run one quiet simulation and return its counters
+ * Seeding before capacities and topology makes every mode see the same
+ * fleet, graph and task-load sequence.
+ */
+static SimulationStats runTrial(int numServers, int numTasks,
+                                AssignmentMode assignmentMode,
+                                RebalanceMode rebalanceMode, unsigned int seed,
+                                float* finalSpread) {
+    SimulationOptions opts = defaultSimulationOptions();
+    SimulationStats stats = {0};
+    opts.assignmentMode = assignmentMode;
+    opts.rebalanceMode = rebalanceMode;
+    opts.logLevel = LOG_QUIET;
+
+    seedThreadRng(seed);
+    MinHeap* heap;
+    ServerTable* servers = createBenchFleet(numServers, assignmentMode, &heap);
+    Graph* graph = generateRandomTopology(numServers);
+
+    simulateTaskAssignment(servers, graph, heap, numTasks, &opts, &stats);
+
+    // Final utilization spread in percentage points
+    float* percentages = (float*)malloc(numServers * sizeof(float));
+    computeLoadPercentages(servers, percentages);
+    LoadScan scan = scanLoadArray(percentages, numServers);
+    *finalSpread = percentages[scan.mostLoaded] - percentages[scan.leastLoaded];
+    free(percentages);
+
+    freeMinHeap(heap);
+    freeGraph(graph);
+    freeServerTable(servers);
+    return stats;
+}
+
+/* Print rebalances and migrated load saved by utilization-keyed assignment */
+static void benchAssignmentModes(void) {
+    // 5 tasks per server ends near the demo's ~50% utilization
+    const int fleets[][2] = {{6, 30}, {100, 500}, {1000, 5000}, {10000, 50000}};
+    const int numFleets = sizeof(fleets) / sizeof(fleets[0]);
+    const int trials = 20;
+
+    printf("\n--- Assignment Mode Comparison (%d seeds each, totals) ---\n", trials);
+    printf("%8s %8s %-12s %11s %14s %12s\n",
+           "servers", "tasks", "mode", "rebalances", "migrated", "avg spread%");
+
+    for (int f = 0; f < numFleets; f++) {
+        SimulationStats totals[2] = {{0}, {0}};
+        float spreads[2] = {0.0f, 0.0f};
+
+        for (int m = 0; m < 2; m++) {
+            AssignmentMode mode = (m == 0) ? ASSIGN_BY_LOAD : ASSIGN_BY_UTILIZATION;
+            for (int t = 0; t < trials; t++) {
+                float spread;
+                SimulationStats st = runTrial(fleets[f][0], fleets[f][1], mode,
+                                              REBALANCE_SINGLE_PAIR,
+                                              BENCH_SEED + t, &spread);
+                totals[m].rebalances += st.rebalances;
+                totals[m].migratedLoad += st.migratedLoad;
+                spreads[m] += spread;
+            }
+            printf("%8d %8d %-12s %11d %14.2f %12.2f\n",
+                   fleets[f][0], fleets[f][1], m == 0 ? "load" : "utilization",
+                   totals[m].rebalances, totals[m].migratedLoad,
+                   spreads[m] / trials);
+        }
+
+        printf("%8s %8s %-12s %11d %14.2f\n", "", "", "saved",
+               totals[0].rebalances - totals[1].rebalances,
+               totals[0].migratedLoad - totals[1].migratedLoad);
+    }
+}
+
+/* One multi-pair plan on a fleet with two out-of-band donors
+ * Loads {100, 90, 5, 45 x 8} at capacity 100, threshold 20: the first
+ * migration fills server 2 and leaves both list heads in band, but server 1
+ * (90%) still has to donate. Returns 0 if the applied plan brings the
+ * spread within the threshold, 1 otherwise.
+ */
+static int checkMultiDonorPlan(void) {
+    const float loads[] = {100.0f, 90.0f, 5.0f, 45.0f, 45.0f, 45.0f, 45.0f,
+                           45.0f, 45.0f, 45.0f, 45.0f};
+    const int n = sizeof(loads) / sizeof(loads[0]);
+    const float threshold = 20.0f;
+
+    ServerTable* servers = createServerTable(n);
+    MinHeap* heap = createDaryHeap(n, HEAP_ARITY);
+    for (int i = 0; i < n; i++) {
+        setServerCapacity(servers, i, 100.0f);
+        servers->currentLoad[i] = loads[i];
+        insertHeap(heap, i, loads[i]);
+    }
+    RebalancePlan* plan = createRebalancePlan(n);
+    planRebalance(servers, threshold, plan);
+    int migrations = plan->numMigrations;
+    applyRebalancePlan(servers, heap, plan, ASSIGN_BY_LOAD);
+
+    LoadScan scan = scanServerTable(servers);
+    float spread = getServerLoadPercentage(servers, scan.mostLoaded) -
+                   getServerLoadPercentage(servers, scan.leastLoaded);
+    printf("multi-donor plan: %d migrations, spread 95.00%% -> %.2f%% "
+           "(threshold %.0f%%) %s\n", migrations, spread, threshold,
+           spread <= threshold ? "ok" : "FAILED");
+
+    freeRebalancePlan(plan);
+    freeMinHeap(heap);
+    freeServerTable(servers);
+    return spread <= threshold ? 0 : 1;
+}
+
+/* Compare the rebalancing engines under absolute-load assignment
+ * Returns 1 if the multi-donor plan check failed.
+ */
+static int benchRebalanceModes(void) {
+    const int fleets[][2] = {{100, 500}, {1000, 5000}, {10000, 50000}};
+    const int numFleets = sizeof(fleets) / sizeof(fleets[0]);
+    const RebalanceMode modes[] = {REBALANCE_SINGLE_PAIR, REBALANCE_MULTI_PAIR,
+                                   REBALANCE_TOPOLOGY};
+    const char* names[] = {"single-pair", "multi-pair", "topology"};
+    const int trials = 5;
+
+    printf("\n--- Rebalance Mode Comparison (%d seeds each, totals) ---\n", trials);
+    int failed = checkMultiDonorPlan();
+    printf("%8s %8s %-12s %11s %14s %12s %14s\n", "servers", "tasks", "mode",
+           "rebalances", "migrated", "avg spread%", "hop cost");
+
+    for (int f = 0; f < numFleets; f++) {
+        for (int m = 0; m < 3; m++) {
+            SimulationStats totals = {0};
+            float spreads = 0.0f;
+            for (int t = 0; t < trials; t++) {
+                float spread;
+                SimulationStats st = runTrial(fleets[f][0], fleets[f][1],
+                                              ASSIGN_BY_LOAD, modes[m],
+                                              BENCH_SEED + t, &spread);
+                totals.rebalances += st.rebalances;
+                totals.migratedLoad += st.migratedLoad;
+                totals.migrationHopCost += st.migrationHopCost;
+                spreads += spread;
+            }
+            printf("%8d %8d %-12s %11d %14.2f %12.2f ",
+                   fleets[f][0], fleets[f][1], names[m], totals.rebalances,
+                   totals.migratedLoad, spreads / trials);
+            // Only topology mode routes migrations over the graph
+            if (modes[m] == REBALANCE_TOPOLOGY) {
+                printf("%14.2f\n", totals.migrationHopCost);
+            } else {
+                printf("%14s\n", "n/a");
+            }
+        }
+    }
+    return failed;
+}
+
+/* Generate numTasks task loads from the given distribution
+ * Time Complexity: O(numTasks)
+ */
+static void fillTaskLoads(float* loads, int numTasks, TaskDistribution dist,
+                          unsigned int seed) {
+    seedThreadRng(seed);
+    Rng* rng = threadRng();
+    for (int t = 0; t < numTasks; t++) {
+        double u = rngUniform(rng);
+        switch (dist) {
+            case DIST_BIMODAL:
+                loads[t] = (rngBelow(rng, 10) == 0)
+                               ? (float)(4.0 * MAX_TASK_LOAD * (0.75 + 0.5 * u))
+                               : (float)(MIN_TASK_LOAD * (1.0 + 0.4 * u));
+                break;
+            case DIST_PARETO:
+                // Inverse CDF; cap the tail at 100x the mean uniform task
+                loads[t] = (float)(MIN_TASK_LOAD / pow(1.0 - u * 0.999999, 1.0 / 1.5));
+                if (loads[t] > 100.0f * MAX_TASK_LOAD) {
+                    loads[t] = 100.0f * MAX_TASK_LOAD;
+                }
+                break;
+            default:
+                loads[t] = (float)(MIN_TASK_LOAD + u * (MAX_TASK_LOAD - MIN_TASK_LOAD));
+                break;
+        }
+    }
+}
+
+static int compareFloats(const void* a, const void* b) {
+    float x = *(const float*)a;
+    float y = *(const float*)b;
+    return (x > y) - (x < y);
+}
+
+/* q-quantile of a sorted sample (nearest rank) */
+static double quantile(const float* sorted, int count, double q) {
+    if (count == 0) {
+        return 0.0;
+    }
+    int rank = (int)ceil(q * count) - 1;
+    if (rank < 0) rank = 0;
+    if (rank >= count) rank = count - 1;
+    return sorted[rank];
+}
+
+/* Median cost of one nowNs() pair, subtracted from latency samples */
+static double timerOverheadNs(void) {
+    enum { SAMPLES = 10001 };
+    static float deltas[SAMPLES];
+    for (int k = 0; k < SAMPLES; k++) {
+        double start = nowNs();
+        deltas[k] = (float)(nowNs() - start);
+    }
+    qsort(deltas, SAMPLES, sizeof(float), compareFloats);
+    return deltas[SAMPLES / 2];
+}
+
+/* Assignment throughput, per-assignment latency and rebalance pass cost
+ * Two runs over the same fleet and task stream: an untimed-per-task run
+ * for tasks/sec (rebalances included) and a run that timestamps every
+ * assignTask call and every rebalancePass separately. One single-pair
+ * rebalance pass runs per numServers tasks, so its O(n) scan stays O(1)
+ * amortized per task at every fleet size.
+ */
+static void benchThroughputConfig(int numServers, TaskDistribution dist,
+                                  const float* taskLoads, float* latencies,
+                                  float* passTimes, double timerNs) {
+    SimulationOptions opts = defaultSimulationOptions();
+    opts.logLevel = LOG_QUIET;
+    opts.rebalanceInterval = (numServers > REBALANCE_INTERVAL) ? numServers
+                                                               : REBALANCE_INTERVAL;
+
+    // Run 1: wall-clock throughput
+    seedThreadRng(BENCH_SEED);
+    MinHeap* heap;
+    ServerTable* servers = createBenchFleet(numServers, opts.assignmentMode, &heap);
+    double start = nowNs();
+    for (int t = 1; t <= BENCH_TASKS; t++) {
+        assignTask(servers, heap, taskLoads[t - 1], &opts);
+        if (t % opts.rebalanceInterval == 0) {
+            rebalancePass(servers, NULL, heap, NULL, NULL, &opts, NULL);
+        }
+    }
+    double tasksPerSec = BENCH_TASKS / ((nowNs() - start) * 1e-9);
+    freeMinHeap(heap);
+    freeServerTable(servers);
+
+    // Run 2: per-assignment and per-pass latency
+    seedThreadRng(BENCH_SEED);
+    servers = createBenchFleet(numServers, opts.assignmentMode, &heap);
+    int passes = 0;
+    int migratingPasses = 0;
+    double migrated = 0.0;
+    for (int t = 1; t <= BENCH_TASKS; t++) {
+        double t0 = nowNs();
+        assignTask(servers, heap, taskLoads[t - 1], &opts);
+        double elapsed = nowNs() - t0 - timerNs;
+        latencies[t - 1] = (elapsed > 0.0) ? (float)elapsed : 0.0f;
+
+        if (t % opts.rebalanceInterval == 0) {
+            t0 = nowNs();
+            float amount = rebalancePass(servers, NULL, heap, NULL, NULL, &opts, NULL);
+            passTimes[passes++] = (float)(nowNs() - t0);
+            if (amount > 0.0f) {
+                migratingPasses++;
+                migrated += amount;
+            }
+        }
+    }
+    freeMinHeap(heap);
+    freeServerTable(servers);
+
+    qsort(latencies, BENCH_TASKS, sizeof(float), compareFloats);
+    double passTotal = 0.0;
+    for (int k = 0; k < passes; k++) {
+        passTotal += passTimes[k];
+    }
+    qsort(passTimes, passes, sizeof(float), compareFloats);
+
+    double p50 = quantile(latencies, BENCH_TASKS, 0.50);
+    double p99 = quantile(latencies, BENCH_TASKS, 0.99);
+    double p999 = quantile(latencies, BENCH_TASKS, 0.999);
+    double passMeanUs = passes ? passTotal / passes * 1e-3 : 0.0;
+    double passP99Us = quantile(passTimes, passes, 0.99) * 1e-3;
+
+    printf("%8d %-8s %12.0f %8.1f %8.1f %8.1f %7d %7d %10.2f %10.2f %10.2f\n",
+           numServers, distributionNames[dist], tasksPerSec, p50, p99, p999,
+           passes, migratingPasses, passMeanUs, passP99Us, migrated);
+
+    jsonBegin("throughput");
+    if (jsonOut) {
+        fprintf(jsonOut, ", \"servers\": %d, \"distribution\": \"%s\", "
+                "\"tasks\": %d, \"tasksPerSec\": %.0f, \"p50Ns\": %.1f, "
+                "\"p99Ns\": %.1f, \"p999Ns\": %.1f, \"rebalancePasses\": %d, "
+                "\"migratingPasses\": %d, \"rebalanceMeanUs\": %.3f, "
+                "\"rebalanceP99Us\": %.3f, \"migratedLoad\": %.2f",
+                numServers, distributionNames[dist], BENCH_TASKS, tasksPerSec,
+                p50, p99, p999, passes, migratingPasses, passMeanUs, passP99Us,
+                migrated);
+    }
+    jsonEnd();
+}
+
+/* Sweep server counts x task distributions, then time the full
+ * simulateTaskAssignment loop (its own uniform task generator included)
+ */
+static void benchThroughput(void) {
+    const int serverCounts[] = {100, 1000, 10000, 100000};
+    const int numCounts = sizeof(serverCounts) / sizeof(serverCounts[0]);
+    const int numDists = sizeof(distributionNames) / sizeof(distributionNames[0]);
+
+    float* taskLoads = (float*)malloc(BENCH_TASKS * sizeof(float));
+    float* latencies = (float*)malloc(BENCH_TASKS * sizeof(float));
+    float* passTimes = (float*)malloc(BENCH_TASKS * sizeof(float));
+    double timerNs = timerOverheadNs();
+
+    printf("\n--- Assignment Throughput (%d tasks, latency ns, timer overhead "
+           "%.1f ns subtracted) ---\n", BENCH_TASKS, timerNs);
+    printf("%8s %-8s %12s %8s %8s %8s %7s %7s %10s %10s %10s\n",
+           "servers", "dist", "tasks/s", "p50", "p99", "p999", "passes",
+           "moved", "pass us", "pass p99", "migrated");
+
+    for (int c = 0; c < numCounts; c++) {
+        for (int d = 0; d < numDists; d++) {
+            fillTaskLoads(taskLoads, BENCH_TASKS, (TaskDistribution)d, BENCH_SEED + d);
+            benchThroughputConfig(serverCounts[c], (TaskDistribution)d, taskLoads,
+                                  latencies, passTimes, timerNs);
+        }
+    }
+
+    printf("\n--- simulateTaskAssignment End-to-End (%d tasks, interval %d) ---\n",
+           BENCH_TASKS, REBALANCE_INTERVAL);
+    printf("%8s %12s %11s %14s\n", "servers", "tasks/s", "rebalances", "migrated");
+
+    for (int c = 0; c < numCounts && serverCounts[c] <= 10000; c++) {
+        SimulationOptions opts = defaultSimulationOptions();
+        SimulationStats stats = {0};
+        opts.logLevel = LOG_QUIET;
+
+        seedThreadRng(BENCH_SEED);
+        MinHeap* heap;
+        ServerTable* servers = createBenchFleet(serverCounts[c], opts.assignmentMode,
+                                                &heap);
+        double start = nowNs();
+        simulateTaskAssignment(servers, NULL, heap, BENCH_TASKS, &opts, &stats);
+        double tasksPerSec = BENCH_TASKS / ((nowNs() - start) * 1e-9);
+        freeMinHeap(heap);
+        freeServerTable(servers);
+
+        printf("%8d %12.0f %11d %14.2f\n", serverCounts[c], tasksPerSec,
+               stats.rebalances, stats.migratedLoad);
+        jsonBegin("simulate");
+        if (jsonOut) {
+            fprintf(jsonOut, ", \"servers\": %d, \"tasks\": %d, \"interval\": %d, "
+                    "\"tasksPerSec\": %.0f, \"rebalances\": %d, \"migratedLoad\": %.2f",
+                    serverCounts[c], BENCH_TASKS, REBALANCE_INTERVAL, tasksPerSec,
+                    stats.rebalances, stats.migratedLoad);
+        }
+        jsonEnd();
+    }
+
+    free(taskLoads);
+    free(latencies);
+    free(passTimes);
+}
+
+/* Producer-thread scaling of the sharded balancer */
+static void benchSharded(void) {
+    const int numServers = 100000;
+    const int numTasks = 4 * BENCH_TASKS;
+    const int threadCounts[] = {1, 2, 4, 8};
+    const int numCounts = sizeof(threadCounts) / sizeof(threadCounts[0]);
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+    SimulationOptions opts = defaultSimulationOptions();
+    opts.logLevel = LOG_QUIET;
+
+    // Single-threaded reference: one global heap, no locks
+    float* taskLoads = (float*)malloc(numTasks * sizeof(float));
+    fillTaskLoads(taskLoads, numTasks, DIST_UNIFORM, BENCH_SEED);
+    seedThreadRng(BENCH_SEED);
+    MinHeap* heap;
+    ServerTable* servers = createBenchFleet(numServers, opts.assignmentMode, &heap);
+    double start = nowNs();
+    for (int t = 0; t < numTasks; t++) {
+        assignTask(servers, heap, taskLoads[t], &opts);
+    }
+    double baseline = numTasks / ((nowNs() - start) * 1e-9);
+    freeMinHeap(heap);
+    freeServerTable(servers);
+    free(taskLoads);
+
+    printf("\n--- Sharded Multi-Producer Throughput (%d servers, %d tasks, "
+           "%ld cores online) ---\n", numServers, numTasks, cores);
+    printf("%8s %7s %12s %9s %11s\n", "threads", "shards", "tasks/s", "speedup",
+           "rebalances");
+    printf("%8s %7s %12.0f %9s %11s\n", "1 (heap)", "-", baseline, "1.00", "-");
+
+    for (int c = 0; c < numCounts; c++) {
+        int threads = threadCounts[c];
+        SimulationStats stats = {0};
+        seedThreadRng(BENCH_SEED);
+        servers = createBenchFleet(numServers, opts.assignmentMode, &heap);
+        freeMinHeap(heap);
+
+        double seconds = simulateSharded(servers, numTasks, threads, 0, &opts, &stats);
+        double tasksPerSec = numTasks / seconds;
+        freeServerTable(servers);
+
+        printf("%8d %7d %12.0f %9.2f %11d\n", threads, threads * SHARDS_PER_THREAD,
+               tasksPerSec, tasksPerSec / baseline, stats.rebalances);
+        jsonBegin("sharded");
+        if (jsonOut) {
+            fprintf(jsonOut, ", \"servers\": %d, \"tasks\": %d, \"threads\": %d, "
+                    "\"shards\": %d, \"cores\": %ld, \"tasksPerSec\": %.0f, "
+                    "\"baselineTasksPerSec\": %.0f, \"rebalances\": %d",
+                    numServers, numTasks, threads, threads * SHARDS_PER_THREAD,
+                    cores, tasksPerSec, baseline, stats.rebalances);
+        }
+        jsonEnd();
+    }
+}
+
+/* Max/avg load and max/avg utilization of the table, plus utilization spread */
+static void measureImbalance(const ServerTable* servers, double* maxAvgLoad,
+                             double* maxAvgUtil, double* spreadPercent) {
+    int n = servers->numServers;
+    float* percentages = (float*)malloc(n * sizeof(float));
+    computeLoadPercentages(servers, percentages);
+    LoadScan loads = scanServerTable(servers);
+    LoadScan utils = scanLoadArray(percentages, n);
+
+    *maxAvgLoad = servers->currentLoad[loads.mostLoaded] / (loads.totalLoad / n);
+    *maxAvgUtil = percentages[utils.mostLoaded] / (utils.totalLoad / n);
+    *spreadPercent = percentages[utils.mostLoaded] - percentages[utils.leastLoaded];
+    free(percentages);
+}
+
+/* Heap vs power-of-d-choices: placement quality and throughput
+ * Rebalancing is disabled so the numbers reflect selection alone.
+ */
+static void benchSelectionPolicies(void) {
+    const int serverCounts[] = {100, 1000, 10000, 100000};
+    const int numCounts = sizeof(serverCounts) / sizeof(serverCounts[0]);
+    const struct {
+        const char* name;
+        SelectionPolicy policy;
+        AssignmentMode mode;
+        int choices;
+    } policies[] = {
+        {"heap/load", SELECT_HEAP, ASSIGN_BY_LOAD, 0},
+        {"heap/util", SELECT_HEAP, ASSIGN_BY_UTILIZATION, 0},
+        {"d=1", SELECT_D_CHOICES, ASSIGN_BY_LOAD, 1},
+        {"d=2", SELECT_D_CHOICES, ASSIGN_BY_LOAD, 2},
+        {"d=3", SELECT_D_CHOICES, ASSIGN_BY_LOAD, 3},
+        {"d=4", SELECT_D_CHOICES, ASSIGN_BY_LOAD, 4},
+    };
+    const int numPolicies = sizeof(policies) / sizeof(policies[0]);
+
+    printf("\n--- Selection Policy Comparison (%d tasks, no rebalancing) ---\n",
+           BENCH_TASKS);
+    printf("%8s %-10s %12s %12s %12s %10s\n", "servers", "policy", "tasks/s",
+           "max/avg ld", "max/avg util", "spread%");
+
+    for (int c = 0; c < numCounts; c++) {
+        for (int p = 0; p < numPolicies; p++) {
+            SimulationOptions opts = defaultSimulationOptions();
+            opts.logLevel = LOG_QUIET;
+            opts.selectionPolicy = policies[p].policy;
+            opts.assignmentMode = policies[p].mode;
+            opts.choices = policies[p].choices;
+            opts.rebalanceInterval = BENCH_TASKS + 1;
+
+            seedThreadRng(BENCH_SEED);
+            MinHeap* heap;
+            ServerTable* servers = createBenchFleet(serverCounts[c], opts.assignmentMode,
+                                                    &heap);
+            double start = nowNs();
+            simulateTaskAssignment(servers, NULL, heap, BENCH_TASKS, &opts, NULL);
+            double tasksPerSec = BENCH_TASKS / ((nowNs() - start) * 1e-9);
+
+            double maxAvgLoad, maxAvgUtil, spread;
+            measureImbalance(servers, &maxAvgLoad, &maxAvgUtil, &spread);
+            freeMinHeap(heap);
+            freeServerTable(servers);
+
+            printf("%8d %-10s %12.0f %12.3f %12.3f %10.2f\n", serverCounts[c],
+                   policies[p].name, tasksPerSec, maxAvgLoad, maxAvgUtil, spread);
+            jsonBegin("selection");
+            if (jsonOut) {
+                fprintf(jsonOut, ", \"servers\": %d, \"policy\": \"%s\", "
+                        "\"tasks\": %d, \"tasksPerSec\": %.0f, \"maxAvgLoad\": %.4f, "
+                        "\"maxAvgUtil\": %.4f, \"spreadPercent\": %.3f",
+                        serverCounts[c], policies[p].name, BENCH_TASKS, tasksPerSec,
+                        maxAvgLoad, maxAvgUtil, spread);
+            }
+            jsonEnd();
+        }
+    }
+
+    // Concurrent producers: lock-free d-choices vs sharded heaps
+    const int numServers = 100000;
+    const int numTasks = 4 * BENCH_TASKS;
+    const int threadCounts[] = {1, 2, 4, 8};
+    const int numThreadCounts = sizeof(threadCounts) / sizeof(threadCounts[0]);
+
+    printf("\n--- Concurrent d=2 vs Sharded Heaps (%d servers, %d tasks) ---\n",
+           numServers, numTasks);
+    printf("%8s %14s %12s %14s %12s\n", "threads", "d=2 tasks/s", "max/avg util",
+           "shard tasks/s", "max/avg util");
+
+    for (int c = 0; c < numThreadCounts; c++) {
+        double rate[2], util[2];
+        for (int variant = 0; variant < 2; variant++) {
+            SimulationOptions opts = defaultSimulationOptions();
+            opts.logLevel = LOG_QUIET;
+            opts.choices = 2;
+
+            seedThreadRng(BENCH_SEED);
+            MinHeap* heap;
+            ServerTable* servers = createBenchFleet(numServers, opts.assignmentMode, &heap);
+            freeMinHeap(heap);
+            double seconds = (variant == 0)
+                ? simulateDChoices(servers, numTasks, threadCounts[c], &opts, NULL)
+                : simulateSharded(servers, numTasks, threadCounts[c], 0, &opts, NULL);
+            double maxAvgLoad, spread;
+            measureImbalance(servers, &maxAvgLoad, &util[variant], &spread);
+            rate[variant] = numTasks / seconds;
+            freeServerTable(servers);
+        }
+        printf("%8d %14.0f %12.3f %14.0f %12.3f\n", threadCounts[c], rate[0], util[0],
+               rate[1], util[1]);
+        jsonBegin("concurrentSelection");
+        if (jsonOut) {
+            fprintf(jsonOut, ", \"servers\": %d, \"tasks\": %d, \"threads\": %d, "
+                    "\"dChoicesTasksPerSec\": %.0f, \"dChoicesMaxAvgUtil\": %.4f, "
+                    "\"shardedTasksPerSec\": %.0f, \"shardedMaxAvgUtil\": %.4f",
+                    numServers, numTasks, threadCounts[c], rate[0], util[0],
+                    rate[1], util[1]);
+        }
+        jsonEnd();
+    }
+}
+
+static void benchBatchAssignment(void) {
+    const int serverCounts[] = {1000, 100000};
+    const int numCounts = sizeof(serverCounts) / sizeof(serverCounts[0]);
+    const int tasksPerServer[] = {3, 100};
+    const int numDensities = sizeof(tasksPerServer) / sizeof(tasksPerServer[0]);
+    const int batchSizes[] = {1, 64, 256, 1024};
+    const int numBatchSizes = sizeof(batchSizes) / sizeof(batchSizes[0]);
+
+    printf("\n--- Batch Assignment (LPT, no rebalancing) ---\n");
+    printf("%8s %10s %8s %12s %12s %12s\n", "servers", "tasks", "batch", "tasks/s",
+           "max/avg ld", "max/avg util");
+
+    for (int c = 0; c < numCounts; c++) {
+        for (int d = 0; d < numDensities; d++) {
+            int numTasks = serverCounts[c] * tasksPerServer[d];
+            for (int b = 0; b < numBatchSizes; b++) {
+                SimulationOptions opts = defaultSimulationOptions();
+                opts.logLevel = LOG_QUIET;
+                opts.batchSize = batchSizes[b];
+                opts.rebalanceInterval = numTasks + 1;
+
+                seedThreadRng(BENCH_SEED);
+                MinHeap* heap;
+                ServerTable* servers = createBenchFleet(serverCounts[c], opts.assignmentMode,
+                                                        &heap);
+                double start = nowNs();
+                simulateTaskAssignment(servers, NULL, heap, numTasks, &opts, NULL);
+                double tasksPerSec = numTasks / ((nowNs() - start) * 1e-9);
+
+                double maxAvgLoad, maxAvgUtil, spread;
+                measureImbalance(servers, &maxAvgLoad, &maxAvgUtil, &spread);
+                freeMinHeap(heap);
+                freeServerTable(servers);
+
+                printf("%8d %10d %8d %12.0f %12.3f %12.3f\n", serverCounts[c], numTasks,
+                       batchSizes[b], tasksPerSec, maxAvgLoad, maxAvgUtil);
+                jsonBegin("batch");
+                if (jsonOut) {
+                    fprintf(jsonOut, ", \"servers\": %d, \"tasks\": %d, \"batch\": %d, "
+                            "\"tasksPerSec\": %.0f, \"maxAvgLoad\": %.4f, "
+                            "\"maxAvgUtil\": %.4f",
+                            serverCounts[c], numTasks, batchSizes[b], tasksPerSec,
+                            maxAvgLoad, maxAvgUtil);
+                }
+                jsonEnd();
+            }
+        }
+    }
+}
+
+/* Build and tear down one balancer instance, from arena when non-NULL
+ * Time Complexity: O(n log n)
+ */
+static void buildInstance(int numServers, Arena* arena) {
+    ServerTable* servers = createServerTableIn(arena, numServers);
+    for (int i = 0; i < numServers; i++) {
+        setServerCapacity(servers, i, rngRange(threadRng(), MIN_CAPACITY, MAX_CAPACITY));
+    }
+    Graph* graph = generateRandomTopologyIn(arena, numServers);
+    MinHeap* heap = createDaryHeapIn(arena, numServers, HEAP_ARITY);
+    for (int i = 0; i < numServers; i++) {
+        insertHeap(heap, i, servers->currentLoad[i]);
+    }
+    TaskTable* tasks = createTaskTableIn(arena, numServers, numServers);
+
+    if (arena) {
+        resetArena(arena);
+    } else {
+        freeTaskTable(tasks);
+        freeMinHeap(heap);
+        freeGraph(graph);
+        freeServerTable(servers);
+    }
+}
+
+static void benchInstanceAllocation(void) {
+    const int serverCounts[] = {100, 1000, 100000};
+    const int instances[] = {20000, 2000, 20};
+    const int numCounts = sizeof(serverCounts) / sizeof(serverCounts[0]);
+
+    printf("\n--- Instance Allocation (construct + teardown, us/instance) ---\n");
+    printf("%8s %10s %12s %12s %12s\n", "servers", "instances", "malloc",
+           "new arena", "reset arena");
+
+    for (int c = 0; c < numCounts; c++) {
+        double us[3];
+        Arena* reused = createArena(instanceArenaBytes(serverCounts[c]));
+        for (int variant = 0; variant < 3; variant++) {
+            seedThreadRng(BENCH_SEED);
+            double start = nowNs();
+            for (int k = 0; k < instances[c]; k++) {
+                if (variant == 1) {
+                    Arena* arena = createArena(instanceArenaBytes(serverCounts[c]));
+                    buildInstance(serverCounts[c], arena);
+                    freeArena(arena);
+                } else {
+                    buildInstance(serverCounts[c], (variant == 2) ? reused : NULL);
+                }
+            }
+            us[variant] = (nowNs() - start) * 1e-3 / instances[c];
+        }
+        freeArena(reused);
+
+        printf("%8d %10d %12.2f %12.2f %12.2f\n", serverCounts[c], instances[c],
+               us[0], us[1], us[2]);
+        jsonBegin("instanceAllocation");
+        if (jsonOut) {
+            fprintf(jsonOut, ", \"servers\": %d, \"instances\": %d, "
+                    "\"mallocUs\": %.3f, \"arenaUs\": %.3f, \"resetArenaUs\": %.3f",
+                    serverCounts[c], instances[c], us[0], us[1], us[2]);
+        }
+        jsonEnd();
+    }
+}
+
+/* Rebalance check cost with and without an ImbalanceTracker
+ * The threshold is raised so every check finds the fleet balanced and only
+ * the decision is timed; a second run checks after every task at the
+ * default threshold.
+ */
+static void benchImbalanceTracking(void) {
+    const int serverCounts[] = {1000, 100000, 1000000};
+    const int numCounts = sizeof(serverCounts) / sizeof(serverCounts[0]);
+    const int numTasks = BENCH_TASKS;
+
+    printf("\n--- Imbalance Tracking (ns per balanced check, tasks/s) ---\n");
+    printf("%8s %12s %12s %14s %16s\n", "servers", "scan check", "tracked",
+           "assign only", "assign+check");
+
+    for (int c = 0; c < numCounts; c++) {
+        int n = serverCounts[c];
+        SimulationOptions opts = defaultSimulationOptions();
+        opts.logLevel = LOG_QUIET;
+
+        double checkNs[2];
+        for (int tracked = 0; tracked < 2; tracked++) {
+            seedThreadRng(BENCH_SEED);
+            MinHeap* heap;
+            ServerTable* servers = createBenchFleet(n, opts.assignmentMode, &heap);
+            ImbalanceTracker* tracker = NULL;
+            if (tracked) {
+                tracker = createImbalanceTracker(n);
+                attachImbalanceTracker(servers, tracker);
+            }
+            for (int t = 0; t < 4 * n; t++) {
+                assignTask(servers, heap, rngRange(threadRng(), MIN_TASK_LOAD,
+                                                   MAX_TASK_LOAD), &opts);
+            }
+
+            SimulationOptions balanced = opts;
+            balanced.rebalanceThreshold = 1000.0f;
+            int checks = tracked ? 10000000 : (int)(200000000LL / n);
+            double start = nowNs();
+            for (int k = 0; k < checks; k++) {
+                rebalanceLoads(servers, heap, &balanced);
+            }
+            checkNs[tracked] = (nowNs() - start) / checks;
+
+            servers->tracker = NULL;
+            if (tracker) {
+                freeImbalanceTracker(tracker);
+            }
+            freeMinHeap(heap);
+            freeServerTable(servers);
+        }
+
+        // Throughput: untracked, never checked vs tracked, checked every task
+        float* taskLoads = (float*)malloc(numTasks * sizeof(float));
+        fillTaskLoads(taskLoads, numTasks, DIST_UNIFORM, BENCH_SEED);
+        double tasksPerSec[2];
+        int rebalances = 0;
+        for (int tracked = 0; tracked < 2; tracked++) {
+            seedThreadRng(BENCH_SEED);
+            MinHeap* heap;
+            ServerTable* servers = createBenchFleet(n, opts.assignmentMode, &heap);
+            ImbalanceTracker* tracker = NULL;
+            if (tracked) {
+                tracker = createImbalanceTracker(n);
+                attachImbalanceTracker(servers, tracker);
+            }
+            double start = nowNs();
+            for (int t = 0; t < numTasks; t++) {
+                assignTask(servers, heap, taskLoads[t], &opts);
+                if (tracked && rebalanceLoads(servers, heap, &opts) > 0.0f) {
+                    rebalances++;
+                }
+            }
+            tasksPerSec[tracked] = numTasks / ((nowNs() - start) * 1e-9);
+
+            servers->tracker = NULL;
+            if (tracker) {
+                freeImbalanceTracker(tracker);
+            }
+            freeMinHeap(heap);
+            freeServerTable(servers);
+        }
+        free(taskLoads);
+
+        printf("%8d %12.1f %12.1f %14.0f %16.0f\n", n, checkNs[0], checkNs[1],
+               tasksPerSec[0], tasksPerSec[1]);
+        jsonBegin("imbalanceTracking");
+        if (jsonOut) {
+            fprintf(jsonOut, ", \"servers\": %d, \"scanCheckNs\": %.2f, "
+                    "\"trackedCheckNs\": %.2f, \"assignTasksPerSec\": %.0f, "
+                    "\"trackedEveryTaskTasksPerSec\": %.0f, \"rebalances\": %d",
+                    n, checkNs[0], checkNs[1], tasksPerSec[0], tasksPerSec[1],
+                    rebalances);
+        }
+        jsonEnd();
+    }
+}
+
+/* Per-thread state for benchRandomNumbers */
+typedef struct {
+    int generator;              // 0 = rand(), 1 = rngRange, 2 = rngFillUniform
+    int numLoads;
+    Rng rng;
+    float* loads;
+    pthread_t thread;
+} LoadGenerator;
+
+static void* loadGeneratorThread(void* arg) {
+    LoadGenerator* gen = (LoadGenerator*)arg;
+    if (gen->generator == 0) {
+        for (int t = 0; t < gen->numLoads; t++) {
+            gen->loads[t] = MIN_TASK_LOAD +
+                            (float)rand() / RAND_MAX * (MAX_TASK_LOAD - MIN_TASK_LOAD);
+        }
+    } else if (gen->generator == 1) {
+        for (int t = 0; t < gen->numLoads; t++) {
+            gen->loads[t] = rngRange(&gen->rng, MIN_TASK_LOAD, MAX_TASK_LOAD);
+        }
+    } else {
+        rngFillUniform(&gen->rng, gen->loads, gen->numLoads, MIN_TASK_LOAD,
+                       MAX_TASK_LOAD);
+    }
+    return NULL;
+}
+
+/* Task-load generation rate: the global rand() against per-thread Rng
+ * streams; every thread fills its own buffer, so only rand() shares state
+ */
+static void benchRandomNumbers(void) {
+    const int numLoads = 4 * BENCH_TASKS;
+    const int threadCounts[] = {1, 4};
+    const char* names[] = {"rand()", "rngRange", "rngFillUniform"};
+
+    printf("\n--- Random Task Loads (%d per thread, M loads/s total) ---\n", numLoads);
+    printf("%16s %10s %10s\n", "generator", "1 thread", "4 threads");
+
+    LoadGenerator gens[4];
+    for (int t = 0; t < 4; t++) {
+        gens[t].loads = (float*)malloc(numLoads * sizeof(float));
+    }
+
+    for (int g = 0; g < 3; g++) {
+        double rate[2];
+        for (int c = 0; c < 2; c++) {
+            int threads = threadCounts[c];
+            srand(BENCH_SEED);
+            seedThreadRng(BENCH_SEED);
+            for (int t = 0; t < threads; t++) {
+                gens[t].generator = g;
+                gens[t].numLoads = numLoads;
+                gens[t].rng = splitRng(threadRng());
+            }
+            double start = nowNs();
+            for (int t = 1; t < threads; t++) {
+                if (pthread_create(&gens[t].thread, NULL, loadGeneratorThread,
+                                   &gens[t]) != 0) {
+                    gens[t].numLoads = -1;
+                }
+            }
+            loadGeneratorThread(&gens[0]);
+            int done = numLoads;
+            for (int t = 1; t < threads; t++) {
+                if (gens[t].numLoads >= 0) {
+                    pthread_join(gens[t].thread, NULL);
+                    done += numLoads;
+                }
+            }
+            rate[c] = done / ((nowNs() - start) * 1e-3);
+        }
+
+        printf("%16s %10.1f %10.1f\n", names[g], rate[0], rate[1]);
+        jsonBegin("randomNumbers");
+        if (jsonOut) {
+            fprintf(jsonOut, ", \"generator\": \"%s\", \"loadsPerThread\": %d, "
+                    "\"mLoadsPerSec1\": %.2f, \"mLoadsPerSec4\": %.2f",
+                    names[g], numLoads, rate[0], rate[1]);
+        }
+        jsonEnd();
+    }
+
+    for (int t = 0; t < 4; t++) {
+        free(gens[t].loads);
+    }
+}
+
+/* Trace capture and replay. The trace is read back right after it is
+ * written, so the stream rate is the mapped reader's ceiling from the page
+ * cache; replays from disk run at min(that, disk bandwidth).
+ */
+static void benchTraceReplay(void) {
+    const long long numRecords = 16LL * BENCH_TASKS;
+    const int replayTasks = 4 * BENCH_TASKS;
+    const int numServers = 1000;
+    double megabytes = (16.0 + numRecords * sizeof(TraceRecord)) / (1024.0 * 1024.0);
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/lb_bench_%d.trc", (int)getpid());
+
+    printf("\n--- Trace Capture and Replay (%lld records, %.0f MB) ---\n",
+           numRecords, megabytes);
+
+    // Capture: buffered appends of pre-generated loads
+    float* taskLoads = (float*)malloc(BENCH_TASKS * sizeof(float));
+    fillTaskLoads(taskLoads, BENCH_TASKS, DIST_UNIFORM, BENCH_SEED);
+    TraceWriter* writer = createTraceWriter(path);
+    if (writer == NULL) {
+        free(taskLoads);
+        return;
+    }
+    double start = nowNs();
+    for (long long k = 0; k < numRecords; k++) {
+        appendTraceRecord(writer, k * 1e-3, taskLoads[k % BENCH_TASKS], -1);
+    }
+    long long written = closeTraceWriter(writer);
+    double captureMBs = megabytes / ((nowNs() - start) * 1e-9);
+    free(taskLoads);
+
+    TraceReader* reader = written == numRecords ? openTraceReader(path) : NULL;
+    if (reader == NULL) {
+        printf("Trace capture failed\n");
+        unlink(path);
+        return;
+    }
+
+    // Stream: touch every record through the mapped windows
+    start = nowNs();
+    double loadSum = 0.0;
+    int count;
+    const TraceRecord* records;
+    while ((records = nextTraceRecords(reader, 1 << 16, &count)) != NULL) {
+        for (int k = 0; k < count; k++) {
+            loadSum += records[k].load;
+        }
+    }
+    double streamGBs = megabytes / 1024.0 / ((nowNs() - start) * 1e-9);
+
+    // Replay vs synthetic tasks on identical fleets
+    double tasksPerSec[2];
+    for (int replay = 0; replay < 2; replay++) {
+        SimulationOptions opts = defaultSimulationOptions();
+        opts.logLevel = LOG_QUIET;
+        rewindTraceReader(reader);
+        opts.replay = replay ? reader : NULL;
+
+        seedThreadRng(BENCH_SEED);
+        MinHeap* heap;
+        ServerTable* servers = createBenchFleet(numServers, opts.assignmentMode, &heap);
+        SimulationStats stats = {0};
+        start = nowNs();
+        simulateTaskAssignment(servers, NULL, heap, replayTasks, &opts, &stats);
+        tasksPerSec[replay] = stats.tasksAssigned / ((nowNs() - start) * 1e-9);
+        freeMinHeap(heap);
+        freeServerTable(servers);
+    }
+    closeTraceReader(reader);
+    unlink(path);
+
+    printf("%-28s %10.0f MB/s\n", "capture (appendTraceRecord)", captureMBs);
+    printf("%-28s %10.2f GB/s (load sum %.0f)\n", "stream (nextTraceRecords)",
+           streamGBs, loadSum);
+    printf("%-28s %10.0f tasks/s (%d servers)\n", "synthetic loads", tasksPerSec[0],
+           numServers);
+    printf("%-28s %10.0f tasks/s\n", "trace replay", tasksPerSec[1]);
+    jsonBegin("traceReplay");
+    if (jsonOut) {
+        fprintf(jsonOut, ", \"records\": %lld, \"captureMBPerSec\": %.1f, "
+                "\"streamGBPerSec\": %.3f, \"servers\": %d, "
+                "\"syntheticTasksPerSec\": %.0f, \"replayTasksPerSec\": %.0f",
+                numRecords, captureMBs, streamGBs, numServers, tasksPerSec[0],
+                tasksPerSec[1]);
+    }
+    jsonEnd();
+}
+
+static void benchMultiResource(void) {
+    const int serverCounts[] = {1000, 100000, 1000000};
+    const int numCounts = sizeof(serverCounts) / sizeof(serverCounts[0]);
+    const float weights[RESOURCE_DIMENSIONS] = {1.0f, 1.0f, 1.0f};
+
+    printf("\n--- Multi-Resource Loads (ns per rebalance check, tasks/s) ---\n");
+    printf("%8s %12s %14s %14s %14s\n", "servers", "scalar scan", "vector scan",
+           "scalar tasks/s", "vector tasks/s");
+
+    for (int c = 0; c < numCounts; c++) {
+        int n = serverCounts[c];
+        double checkNs[2], tasksPerSec[2];
+        for (int vector = 0; vector < 2; vector++) {
+            SimulationOptions opts = defaultSimulationOptions();
+            opts.logLevel = LOG_QUIET;
+            opts.assignmentMode = vector ? ASSIGN_BY_DOMINANT_SHARE : ASSIGN_BY_UTILIZATION;
+            opts.rebalanceInterval = (n > REBALANCE_INTERVAL) ? n : REBALANCE_INTERVAL;
+
+            seedThreadRng(BENCH_SEED);
+            BalancerInstance* instance = createBalancerInstance(
+                n, HEAP_ARITY, opts.assignmentMode, 0, 0, vector ? weights : NULL);
+            ServerTable* servers = instance->servers;
+            SimulationStats stats = {0};
+            double start = nowNs();
+            simulateTaskAssignment(servers, instance->graph, instance->heap,
+                                   BENCH_TASKS, &opts, &stats);
+            tasksPerSec[vector] = stats.tasksAssigned / ((nowNs() - start) * 1e-9);
+
+            int checks = (int)(200000000LL / n);
+            float sink = 0.0f;
+            start = nowNs();
+            for (int k = 0; k < checks; k++) {
+                LoadScan scan = vector
+                    ? scanDominantShares(instance->resources->load,
+                                         instance->resources->invCapacity,
+                                         RESOURCE_DIMENSIONS, n)
+                    : scanServerTable(servers);
+                sink += scan.totalLoad;
+            }
+            checkNs[vector] = (nowNs() - start) / checks;
+            if (sink < 0.0f) {
+                printf("(unreachable)\n");
+            }
+            freeBalancerInstance(instance);
+        }
+
+        printf("%8d %12.1f %14.1f %14.0f %14.0f\n", n, checkNs[0], checkNs[1],
+               tasksPerSec[0], tasksPerSec[1]);
+        jsonBegin("multiResource");
+        if (jsonOut) {
+            fprintf(jsonOut, ", \"servers\": %d, \"scalarScanNs\": %.2f, "
+                    "\"vectorScanNs\": %.2f, \"scalarTasksPerSec\": %.0f, "
+                    "\"vectorTasksPerSec\": %.0f",
+                    n, checkNs[0], checkNs[1], tasksPerSec[0], tasksPerSec[1]);
+        }
+        jsonEnd();
+    }
+}
+
+/* Flat heap + tracker vs two-level hierarchy in steady state
+ * 4n tasks each complete 2n arrivals after starting (two running tasks per
+ * server) and every fifth arrival runs a rebalance pass, so both sides pay
+ * O(log) per pass, never a scan.
+ */
+static void benchHierarchy(void) {
+    const int serverCounts[] = {10000, 100000, 1000000};
+    const int numCounts = sizeof(serverCounts) / sizeof(serverCounts[0]);
+
+    printf("\n--- Hierarchical Balancer (tasks/s, max/avg load) ---\n");
+    printf("%8s %7s %14s %14s %10s %10s %12s\n", "servers", "groups", "flat tasks/s",
+           "hier tasks/s", "flat m/a", "hier m/a", "hier rebal");
+
+    for (int c = 0; c < numCounts; c++) {
+        int n = serverCounts[c];
+        double tasksPerSec[2], maxAvgLoad[2];
+        int rebalances = 0, numGroups = 0;
+        for (int hierarchical = 0; hierarchical < 2; hierarchical++) {
+            SimulationOptions opts = defaultSimulationOptions();
+            opts.logLevel = LOG_QUIET;
+            opts.taskLifetime = 2 * n;
+
+            seedThreadRng(BENCH_SEED);
+            BalancerInstance* instance = createBalancerInstance(
+                n, HEAP_ARITY, opts.assignmentMode, 0, !hierarchical, NULL);
+            ServerTable* servers = instance->servers;
+            if (hierarchical) {
+                opts.hierarchy = createHierarchicalBalancer(servers, NULL, 0,
+                                                            opts.assignmentMode, HEAP_ARITY);
+                numGroups = opts.hierarchy->numGroups;
+            }
+            SimulationStats stats = {0};
+            double start = nowNs();
+            simulateTaskAssignment(servers, instance->graph, instance->heap,
+                                   4 * n, &opts, &stats);
+            tasksPerSec[hierarchical] = stats.tasksAssigned / ((nowNs() - start) * 1e-9);
+
+            double maxAvgUtil, spread;
+            measureImbalance(servers, &maxAvgLoad[hierarchical], &maxAvgUtil, &spread);
+            if (hierarchical) {
+                rebalances = stats.rebalances;
+                freeHierarchicalBalancer(opts.hierarchy);
+            }
+            freeBalancerInstance(instance);
+        }
+
+        printf("%8d %7d %14.0f %14.0f %10.3f %10.3f %12d\n", n, numGroups, tasksPerSec[0],
+               tasksPerSec[1], maxAvgLoad[0], maxAvgLoad[1], rebalances);
+        jsonBegin("hierarchy");
+        if (jsonOut) {
+            fprintf(jsonOut, ", \"servers\": %d, \"groups\": %d, "
+                    "\"flatTasksPerSec\": %.0f, \"hierarchyTasksPerSec\": %.0f, "
+                    "\"flatMaxAvgLoad\": %.4f, \"hierarchyMaxAvgLoad\": %.4f, "
+                    "\"hierarchyRebalances\": %d",
+                    n, numGroups, tasksPerSec[0], tasksPerSec[1], maxAvgLoad[0],
+                    maxAvgLoad[1], rebalances);
+        }
+        jsonEnd();
+    }
+}
+
+/* Warm start: createBalancerInstance vs restoreBalancerInstance
+ * The snapshot is read back right after it is written, so restore times are
+ * from the page cache. A restore at another arity cannot reuse the saved
+ * heap array and rebuilds it with buildHeap. The fleet is loaded with 4n
+ * tasks and no rebalancing, so the snapshot holds uneven loads.
+ */
+static void benchSnapshotRestore(void) {
+    const int serverCounts[] = {10000, 100000, 1000000};
+    const int numCounts = sizeof(serverCounts) / sizeof(serverCounts[0]);
+    const int otherArity = (HEAP_ARITY == 4) ? 2 : 4;
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/lb_bench_%d.snap", (int)getpid());
+
+    printf("\n--- Snapshot and Restore (ms) ---\n");
+    printf("%8s %10s %10s %10s %12s %12s\n", "servers", "size MB", "create", "save",
+           "restore", "rebuild heap");
+
+    for (int c = 0; c < numCounts; c++) {
+        int n = serverCounts[c];
+        SimulationOptions opts = defaultSimulationOptions();
+        opts.logLevel = LOG_QUIET;
+        opts.rebalanceInterval = 4 * n;
+
+        seedThreadRng(BENCH_SEED);
+        double start = nowNs();
+        BalancerInstance* instance = createBalancerInstance(n, HEAP_ARITY,
+                                                            opts.assignmentMode, 0, 0, NULL);
+        double createMs = (nowNs() - start) * 1e-6;
+        SimulationStats stats = {0};
+        simulateTaskAssignment(instance->servers, instance->graph, instance->heap, 4 * n,
+                               &opts, &stats);
+
+        start = nowNs();
+        int saved = saveSnapshot(path, instance->servers, instance->heap, instance->graph,
+                                 opts.assignmentMode);
+        double saveMs = (nowNs() - start) * 1e-6;
+        freeBalancerInstance(instance);
+        if (saved != 0) {
+            return;
+        }
+        struct stat info;
+        double megabytes = (stat(path, &info) == 0) ? info.st_size / (1024.0 * 1024.0) : 0.0;
+
+        double restoreMs[2];
+        int copied[2] = {0, 0};
+        for (int rebuild = 0; rebuild < 2; rebuild++) {
+            start = nowNs();
+            instance = restoreBalancerInstance(path, rebuild ? otherArity : HEAP_ARITY,
+                                               opts.assignmentMode, 0, 0, &copied[rebuild]);
+            restoreMs[rebuild] = (nowNs() - start) * 1e-6;
+            if (instance == NULL) {
+                unlink(path);
+                return;
+            }
+            freeBalancerInstance(instance);
+        }
+        unlink(path);
+        if (!copied[0] || copied[1]) {
+            printf("Unexpected restore path (copied %d, %d)\n", copied[0], copied[1]);
+        }
+
+        printf("%8d %10.2f %10.2f %10.2f %12.2f %12.2f\n", n, megabytes, createMs, saveMs,
+               restoreMs[0], restoreMs[1]);
+        jsonBegin("snapshotRestore");
+        if (jsonOut) {
+            fprintf(jsonOut, ", \"servers\": %d, \"snapshotMB\": %.3f, "
+                    "\"createMs\": %.3f, \"saveMs\": %.3f, \"restoreMs\": %.3f, "
+                    "\"restoreRebuildMs\": %.3f",
+                    n, megabytes, createMs, saveMs, restoreMs[0], restoreMs[1]);
+        }
+        jsonEnd();
+    }
+}
+
+/* A float comparator reached through a pointer the compiler cannot see
+ * through, as a generic heap taking a comparison callback would call it
+ */
+static int compareLoadKeys(float a, float b) {
+    return a < b;
+}
+static int (*volatile loadKeyComparator)(float, float) = compareLoadKeys;
+#define INDIRECT_KEY_LESS(a, b) (loadKeyComparator((a), (b)))
+DEFINE_SPECIALIZED_HEAP(IndirectKeyHeap, indirectKeyHeap, LoadKey, INDIRECT_KEY_LESS, 4)
+
+static float* benchCapacity;
+static float* benchInvCapacity;
+
+#define BENCH_LOAD_KEY(load, id) (load)
+#define BENCH_UTILIZATION_KEY(load, id) \
+    ((UtilizationKey){(load) * benchInvCapacity[id], benchCapacity[id]})
+
+/* Define prefix##Bench: BENCH_OPERATIONS root replacements, then random
+ * updates, on one generated heap type built from loads (updated in place);
+ * MAKE_KEY turns a server's load into its key
+ */
+#define DEFINE_HEAP_BENCH(HeapType, prefix, KeyType, MAKE_KEY)                       \
+static void prefix##Bench(int n, float* loads, const float* taskLoads,              \
+                          const int* serverIds, const float* newLoads,              \
+                          double* replaceNs, double* updateNs) {                    \
+    KeyType* keys = (KeyType*)malloc(n * sizeof(KeyType));                          \
+    for (int i = 0; i < n; i++) {                                                   \
+        keys[i] = MAKE_KEY(loads[i], i);                                            \
+    }                                                                               \
+    HeapType* heap = prefix##Create(n);                                             \
+    prefix##Build(heap, keys, n);                                                   \
+    free(keys);                                                                     \
+                                                                                    \
+    double start = nowNs();                                                         \
+    for (int op = 0; op < BENCH_OPERATIONS; op++) {                                 \
+        int id = prefix##Top(heap).serverId;                                        \
+        loads[id] += taskLoads[op];                                                 \
+        prefix##ReplaceTop(heap, MAKE_KEY(loads[id], id));                          \
+    }                                                                               \
+    *replaceNs = (nowNs() - start) / BENCH_OPERATIONS;                              \
+                                                                                    \
+    start = nowNs();                                                                \
+    for (int op = 0; op < BENCH_OPERATIONS; op++) {                                 \
+        int id = serverIds[op] % n;                                                 \
+        loads[id] = newLoads[op];                                                   \
+        prefix##Update(heap, id, MAKE_KEY(loads[id], id));                          \
+    }                                                                               \
+    *updateNs = (nowNs() - start) / BENCH_OPERATIONS;                               \
+    prefix##Free(heap);                                                             \
+}
+
+DEFINE_HEAP_BENCH(LoadKeyHeap, loadKeyHeap, LoadKey, BENCH_LOAD_KEY)
+DEFINE_HEAP_BENCH(IndirectKeyHeap, indirectKeyHeap, LoadKey, BENCH_LOAD_KEY)
+DEFINE_HEAP_BENCH(UtilizationKeyHeap, utilizationKeyHeap, UtilizationKey,
+                  BENCH_UTILIZATION_KEY)
+
+static void benchSpecializedHeaps(void) {
+    const int serverCounts[] = {1000, 100000, 1000000};
+    const int numCounts = sizeof(serverCounts) / sizeof(serverCounts[0]);
+    const char* variants[] = {"MinHeap", "inlined", "fn pointer", "struct key"};
+    const int numVariants = sizeof(variants) / sizeof(variants[0]);
+
+    float* taskLoads = (float*)malloc(BENCH_OPERATIONS * sizeof(float));
+    float* newLoads = (float*)malloc(BENCH_OPERATIONS * sizeof(float));
+    int* serverIds = (int*)malloc(BENCH_OPERATIONS * sizeof(int));
+    seedThreadRng(BENCH_SEED + 1);
+    Rng* rng = threadRng();
+    for (int op = 0; op < BENCH_OPERATIONS; op++) {
+        taskLoads[op] = rngRange(rng, MIN_TASK_LOAD, MAX_TASK_LOAD);
+        newLoads[op] = rngRange(rng, 0.0f, MAX_CAPACITY);
+        serverIds[op] = (int)(rngNext(rng) >> 33);
+    }
+
+    printf("\n--- Specialized Heaps (arity 4, %d ops per run, ns/op) ---\n",
+           BENCH_OPERATIONS);
+    printf("%10s %12s %12s %12s\n", "servers", "variant", "replaceTop", "update");
+
+    for (int c = 0; c < numCounts; c++) {
+        int n = serverCounts[c];
+        float* initial = (float*)malloc(n * sizeof(float));
+        float* loads = (float*)malloc(n * sizeof(float));
+        benchCapacity = (float*)malloc(n * sizeof(float));
+        benchInvCapacity = (float*)malloc(n * sizeof(float));
+        seedThreadRng(BENCH_SEED);
+        for (int i = 0; i < n; i++) {
+            initial[i] = rngRange(threadRng(), 0.0f, MAX_CAPACITY);
+            benchCapacity[i] = rngRange(threadRng(), MIN_CAPACITY, MAX_CAPACITY);
+            benchInvCapacity[i] = 1.0f / benchCapacity[i];
+        }
+
+        for (int v = 0; v < numVariants; v++) {
+            double replaceNs = 0.0, updateNs = 0.0;
+            memcpy(loads, initial, n * sizeof(float));
+            if (v == 0) {
+                MinHeap* heap = createDaryHeap(n, 4);
+                buildHeap(heap, initial, n);
+                double start = nowNs();
+                for (int op = 0; op < BENCH_OPERATIONS; op++) {
+                    HeapNode minServer = peekMin(heap);
+                    replaceTop(heap, minServer.load + taskLoads[op]);
+                }
+                replaceNs = (nowNs() - start) / BENCH_OPERATIONS;
+                start = nowNs();
+                for (int op = 0; op < BENCH_OPERATIONS; op++) {
+                    updateHeap(heap, serverIds[op] % n, newLoads[op]);
+                }
+                updateNs = (nowNs() - start) / BENCH_OPERATIONS;
+                freeMinHeap(heap);
+            } else if (v == 1) {
+                loadKeyHeapBench(n, loads, taskLoads, serverIds, newLoads,
+                                 &replaceNs, &updateNs);
+            } else if (v == 2) {
+                indirectKeyHeapBench(n, loads, taskLoads, serverIds, newLoads,
+                                     &replaceNs, &updateNs);
+            } else {
+                utilizationKeyHeapBench(n, loads, taskLoads, serverIds, newLoads,
+                                        &replaceNs, &updateNs);
+            }
+
+            printf("%10d %12s %12.1f %12.1f\n", n, variants[v], replaceNs, updateNs);
+            jsonBegin("specializedHeap");
+            if (jsonOut) {
+                fprintf(jsonOut, ", \"servers\": %d, \"variant\": \"%s\", "
+                        "\"replaceTopNs\": %.2f, \"updateNs\": %.2f",
+                        n, variants[v], replaceNs, updateNs);
+            }
+            jsonEnd();
+        }
+        free(initial);
+        free(loads);
+        free(benchCapacity);
+        free(benchInvCapacity);
+    }
+
+    free(taskLoads);
+    free(newLoads);
+    free(serverIds);
+}
+
+int main(int argc, char** argv) {
+    const char* jsonPath = NULL;
+    const char* label = "";
+    int throughputOnly = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            jsonPath = argv[++i];
+        } else if (strcmp(argv[i], "--label") == 0 && i + 1 < argc) {
+            label = argv[++i];
+        } else if (strcmp(argv[i], "--throughput-only") == 0) {
+            throughputOnly = 1;
+        } else {
+            printf("Usage: %s [--json FILE] [--label TEXT] [--throughput-only]\n",
+                   argv[0]);
+            return 1;
+        }
+    }
+
+    if (jsonPath) {
+        jsonOut = fopen(jsonPath, "w");
+        if (jsonOut == NULL) {
+            printf("Cannot open '%s'\n", jsonPath);
+            return 1;
+        }
+#ifdef __VERSION__
+        const char* compiler = __VERSION__;
+#else
+        const char* compiler = "unknown";
+#endif
+        fprintf(jsonOut, "{\n  \"schema\": %d,\n  \"label\": \"",
+                JSON_SCHEMA_VERSION);
+        for (const char* c = label; *c; c++) {
+            if (*c == '"' || *c == '\\') {
+                fputc('\\', jsonOut);
+            }
+            fputc(*c, jsonOut);
+        }
+        fprintf(jsonOut, "\",\n  \"compiler\": \"%s\",\n  \"timestamp\": %lld,\n"
+                "  \"heapArity\": %d,\n  \"results\": [",
+                compiler, (long long)time(NULL), HEAP_ARITY);
+    }
+
+    // --throughput-only: sections 4 and 5, for tracking across versions
+    benchThroughput();
+    benchSharded();
+    if (throughputOnly) {
+        return finishJson();
+    }
+
+    const int serverCounts[] = {1000, 10000, 100000, 1000000};
+    const int arities[] = {2, 4, 8};
+    const int numCounts = sizeof(serverCounts) / sizeof(serverCounts[0]);
+    const int numArities = sizeof(arities) / sizeof(arities[0]);
+
+    // Pre-generate the workload so the generator stays out of the timed loops
+    float* taskLoads = (float*)malloc(BENCH_OPERATIONS * sizeof(float));
+    float* newLoads = (float*)malloc(BENCH_OPERATIONS * sizeof(float));
+    int* serverIds = (int*)malloc(BENCH_OPERATIONS * sizeof(int));
+    seedThreadRng(BENCH_SEED + 1);
+    Rng* rng = threadRng();
+    for (int op = 0; op < BENCH_OPERATIONS; op++) {
+        taskLoads[op] = rngRange(rng, MIN_TASK_LOAD, MAX_TASK_LOAD);
+        newLoads[op] = rngRange(rng, 0.0f, MAX_CAPACITY);
+        serverIds[op] = (int)(rngNext(rng) >> 33);
+    }
+
+    printf("\n--- Heap Benchmark (%d ops per run, ns/op) ---\n", BENCH_OPERATIONS);
+    printf("%10s %6s %14s %14s\n", "servers", "arity", "replaceTop", "updateHeap");
+
+    for (int c = 0; c < numCounts; c++) {
+        for (int a = 0; a < numArities; a++) {
+            double replaceNs = benchReplaceTop(serverCounts[c], arities[a],
+                                               taskLoads);
+            double updateNs = benchUpdateHeap(serverCounts[c], arities[a],
+                                              serverIds, newLoads);
+            printf("%10d %6d %14.1f %14.1f\n",
+                   serverCounts[c], arities[a], replaceNs, updateNs);
+            jsonBegin("heap");
+            if (jsonOut) {
+                fprintf(jsonOut, ", \"servers\": %d, \"arity\": %d, "
+                        "\"replaceTopNs\": %.2f, \"updateHeapNs\": %.2f",
+                        serverCounts[c], arities[a], replaceNs, updateNs);
+            }
+            jsonEnd();
+        }
+    }
+
+    free(taskLoads);
+    free(newLoads);
+    free(serverIds);
+
+    benchAssignmentModes();
+    int failed = benchRebalanceModes();
+    benchSelectionPolicies();
+    benchBatchAssignment();
+    benchInstanceAllocation();
+    benchRandomNumbers();
+    benchImbalanceTracking();
+    benchTraceReplay();
+    benchMultiResource();
+    benchHierarchy();
+    benchSnapshotRestore();
+    benchSpecializedHeaps();
+
+    return finishJson() || failed;
+}
@@ -0,0 +1,207 @@
+/* ============================================================================
+ * SPECIALIZED HEAP TEMPLATE (header-only)
+ * DEFINE_SPECIALIZED_HEAP(Type, prefix, KeyType, LESS, ARITY) generates a
+ * d-ary min heap of (serverId, key) nodes with a serverId -> slot index,
+ * laid out like MinHeap in load_balancer.c, as static inline functions:
+ *
+ *   Type* prefixCreate(int capacity)        void prefixFree(Type* heap)
+ *   void prefixInsert(heap, id, key)        TypeNode prefixTop(heap)
+ *   TypeNode prefixPop(heap)                void prefixReplaceTop(heap, key)
+ *   void prefixUpdate(heap, id, key)        void prefixBuild(heap, keys, count)
+ *
+ * LESS(a, b) is expanded in place in the sift loops, so any comparator -
+ * a float compare or a tie-breaking one on a struct key - inlines with no
+ * call, and ARITY is a constant the child loop unrolls on. MinHeap covers
+ * the balancer's own float keys; use this for keys it cannot express.
+ * Specializations for the three assignment modes follow the macro
+ * (SPECIALIZED_HEAP_ARITY children per node, 4 unless defined first).
+ * ============================================================================ */
+#ifndef HEAP_TEMPLATE_H
+#define HEAP_TEMPLATE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifndef SPECIALIZED_HEAP_ARITY
+#define SPECIALIZED_HEAP_ARITY 4
+#endif
+#define SPECIALIZED_HEAP_ALIGN 64   // Child groups start on a cache line
+
+#define DEFINE_SPECIALIZED_HEAP(Type, prefix, KeyType, LESS, ARITY)              \
+                                                                                  \
+typedef struct {                                                                  \
+    int serverId;                                                                 \
+    KeyType key;                                                                  \
+} Type##Node;                                                                     \
+                                                                                  \
+typedef struct {                                                                  \
+    Type##Node* arr;                                                              \
+    int* pos;                   /* serverId -> slot, -1 = not in the heap */      \
+    void* block;                                                                  \
+    int size;                                                                     \
+    int capacity;                                                                 \
+} Type;                                                                           \
+                                                                                  \
+/* Empty heap for server IDs 0..capacity-1; &arr[1] is cache-line aligned */      \
+static inline Type* prefix##Create(int capacity) {                                \
+    Type* heap = (Type*)malloc(sizeof(Type));                                     \
+    heap->block = malloc(capacity * sizeof(Type##Node) + SPECIALIZED_HEAP_ALIGN); \
+    uintptr_t firstChild = (uintptr_t)heap->block + sizeof(Type##Node);           \
+    uintptr_t aligned = (firstChild + SPECIALIZED_HEAP_ALIGN - 1) &               \
+                        ~(uintptr_t)(SPECIALIZED_HEAP_ALIGN - 1);                 \
+    heap->arr = (Type##Node*)(aligned - sizeof(Type##Node));                      \
+    heap->pos = (int*)malloc(capacity * sizeof(int));                             \
+    for (int i = 0; i < capacity; i++) {                                          \
+        heap->pos[i] = -1;                                                        \
+    }                                                                             \
+    heap->size = 0;                                                               \
+    heap->capacity = capacity;                                                    \
+    return heap;                                                                  \
+}                                                                                 \
+                                                                                  \
+static inline void prefix##Free(Type* heap) {                                     \
+    free(heap->block);                                                            \
+    free(heap->pos);                                                              \
+    free(heap);                                                                   \
+}                                                                                 \
+                                                                                  \
+/* Hole-based sift-up: parents move down until the node fits */                   \
+static inline void prefix##SiftUp(Type* heap, int index) {                        \
+    Type##Node* arr = heap->arr;                                                  \
+    Type##Node node = arr[index];                                                 \
+    while (index > 0) {                                                           \
+        int parentIdx = (index - 1) / (ARITY);                                    \
+        if (!(LESS(node.key, arr[parentIdx].key))) break;                         \
+        arr[index] = arr[parentIdx];                                              \
+        heap->pos[arr[index].serverId] = index;                                   \
+        index = parentIdx;                                                        \
+    }                                                                             \
+    arr[index] = node;                                                            \
+    heap->pos[node.serverId] = index;                                             \
+}                                                                                 \
+                                                                                  \
+/* Hole-based sift-down: the smallest child moves up until the node fits */       \
+static inline void prefix##SiftDown(Type* heap, int index) {                      \
+    Type##Node* arr = heap->arr;                                                  \
+    int size = heap->size;                                                        \
+    Type##Node node = arr[index];                                                 \
+    for (;;) {                                                                    \
+        int firstChild = (ARITY) * index + 1;                                     \
+        if (firstChild >= size) break;                                            \
+        int smallest = firstChild;                                                \
+        if (firstChild + (ARITY) <= size) {                                       \
+            for (int k = 1; k < (ARITY); k++) {                                   \
+                int child = firstChild + k;                                       \
+                smallest = LESS(arr[child].key, arr[smallest].key)                \
+                               ? child : smallest;                                \
+            }                                                                     \
+        } else {                                                                  \
+            for (int child = firstChild + 1; child < size; child++) {             \
+                smallest = LESS(arr[child].key, arr[smallest].key)                \
+                               ? child : smallest;                                \
+            }                                                                     \
+        }                                                                         \
+        if (!(LESS(arr[smallest].key, node.key))) break;                          \
+        arr[index] = arr[smallest];                                               \
+        heap->pos[arr[index].serverId] = index;                                   \
+        index = smallest;                                                         \
+    }                                                                             \
+    arr[index] = node;                                                            \
+    heap->pos[node.serverId] = index;                                             \
+}                                                                                 \
+                                                                                  \
+static inline void prefix##Insert(Type* heap, int serverId, KeyType key) {        \
+    if (heap->size == heap->capacity) return;                                     \
+    heap->arr[heap->size].serverId = serverId;                                    \
+    heap->arr[heap->size].key = key;                                              \
+    heap->size++;                                                                 \
+    prefix##SiftUp(heap, heap->size - 1);                                         \
+}                                                                                 \
+                                                                                  \
+/* Root without removing it (the heap must not be empty) */                       \
+static inline Type##Node prefix##Top(const Type* heap) {                          \
+    return heap->arr[0];                                                          \
+}                                                                                 \
+                                                                                  \
+static inline Type##Node prefix##Pop(Type* heap) {                                \
+    Type##Node root = heap->arr[0];                                               \
+    heap->pos[root.serverId] = -1;                                                \
+    heap->size--;                                                                 \
+    if (heap->size > 0) {                                                         \
+        heap->arr[0] = heap->arr[heap->size];                                     \
+        prefix##SiftDown(heap, 0);                                                \
+    }                                                                             \
+    return root;                                                                  \
+}                                                                                 \
+                                                                                  \
+/* New key for the root, one sift-down (per-task assignment) */                   \
+static inline void prefix##ReplaceTop(Type* heap, KeyType key) {                  \
+    heap->arr[0].key = key;                                                       \
+    prefix##SiftDown(heap, 0);                                                    \
+}                                                                                 \
+                                                                                  \
+/* New key for any server in the heap, sifted the way it moved */                 \
+static inline void prefix##Update(Type* heap, int serverId, KeyType key) {        \
+    int index = heap->pos[serverId];                                              \
+    if (index < 0) return;                                                        \
+    int up = LESS(key, heap->arr[index].key);                                     \
+    heap->arr[index].key = key;                                                   \
+    if (up) {                                                                     \
+        prefix##SiftUp(heap, index);                                              \
+    } else {                                                                      \
+        prefix##SiftDown(heap, index);                                            \
+    }                                                                             \
+}                                                                                 \
+                                                                                  \
+/* Servers 0..count-1 with their keys, heapified bottom-up (Floyd), O(n) */       \
+static inline void prefix##Build(Type* heap, const KeyType* keys, int count) {    \
+    for (int i = 0; i < heap->size; i++) {                                        \
+        heap->pos[heap->arr[i].serverId] = -1;                                    \
+    }                                                                             \
+    heap->size = (count < heap->capacity) ? count : heap->capacity;               \
+    for (int i = 0; i < heap->size; i++) {                                        \
+        heap->arr[i].serverId = i;                                                \
+        heap->arr[i].key = keys[i];                                               \
+        heap->pos[i] = i;                                                         \
+    }                                                                             \
+    if (heap->size > 1) {                                                         \
+        for (int i = (heap->size - 2) / (ARITY); i >= 0; i--) {                   \
+            prefix##SiftDown(heap, i);                                            \
+        }                                                                         \
+    }                                                                             \
+}
+
+/* Absolute load (ASSIGN_BY_LOAD): lowest load wins */
+typedef float LoadKey;
+#define LOAD_KEY_LESS(a, b) ((a) < (b))
+
+/* Utilization (ASSIGN_BY_UTILIZATION): lowest load / capacity wins; on a
+ * tie (e.g. an idle fleet) the larger server, which has more headroom
+ */
+typedef struct {
+    float utilization;
+    float capacity;
+} UtilizationKey;
+#define UTILIZATION_KEY_LESS(a, b)                                                \
+    ((a).utilization < (b).utilization ||                                         \
+     ((a).utilization == (b).utilization && (a).capacity > (b).capacity))
+
+/* Multi-resource (ASSIGN_BY_DOMINANT_SHARE): lowest dominant share wins; on
+ * a tie the lower sum of shares over all resources
+ */
+typedef struct {
+    float dominantShare;
+    float totalShare;
+} ShareKey;
+#define SHARE_KEY_LESS(a, b)                                                      \
+    ((a).dominantShare < (b).dominantShare ||                                     \
+     ((a).dominantShare == (b).dominantShare && (a).totalShare < (b).totalShare))
+
+DEFINE_SPECIALIZED_HEAP(LoadKeyHeap, loadKeyHeap, LoadKey, LOAD_KEY_LESS,
+                        SPECIALIZED_HEAP_ARITY)
+DEFINE_SPECIALIZED_HEAP(UtilizationKeyHeap, utilizationKeyHeap, UtilizationKey,
+                        UTILIZATION_KEY_LESS, SPECIALIZED_HEAP_ARITY)
+DEFINE_SPECIALIZED_HEAP(ShareKeyHeap, shareKeyHeap, ShareKey, SHARE_KEY_LESS,
+                        SPECIALIZED_HEAP_ARITY)
+
+#endif /* HEAP_TEMPLATE_H */
@@ -1,41 +1,508 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200112L  // pthreads with -std=c99
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 #include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "load_balancer.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 /* ============================================================================
  * CONSTANTS AND CONFIGURATION
  * ============================================================================ */
-#define NUM_SERVERS 6
-#define NUM_TASKS 30
+#ifndef LOAD_BALANCER_METRICS
+#define LOAD_BALANCER_METRICS 1  // Hot-path counters and histograms, 0 = compiled out
+#endif
+#define DEFAULT_NUM_SERVERS 6    // Fleet size unless set by --servers
 #define MIN_CAPACITY 80.0
 #define MAX_CAPACITY 120.0
 #define MIN_TASK_LOAD 5.0
 #define MAX_TASK_LOAD 15.0
-#define REBALANCE_THRESHOLD 20.0  // Percentage imbalance threshold
-#define REBALANCE_INTERVAL 5      // Rebalance after every N tasks
+#define RESOURCE_SECONDARY_SHARE 0.25  // Vector tasks: other dimensions vs the stressed one
+#define REBALANCE_THRESHOLD 20.0  // Default percentage imbalance threshold
+#define REBALANCE_INTERVAL 5      // Default: rebalance after every N tasks
+#define HEAP_ARITY 2              // Default children per heap node (2, 4 or 8)
+#define CACHE_LINE_SIZE 64        // Alignment for heap child groups
+#define LOAD_FIXED_SCALE 65536.0  // Atomic load counter units per load unit
+#define ASSIGNMENT_MODE ASSIGN_BY_LOAD         // Heap key used by the demo
+#define REBALANCE_MODE REBALANCE_SINGLE_PAIR   // Rebalancing engine used by the demo
+#define MAX_MIGRATION_HOPS 2      // Topology mode: farthest migration target
+#define LOG_LEVEL LOG_DEBUG       // Console output: quiet, info or debug
+#define EVENT_RING_CAPACITY 65536 // Event sink ring slots (power of two)
+#define TRACE_BUFFER_RECORDS 4096 // Trace writer: records per fwrite
+#define TRACE_WINDOW_BYTES (64 << 20)  // Trace reader: bytes mapped at a time
+#define SELECTION_POLICY SELECT_HEAP   // Server selection used by the demo
+#define NUM_CHOICES 2             // d for SELECT_D_CHOICES
+#define BATCH_SIZE 1              // Tasks per assignBatch call, 1 = one at a time
+#define TASK_LIFETIME 0           // Arrivals a task runs for, 0 = never completes
+#define ADMISSION_POLICY ADMIT_ALL // Tasks that fit nowhere: placed anyway by default
+#define ADMISSION_QUEUE 1024      // Pending task slots for admission control
+#define ADMISSION_LIMIT 100.0     // Admit while a server stays within this % of capacity
+#define IDLE_LOAD_EPSILON 1e-4f   // Admission: load / capacity treated as idle
+#define SNAPSHOT_SECTIONS 5       // Snapshot: capacity, load, heap, CSR offsets, edges
+#define SNAPSHOT_PREFETCH 16      // Restore: prefetch distance in heap nodes
+#define ARENA_BLOCK_SIZE (1 << 20) // First arena block; later blocks double
+#define ARRIVAL_RATE 1000.0       // Event engine: mean arrivals per virtual second
+#define SERVICE_MEAN 0.04         // Event engine: mean service time (seconds)
+#define REBALANCE_PERIOD 0.005    // Event engine: virtual seconds between passes
+#define BURST_FACTOR 10.0         // Bursty arrivals: burst rate / idle rate
+#define BURST_LENGTH 0.1          // Bursty arrivals: mean burst (and idle) seconds
+#define MAX_IN_FLIGHT (1 << 20)   // Event engine: task pool size
+#define METRIC_SAMPLE_PERIOD 64   // Time one assignment in every N (power of two)
+#define SHARDS_PER_THREAD 4       // Default shard count per producer thread
+#define SHARD_REBALANCE_PERIOD_US 1000  // Background rebalancer wake-up period
 
 /* ============================================================================
  * DATA STRUCTURES
  * ============================================================================ */
 
-/* Server Structure: Represents a single server node */
+/* Rng: xoshiro256** generator state (never all zero)
+ * Each thread owns its own state, so drawing numbers takes no lock and
+ * the same seed always replays the same stream.
+ */
+typedef struct {
+    uint64_t s[4];
+} Rng;
+
+/* Metric Counter: Event counts kept by the hot-path instrumentation */
+typedef enum {
+    METRIC_TASKS_ASSIGNED,
+    METRIC_TASKS_COMPLETED,
+    METRIC_HEAP_SIFT_UPS,
+    METRIC_HEAP_SIFT_DOWNS,
+    METRIC_HEAP_SIFT_LEVELS,    // Levels moved by all sifts
+    METRIC_HEAP_EXTRACTS,
+    METRIC_HEAP_UPDATES,
+    METRIC_HEAP_UPDATE_MISSES,  // updateHeap on a server not in the heap
+    METRIC_REBALANCE_CHECKS,
+    METRIC_REBALANCES,          // Checks that migrated load
+    METRIC_MIGRATIONS,
+    METRIC_MIGRATED_LOAD,       // Load units x 1000
+    METRIC_TASKS_QUEUED,        // Admission control: arrivals that had to wait
+    METRIC_TASKS_REJECTED,      // Admission control: arrivals turned away
+    METRIC_TASKS_SHED,          // Admission control: queued tasks dropped for newer ones
+    METRIC_LOCAL_MIGRATIONS,    // Hierarchy: migrations that stayed inside one group
+    NUM_METRIC_COUNTERS
+} MetricCounter;
+
+/* Metric Histogram: Distributions in power-of-two buckets */
+typedef enum {
+    HISTOGRAM_SIFT_LEVELS,      // Levels per sift
+    HISTOGRAM_ASSIGN_NS,        // assignTask latency, one in METRIC_SAMPLE_PERIOD
+    HISTOGRAM_REBALANCE_NS,     // rebalancePass latency
+    HISTOGRAM_MIGRATION_LOAD,   // Load units x 1000 per migration
+    HISTOGRAM_QUEUE_DEPTH,      // Pending tasks after each enqueue
+    HISTOGRAM_QUEUE_WAIT_ARRIVALS,  // Loop engine: arrivals a queued task waited
+    HISTOGRAM_QUEUE_WAIT_NS,    // Event engine: virtual ns a queued task waited
+    NUM_METRIC_HISTOGRAMS
+} MetricHistogram;
+
+#define HISTOGRAM_BUCKETS 32      // Bucket k: values below 2^k (last: the rest)
+
+/* Metrics Block: One thread's counters and histograms
+ * Only the owning thread writes a block, with relaxed atomic load + store
+ * (no read-modify-write), so recording costs a few plain adds. Exporters
+ * read every block with relaxed loads; each value is exact, the sum over
+ * threads is not one instant.
+ */
+typedef struct MetricsBlock {
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t counters[NUM_METRIC_COUNTERS];
+    _Atomic uint64_t buckets[NUM_METRIC_HISTOGRAMS][HISTOGRAM_BUCKETS];
+    _Atomic uint64_t sums[NUM_METRIC_HISTOGRAMS];
+    struct MetricsBlock* next;  // Registry list
+    void* memory;
+} MetricsBlock;
+
+/* Metrics Snapshot: Process-wide totals over every thread's block */
+typedef struct {
+    uint64_t counters[NUM_METRIC_COUNTERS];
+    uint64_t buckets[NUM_METRIC_HISTOGRAMS][HISTOGRAM_BUCKETS];
+    uint64_t counts[NUM_METRIC_HISTOGRAMS];
+    uint64_t sums[NUM_METRIC_HISTOGRAMS];
+    int threads;                // Blocks summed
+} MetricsSnapshot;
+
+/* Metrics Exporter: Background thread writing periodic snapshots */
+typedef struct {
+    char path[256];
+    MetricsFormat format;
+    int periodMs;
+    atomic_int running;
+    long snapshots;             // Snapshots written, read after stopMetricsExporter
+    pthread_t thread;
+} MetricsExporter;
+
+/* Arena Block: One contiguous region, its bytes follow the header */
+typedef struct ArenaBlock {
+    struct ArenaBlock* next;    // Previously filled block
+    size_t size;
+    size_t used;
+} ArenaBlock;
+
+/* Arena: Bump allocator for one balancer instance
+ * Objects created in an arena are never freed one by one; freeArena
+ * releases all of them at once. Block sizes double, so an instance lives
+ * in a handful of regions.
+ */
+typedef struct {
+    ArenaBlock* head;           // Block currently being bumped
+    size_t nextBlockSize;
+    size_t bytesUsed;
+    int numBlocks;
+} Arena;
+
+/* Load Counter: One server's load in fixed point, alone on a cache line
+ * Dispatchers add deltas with relaxed fetch-add; monitors read without
+ * locks. Padding keeps two servers' counters off the same line.
+ */
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) _Atomic int64_t load;  // Load x LOAD_FIXED_SCALE
+    _Atomic int64_t tasks;                           // Tasks assigned
+} LoadCounter;
+
+/* Load Counters: Atomic per-server mirror of the load column */
+typedef struct {
+    int numServers;
+    LoadCounter* counters;
+    void* block;
+} LoadCounters;
+
+/* Load Snapshot: Copy of all counters taken by a monitoring thread
+ * Each server's values are read atomically; the snapshot as a whole is not
+ * a single instant, since dispatchers keep running while it is taken.
+ */
+typedef struct {
+    int numServers;
+    float* loads;
+    int64_t* tasks;
+    double totalLoad;
+    int64_t totalTasks;
+    int mostLoaded;
+    int leastLoaded;
+} LoadSnapshot;
+
+/* Extremes Node: Winners of one subtree of the imbalance tournament tree
+ * Each field is a server index, or -1 for an empty (padding) subtree.
+ */
+typedef struct {
+    int maxLoad, minLoad;       // Most / least loaded server
+    int maxUtil, minUtil;       // Highest / lowest utilization
+} ExtremesNode;
+
+/* Imbalance Tracker: Fleet total and extremes, updated on every load change
+ * A tournament tree with one leaf per server: each internal node holds the
+ * winners of its two children, the root those of the whole fleet. A load
+ * change replays one leaf-to-root path, so rebalancing decisions read the
+ * average and the extremes in O(1) instead of scanning the fleet.
+ */
+typedef struct {
+    int numServers;
+    int numLeaves;              // numServers rounded up to a power of two
+    double totalLoad;           // Running sum of every load delta
+    ExtremesNode* nodes;        // nodes[1] is the root, leaves from numLeaves
+} ImbalanceTracker;
+
+/* Resource Kind: Dimensions of a multi-resource load vector */
+typedef enum {
+    RESOURCE_CPU,
+    RESOURCE_MEMORY,
+    RESOURCE_NETWORK,
+    RESOURCE_DIMENSIONS     // Number of dimensions
+} ResourceKind;
+
+/* Resource Table: Per-dimension load and capacity columns of a fleet
+ * Server i's load vector is load[d][i] for every dimension d; each column
+ * is cache-line aligned like the ServerTable columns. invCapacity folds in
+ * the dimension's weight, so weighted utilization is a single multiply.
+ */
+typedef struct {
+    int numServers;
+    float weight[RESOURCE_DIMENSIONS];
+    float* capacity[RESOURCE_DIMENSIONS];
+    float* load[RESOURCE_DIMENSIONS];
+    float* invCapacity[RESOURCE_DIMENSIONS];  // weight / capacity
+    void* block;
+    Arena* arena;               // Owning arena, NULL = malloc'd
+} ResourceTable;
+
+/* Server Table: Structure-of-arrays form of the fleet
+ * Each column is cache-line aligned so utilization sweeps are contiguous,
+ * vectorizable loops; invCapacity caches 1/capacity to avoid divisions.
+ */
+typedef struct {
+    int numServers;
+    float* capacity;
+    float* currentLoad;
+    float* invCapacity;
+    LoadCounters* counters;     // Lock-free mirror for monitors, NULL = off
+    ImbalanceTracker* tracker;  // Incremental extremes, NULL = scan per pass
+    ResourceTable* resources;   // Vector loads, NULL = scalar only
+    void* block;
+    Arena* arena;               // Owning arena, NULL = malloc'd
+} ServerTable;
+
+/* Load Monitor: Background thread printing periodic load snapshots */
+typedef struct {
+    const ServerTable* servers;
+    LoadSnapshot* snapshot;
+    int periodMs;
+    atomic_int running;
+    long snapshots;             // Snapshots taken, read after stopLoadMonitor
+    pthread_t thread;
+} LoadMonitor;
+
+/* Hop Search: BFS workspace for hop-count shortest paths on the Graph */
+typedef struct {
+    int capacity;
+    int* queue;
+    int* hops;      // Hop distance from the source, -1 if not reached
+} HopSearch;
+
+/* Migration: One planned load transfer between two servers */
 typedef struct {
-    int id;
-    float capacity;
-    float currentLoad;
-} Server;
+    int from;
+    int to;
+    float amount;
+} Migration;
 
-/* Graph Node: Adjacency list node for server connections */
-typedef struct Node {
+/* Rebalance Candidate: A donor's excess or a receiver's deficit */
+typedef struct {
     int serverId;
-    struct Node* next;
-} Node;
+    float amount;       // Load units above/below the fleet target
+    float deviation;    // Percentage points away from the fleet target
+} RebalanceCandidate;
+
+/* Rebalance Plan: Scratch space and result of one multi-pair planning pass
+ * Sized once for the fleet so planning never allocates.
+ */
+typedef struct {
+    int capacity;
+    int numMigrations;
+    float targetPercent;
+    Migration* migrations;
+    RebalanceCandidate* donors;
+    RebalanceCandidate* receivers;
+    float* scratch;
+} RebalancePlan;
+
+/* Batch Plan: Sort workspace reused across assignBatch calls
+ * A sort key packs ~(load bits) above the task index, so ascending key
+ * order is largest load first with ties in arrival order.
+ */
+typedef struct {
+    int capacity;
+    uint64_t* keys;
+    uint64_t* scratch;
+} BatchPlan;
+
+/* Task Table: Pool of in-flight tasks, indexed by task id
+ * Slots are recycled through a free list, so tracking never allocates.
+ * residentLoad[s] sums the loads of running tasks placed on server s.
+ */
+typedef struct {
+    int capacity;
+    int numActive;
+    int freeHead;       // First free slot, -1 = pool exhausted
+    float* load;
+    int* serverId;      // -1 for free slots
+    int* task;          // Arrival number, for events
+    int* next;          // Free-list link
+    int numServers;
+    double* residentLoad;
+    Arena* arena;       // Owning arena, NULL = malloc'd
+} TaskTable;
 
-/* Graph Structure: Adjacency list representation of server network */
+/* Event Type: What a SimEvent records */
+typedef enum {
+    EVENT_ASSIGN,           // Task placed on serverId
+    EVENT_MIGRATE,          // Load moved from serverId to peerId
+    EVENT_COMPLETE          // Task finished, its load left serverId
+} EventType;
+
+/* Sim Event: One fixed-size record in the event sink */
+typedef struct {
+    int32_t type;           // EventType
+    int32_t task;           // Task number (migrations: last assigned task)
+    int32_t serverId;       // Assigned server / migration source
+    int32_t peerId;         // Migration target, -1 for assignments
+    float amount;           // Task load / migrated load
+    float load;             // serverId's load after the event
+} SimEvent;
+
+/* Event Sink: Ring buffer of events drained to a file by a writer thread
+ * The simulation thread fills slots without locking and publishes them a
+ * chunk (capacity / 4) at a time; the writer thread formats and writes
+ * published ranges, so no file I/O happens on the assignment path.
+ */
+typedef struct {
+    SimEvent* ring;
+    int capacity;             // Power of two
+    int chunkSize;
+    EventFormat format;
+    FILE* file;
+    
+    uint64_t writeIndex;      // Producer: next slot to fill
+    uint64_t publishedIndex;  // Shared: slots visible to the writer
+    uint64_t readIndex;       // Shared: slots already written
+    int lastTask;             // Producer: task number for migration events
+    int closing;
+    long stalls;              // Publishes that waited for the writer
+    
+    pthread_mutex_t lock;
+    pthread_cond_t dataReady;
+    pthread_cond_t spaceReady;
+    pthread_t writer;
+} EventSink;
+
+/* Trace Record: One task arrival in a binary trace (16 bytes, no padding)
+ * A trace file is a 16-byte header (magic "LBTRACE1", uint32 record size,
+ * uint32 reserved) followed by packed records in arrival order, so record
+ * k starts at byte 16 + 16k and the count follows from the file size.
+ */
+typedef struct {
+    double time;            // Arrival time in seconds
+    float load;             // Task load
+    int32_t affinity;       // Server the task must run on, -1 = any
+} TraceRecord;
+
+/* Trace Writer: Buffered appender of TraceRecords */
+typedef struct {
+    FILE* file;
+    TraceRecord* buffer;    // TRACE_BUFFER_RECORDS pending records
+    int count;
+    long long written;      // Records appended so far
+    struct timespec start;  // traceClock origin
+} TraceWriter;
+
+/* Trace Reader: Streaming, memory-mapped view of a binary trace
+ * Only one TRACE_WINDOW_BYTES window is mapped at a time; it is unmapped
+ * when the reader moves on and the kernel is asked to read the next one
+ * ahead, so a trace of any size replays in constant memory at readahead
+ * speed. Records never straddle windows (both are multiples of 16 bytes).
+ */
+typedef struct {
+    int fd;
+    char path[256];
+    long long numRecords;
+    long long nextRecord;   // Index of the next record to return
+    size_t windowSize;      // Bytes per mapping, a multiple of the page size
+    off_t windowOffset;     // File offset of the current mapping
+    size_t windowBytes;     // Length of the current mapping, 0 = none
+    unsigned char* window;
+} TraceReader;
+
+/* Pending Task: An arrival waiting in the admission queue */
+typedef struct {
+    double arrival;         // Arrival time (loop engine: arrival number)
+    double service;         // Event engine: service time, counted from admission
+    float load;
+    int task;               // Arrival number
+    int pin;                // Server the task must run on, -1 = any
+} PendingTask;
+
+/* Admission Queue: Bounded FIFO ring of tasks that did not fit, plus the
+ * counters the run reports
+ */
+typedef struct {
+    PendingTask* slots;
+    int capacity;
+    int head;               // Oldest pending task
+    int count;
+    int virtualTime;        // Waits in virtual seconds (event engine), else arrivals
+    int queued;             // Tasks that entered the queue
+    int rejected;           // Arrivals turned away with the queue full
+    int shed;               // Queued tasks dropped to make room
+    int maxDepth;
+    double totalWait;       // Sum of waits of tasks admitted from the queue
+} AdmissionQueue;
+
+/* Simulation Options: Policy knobs for one simulation run */
+typedef struct {
+    AssignmentMode assignmentMode;
+    SelectionPolicy selectionPolicy;
+    int choices;                // d for SELECT_D_CHOICES
+    RebalanceMode rebalanceMode;
+    float rebalanceThreshold;   // Percentage imbalance threshold
+    int rebalanceInterval;      // Rebalance after every N tasks
+    int maxMigrationHops;       // Topology mode: 1 = direct neighbors only
+    int batchSize;              // Tasks placed per assignBatch call
+    int taskLifetime;           // Arrivals until a task completes, 0 = never
+    LogLevel logLevel;          // Console output detail
+    EventSink* events;          // Event recording, NULL = off
+    TraceWriter* capture;       // Arrival capture, NULL = off
+    TraceReader* replay;        // Arrivals to replay, NULL = synthetic loads
+    AdmissionPolicy admission;  // Tasks that do not fit; ADMIT_ALL = no check
+    int admissionQueue;         // Pending task slots (0 = reject at once)
+    float admissionLimit;       // Admit while the server stays within this % of capacity
+    struct HierarchicalBalancer* hierarchy;  // Two-level heaps, NULL = flat heap
+} SimulationOptions;
+
+/* Timed Event: One entry of the event engine's queue */
+typedef struct {
+    double time;
+    int32_t type;               // TimedEventType
+    int32_t id;                 // Task id for departures
+} TimedEvent;
+
+/* Timed Event Type: What happens when a TimedEvent fires */
+typedef enum {
+    TIMED_ARRIVAL,
+    TIMED_DEPARTURE,
+    TIMED_REBALANCE
+} TimedEventType;
+
+/* Event Queue: 4-ary min-heap of TimedEvents ordered by time
+ * 16-byte events and 4 children per node: like MinHeap, events is offset
+ * so each child group fills exactly one cache line.
+ */
+typedef struct {
+    TimedEvent* events;
+    void* block;
+    int size;
+    int capacity;
+} EventQueue;
+
+/* Load Scan: Result of one fused pass over the server array */
+typedef struct {
+    float totalLoad;
+    int mostLoaded;
+    int leastLoaded;
+} LoadScan;
+
+/* Graph Structure: Compressed sparse row (CSR) representation of the network
+ * Neighbors of server u are neighbors[offsets[u] .. offsets[u+1]), sorted and
+ * de-duplicated. addEdge appends to a contiguous pending edge list, which
+ * buildGraphCSR folds into the CSR arrays in two passes.
+ */
 typedef struct {
     int numServers;
-    Node** adjList;
+    int numEdges;         // Edges in the CSR arrays
+    int* offsets;         // numServers + 1 row offsets
+    int* neighbors;       // numEdges destination IDs
+    int* edgeSrc;         // Pending edges, not yet in the CSR arrays
+    int* edgeDst;
+    int numPending;
+    int pendingCapacity;
+    Arena* arena;         // Owning arena, NULL = malloc'd
 } Graph;
 
 /* Heap Node: Represents a server in the min-heap */
@@ -44,443 +511,6034 @@ typedef struct {
     float load;
 } HeapNode;
 
-/* Min Heap Structure: Priority queue for least-loaded server selection */
+/* Min Heap Structure: Priority queue for least-loaded server selection
+ * pos[] maps serverId -> index in arr (-1 when the server is not in the heap),
+ * so a server's entry can be located in O(1) instead of scanning arr.
+ * Each node has `arity` children at arity*i+1 .. arity*i+arity; arr is offset
+ * inside `block` so that every child group starts on a cache-line boundary.
+ */
 typedef struct {
     HeapNode* arr;
+    int* pos;
+    void* block;
     int size;
     int capacity;
+    int arity;
+    Arena* arena;
 } MinHeap;
 
+/* Shard: A contiguous slice of the fleet with its own heap and lock
+ * Cache-line aligned so producers working on different shards never share
+ * a line. utilization is published atomically so producers can compare
+ * shards without taking their locks.
+ */
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) pthread_mutex_t lock;
+    MinHeap* heap;              // Local IDs 0..numServers-1
+    int firstServer;            // Global ID of local server 0
+    int numServers;
+    float totalLoad;            // Guarded by lock
+    float invTotalCapacity;
+    _Atomic float utilization;  // totalLoad / total capacity
+    long tasksAssigned;         // Guarded by lock
+} Shard;
+
+/* Sharded Balancer: Multi-producer front end over per-shard heaps
+ * Producers pick the less utilized of two random shards and assign under
+ * that shard's lock; a background thread migrates load from the hottest
+ * to the coolest shard.
+ */
+typedef struct {
+    ServerTable* servers;       // currentLoad[i] guarded by i's shard lock
+    Shard* shards;
+    void* block;
+    int numShards;
+    AssignmentMode assignmentMode;
+    float rebalanceThreshold;   // Shard utilization spread, in percent
+    
+    atomic_int running;         // Background rebalancer active
+    pthread_t rebalancer;
+    int periodUs;
+    long rebalances;            // Written by the rebalancing thread only
+    double migratedLoad;
+} ShardedBalancer;
+
+/* Hierarchical Balancer: Two-level heaps over groups (racks) of servers
+ * Group g's members are members[groupStart[g] .. groupStart[g+1]); its two
+ * heaps use member indices 0..size-1 as IDs. The three top-level heaps use
+ * group IDs, so every assignment or migration costs O(log G + log S) for G
+ * groups of S servers. The balancer does not own the servers.
+ */
+typedef struct HierarchicalBalancer {
+    int numServers;
+    int numGroups;
+    int* groupStart;            // numGroups + 1 offsets into members
+    int* members;               // Server IDs, grouped
+    int* groupOf;               // Server -> group
+    int* memberIndex;           // Server -> member index within its group
+    MinHeap** coolest;          // Per group: members by heap key (receivers)
+    MinHeap** hottest;          // Per group: members by -utilization (donors)
+    MinHeap* groups;            // Groups by aggregate load (assignment, receivers)
+    MinHeap* hotGroups;         // Groups by -aggregate utilization (donors)
+    MinHeap* spreads;           // Groups by -(internal imbalance, %)
+    double* groupLoad;          // Sum of member loads
+    float* groupInvCapacity;    // 1 / sum of member capacities
+    AssignmentMode assignmentMode;
+    Arena* arena;               // Owning arena, NULL = malloc'd
+} HierarchicalBalancer;
+
+/* Balancer Instance: Everything one simulation run owns
+ * Independent instances share no state, so a sweep can run one per thread.
+ */
+typedef struct {
+    Arena* arena;               // Backs the parts below, NULL = malloc'd
+    ServerTable* servers;
+    Graph* graph;
+    MinHeap* heap;
+    ImbalanceTracker* tracker;  // NULL = scan for extremes
+    ResourceTable* resources;   // NULL = scalar loads
+} BalancerInstance;
+
+/* Load Balancer: The library handle behind load_balancer.h
+ * One instance plus the per-handle state that simulateTaskAssignment keeps
+ * on its stack: options, the running-task pool, rebalance scratch and the
+ * assignment count since the last pass. opts.events and opts.hierarchy
+ * belong to the handle and are shared with balancerSimulate runs.
+ */
+struct LoadBalancer {
+    BalancerInstance* instance;
+    SimulationOptions opts;
+    TaskTable* tasks;           // NULL when maxTasks is 0
+    RebalancePlan* plan;        // Multi-pair scratch, NULL otherwise
+    HopSearch* search;          // Topology scratch, NULL otherwise
+    int sinceRebalance;
+    long long arrivals;         // Tasks placed; task numbers start at 1
+    LoadBalancerStats stats;
+    LoadCounters* counters;     // balancerStartMonitor, NULL = never monitored
+    LoadMonitor* monitor;       // Running monitor thread, NULL = none
+};
+
+/* Snapshot Header: First 64 bytes of a balancer snapshot file
+ * The sections follow in this order, each starting on a 64-byte boundary:
+ * capacity[n] and currentLoad[n] (float), the heap array[heapSize]
+ * (HeapNode), CSR offsets[n + 1] and neighbors[numEdges] (int32). Values
+ * are in host byte order, like binary traces.
+ */
+typedef struct {
+    char magic[8];              // "LBSNAP01"
+    uint32_t headerBytes;       // sizeof(SnapshotHeader)
+    uint32_t numServers;
+    uint32_t numEdges;
+    uint32_t heapSize;
+    uint32_t heapArity;
+    uint32_t assignmentMode;    // Mode the heap keys were computed for
+    uint64_t fileBytes;         // Whole file, detects truncated snapshots
+    uint64_t reserved[3];
+} SnapshotHeader;
+
+typedef char SnapshotHeaderCheck[(sizeof(SnapshotHeader) == CACHE_LINE_SIZE) ? 1 : -1];
+
+/* ============================================================================
+ * ARENA ALLOCATOR
+ * ============================================================================ */
+
+#define ARENA_ALIGNMENT 16        // Alignment of every arenaAlloc result
+
+/* Create an arena whose first block holds at least initialBytes
+ * Time Complexity: O(1)
+ */
+Arena* createArena(size_t initialBytes) {
+    Arena* arena = (Arena*)malloc(sizeof(Arena));
+    arena->head = NULL;
+    arena->nextBlockSize = (initialBytes > 0) ? initialBytes : ARENA_BLOCK_SIZE;
+    arena->bytesUsed = 0;
+    arena->numBlocks = 0;
+    return arena;
+}
+
+/* Carve bytes out of the arena, aligned to ARENA_ALIGNMENT
+ * A new block (at least double the previous one) is added when the
+ * current block is full.
+ * Returns NULL if the system is out of memory.
+ * Time Complexity: O(1)
+ */
+void* arenaAlloc(Arena* arena, size_t bytes) {
+    bytes = (bytes + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+    
+    ArenaBlock* block = arena->head;
+    if (block == NULL || block->size - block->used < bytes) {
+        size_t size = arena->nextBlockSize;
+        while (size < bytes) {
+            size *= 2;
+        }
+        
+        // Header padded to ARENA_ALIGNMENT so block data stays aligned
+        size_t header = (sizeof(ArenaBlock) + ARENA_ALIGNMENT - 1) &
+                        ~(size_t)(ARENA_ALIGNMENT - 1);
+        block = (ArenaBlock*)malloc(header + size);
+        if (block == NULL) {
+            return NULL;
+        }
+        block->next = arena->head;
+        block->size = header + size;
+        block->used = header;
+        arena->head = block;
+        arena->nextBlockSize = 2 * size;
+        arena->numBlocks++;
+    }
+    
+    void* result = (char*)block + block->used;
+    block->used += bytes;
+    arena->bytesUsed += bytes;
+    return result;
+}
+
+/* Drop every object in the arena but keep its largest block for reuse
+ * Lets a caller running many short-lived instances reuse one region:
+ * after the first run, construction is pure bump allocation on memory
+ * that is already mapped.
+ * Time Complexity: O(blocks)
+ */
+void resetArena(Arena* arena) {
+    ArenaBlock* keep = arena->head;
+    if (keep == NULL) return;
+    
+    // The newest block is the largest; free the older ones
+    ArenaBlock* block = keep->next;
+    while (block != NULL) {
+        ArenaBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+    
+    size_t header = (sizeof(ArenaBlock) + ARENA_ALIGNMENT - 1) &
+                    ~(size_t)(ARENA_ALIGNMENT - 1);
+    keep->next = NULL;
+    keep->used = header;
+    arena->bytesUsed = 0;
+    arena->numBlocks = 1;
+}
+
+/* Release every block, and so every object created in the arena
+ * Time Complexity: O(blocks)
+ */
+void freeArena(Arena* arena) {
+    ArenaBlock* block = arena->head;
+    while (block != NULL) {
+        ArenaBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+    free(arena);
+}
+
+/* First-block size for a balancer instance of numServers servers
+ * ~96 bytes per server covers the server table, heap, CSR graph (with its
+ * pending edge arrays) and a task table, so one block usually suffices.
+ */
+size_t instanceArenaBytes(int numServers) {
+    return (size_t)numServers * 96 + 4096;
+}
+
+/* Allocate from arena, or from malloc when arena is NULL */
+static void* lbAlloc(Arena* arena, size_t bytes) {
+    return arena ? arenaAlloc(arena, bytes) : malloc(bytes);
+}
+
+/* Zeroed lbAlloc */
+static void* lbCalloc(Arena* arena, size_t count, size_t size) {
+    if (arena == NULL) {
+        return calloc(count, size);
+    }
+    void* memory = arenaAlloc(arena, count * size);
+    if (memory) {
+        memset(memory, 0, count * size);
+    }
+    return memory;
+}
+
+/* Grow an lbAlloc'd array; arena memory is copied, the old copy is
+ * reclaimed with the arena */
+static void* lbRealloc(Arena* arena, void* memory, size_t oldBytes, size_t newBytes) {
+    if (arena == NULL) {
+        return realloc(memory, newBytes);
+    }
+    void* grown = arenaAlloc(arena, newBytes);
+    if (grown && memory) {
+        memcpy(grown, memory, (oldBytes < newBytes) ? oldBytes : newBytes);
+    }
+    return grown;
+}
+
+/* Free lbAlloc'd memory (a no-op for arena memory) */
+static void lbFree(Arena* arena, void* memory) {
+    if (arena == NULL) {
+        free(memory);
+    }
+}
+
+/* ============================================================================
+ * RANDOM NUMBERS
+ * ============================================================================ */
+
+static _Thread_local Rng threadRngState;
+static _Thread_local int threadRngSeeded;
+
+/* splitmix64 step: expands one 64-bit seed into well-mixed state words */
+static inline uint64_t splitMix64(uint64_t* x) {
+    uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static inline uint64_t rotateLeft64(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+/* Seed a generator; equal seeds give equal streams
+ * Time Complexity: O(1)
+ */
+void seedRng(Rng* rng, uint64_t seed) {
+    for (int i = 0; i < 4; i++) {
+        rng->s[i] = splitMix64(&seed);
+    }
+}
+
+/* Next 64 random bits (xoshiro256**) */
+static inline uint64_t rngNext(Rng* rng) {
+    uint64_t* s = rng->s;
+    uint64_t result = rotateLeft64(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotateLeft64(s[3], 45);
+    return result;
+}
+
+/* Uniform integer in [0, n) by multiply-shift (no division) */
+static inline uint32_t rngBelow(Rng* rng, uint32_t n) {
+    return (uint32_t)(((rngNext(rng) >> 32) * (uint64_t)n) >> 32);
+}
+
+/* Uniform double in [0, 1) with 53 random bits */
+static inline double rngUniform(Rng* rng) {
+    return (double)(rngNext(rng) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* Uniform float in [lo, hi) */
+static inline float rngRange(Rng* rng, float lo, float hi) {
+    return lo + (float)(rngNext(rng) >> 40) * (1.0f / 16777216.0f) * (hi - lo);
+}
+
+/* Fill out[0..n) with uniform floats in [lo, hi)
+ * Same values as n rngRange calls, so a seeded workload does not depend
+ * on how it is batched; the state stays in registers for the whole loop.
+ * Time Complexity: O(n)
+ */
+void rngFillUniform(Rng* rng, float* out, int n, float lo, float hi) {
+    Rng local = *rng;
+    for (int i = 0; i < n; i++) {
+        out[i] = rngRange(&local, lo, hi);
+    }
+    *rng = local;
+}
+
+/* Advance the generator by 2^128 steps
+ * Time Complexity: O(1) (256 generator steps)
+ */
+void rngJump(Rng* rng) {
+    static const uint64_t jump[4] = {0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+                                     0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL};
+    uint64_t s[4] = {0, 0, 0, 0};
+    
+    for (int i = 0; i < 4; i++) {
+        for (int b = 0; b < 64; b++) {
+            if (jump[i] & (1ULL << b)) {
+                for (int k = 0; k < 4; k++) {
+                    s[k] ^= rng->s[k];
+                }
+            }
+            rngNext(rng);
+        }
+    }
+    memcpy(rng->s, s, sizeof(s));
+}
+
+/* Independent stream for a worker: the parent's current stream, after
+ * which the parent jumps ahead 2^128 steps so the two never overlap
+ * Time Complexity: O(1)
+ */
+Rng splitRng(Rng* parent) {
+    Rng child = *parent;
+    rngJump(parent);
+    return child;
+}
+
+/* Seed the calling thread's generator
+ * Time Complexity: O(1)
+ */
+void seedThreadRng(uint64_t seed) {
+    seedRng(&threadRngState, seed);
+    threadRngSeeded = 1;
+}
+
+/* The calling thread's generator; seeded with 0 if seedThreadRng was
+ * never called on this thread
+ */
+Rng* threadRng(void) {
+    if (!threadRngSeeded) {
+        seedThreadRng(0);
+    }
+    return &threadRngState;
+}
+
+/* ============================================================================
+ * METRICS
+ * ============================================================================ */
+
+/* Exported name, help text and scale (stored value / scale = exported) */
+typedef struct {
+    const char* name;
+    const char* help;
+    double scale;
+} MetricInfo;
+
+static const MetricInfo counterInfo[NUM_METRIC_COUNTERS] = {
+    {"tasks_assigned", "Tasks placed on a server", 1.0},
+    {"tasks_completed", "Tasks released by completeTask", 1.0},
+    {"heap_sift_ups", "heapifyUp calls", 1.0},
+    {"heap_sift_downs", "heapifyDown calls", 1.0},
+    {"heap_sift_levels", "Heap levels moved by all sifts", 1.0},
+    {"heap_extracts", "extractMin calls", 1.0},
+    {"heap_updates", "updateHeap calls", 1.0},
+    {"heap_update_misses", "updateHeap calls for a server not in the heap", 1.0},
+    {"rebalance_checks", "Rebalance passes run", 1.0},
+    {"rebalances", "Rebalance passes that migrated load", 1.0},
+    {"migrations", "Single load migrations", 1.0},
+    {"migrated_load", "Load units migrated", 1000.0},
+    {"tasks_queued", "Arrivals queued by admission control", 1.0},
+    {"tasks_rejected", "Arrivals rejected with the admission queue full", 1.0},
+    {"tasks_shed", "Queued tasks shed to make room for newer arrivals", 1.0},
+    {"local_migrations", "Migrations between two servers of the same group", 1.0}
+};
+
+static const MetricInfo histogramInfo[NUM_METRIC_HISTOGRAMS] = {
+    {"heap_sift_depth", "Levels moved per sift", 1.0},
+    {"assign_seconds", "assignTask latency, sampled", 1e9},
+    {"rebalance_seconds", "rebalancePass latency", 1e9},
+    {"migration_load", "Load units per migration", 1000.0},
+    {"admission_queue_depth", "Pending tasks after each enqueue", 1.0},
+    {"queue_wait_arrivals", "Arrivals a queued task waited (loop engine)", 1.0},
+    {"queue_wait_seconds", "Virtual seconds a queued task waited (event engine)", 1e9}
+};
+
+/* Owner-only increment: relaxed load + store, no locked instruction */
+static inline void bumpMetric(_Atomic uint64_t* slot, uint64_t n) {
+    atomic_store_explicit(slot, atomic_load_explicit(slot, memory_order_relaxed) + n,
+                          memory_order_relaxed);
+}
+
+static inline void bumpMetricBy(_Atomic uint64_t* slot, const _Atomic uint64_t* from) {
+    bumpMetric(slot, atomic_load_explicit(from, memory_order_relaxed));
+}
+
+static pthread_mutex_t metricsLock = PTHREAD_MUTEX_INITIALIZER;
+static MetricsBlock* metricsBlocks = NULL;     // Blocks of live threads
+static MetricsBlock retiredMetrics;            // Sum of exited threads' blocks
+static pthread_key_t metricsKey;               // Destructor: retireThreadMetrics
+static pthread_once_t metricsKeyOnce = PTHREAD_ONCE_INIT;
+static _Thread_local MetricsBlock* threadMetricsBlock;
+
+/* Add every count of from to into (under metricsLock; into has no owner) */
+static void foldMetricsBlock(MetricsBlock* into, const MetricsBlock* from) {
+    for (int c = 0; c < NUM_METRIC_COUNTERS; c++) {
+        bumpMetricBy(&into->counters[c], &from->counters[c]);
+    }
+    for (int h = 0; h < NUM_METRIC_HISTOGRAMS; h++) {
+        for (int b = 0; b < HISTOGRAM_BUCKETS; b++) {
+            bumpMetricBy(&into->buckets[h][b], &from->buckets[h][b]);
+        }
+        bumpMetricBy(&into->sums[h], &from->sums[h]);
+    }
+}
+
+/* Thread exit: fold the thread's counts into retiredMetrics and free its
+ * block, so short-lived producer threads do not grow the registry
+ * Time Complexity: O(threads + counters + histogram buckets)
+ */
+static void retireThreadMetrics(void* arg) {
+    MetricsBlock* block = (MetricsBlock*)arg;
+    pthread_mutex_lock(&metricsLock);
+    foldMetricsBlock(&retiredMetrics, block);
+    MetricsBlock** link = &metricsBlocks;
+    while (*link != block) {
+        link = &(*link)->next;
+    }
+    *link = block->next;
+    pthread_mutex_unlock(&metricsLock);
+    
+    threadMetricsBlock = NULL;
+    free(block->memory);
+}
+
+static void createMetricsKey(void) {
+    pthread_key_create(&metricsKey, retireThreadMetrics);
+}
+
+/* Allocate and register the calling thread's block (first use only)
+ * The block is retired when its thread exits; its counts stay in the
+ * totals through retiredMetrics.
+ */
+static MetricsBlock* registerThreadMetrics(void) {
+    void* memory = malloc(sizeof(MetricsBlock) + CACHE_LINE_SIZE);
+    uintptr_t aligned = ((uintptr_t)memory + CACHE_LINE_SIZE - 1) &
+                        ~(uintptr_t)(CACHE_LINE_SIZE - 1);
+    MetricsBlock* block = (MetricsBlock*)aligned;
+    memset(block, 0, sizeof(MetricsBlock));
+    block->memory = memory;
+    
+    pthread_once(&metricsKeyOnce, createMetricsKey);
+    pthread_mutex_lock(&metricsLock);
+    block->next = metricsBlocks;
+    metricsBlocks = block;
+    pthread_mutex_unlock(&metricsLock);
+    pthread_setspecific(metricsKey, block);
+    
+    threadMetricsBlock = block;
+    return block;
+}
+
+static inline MetricsBlock* threadMetrics(void) {
+    MetricsBlock* block = threadMetricsBlock;
+    return block ? block : registerThreadMetrics();
+}
+
+/* Add n to one of the calling thread's counters
+ * Time Complexity: O(1)
+ */
+static inline void metricAdd(MetricCounter counter, uint64_t n) {
+    bumpMetric(&threadMetrics()->counters[counter], n);
+}
+
+/* Record one value in a histogram: bucket = bit length of the value
+ * Time Complexity: O(1)
+ */
+static inline void metricObserve(MetricHistogram histogram, uint64_t value) {
+    MetricsBlock* block = threadMetrics();
+    int bucket = 0;
+    if (value > 0) {
+        bucket = 64 - __builtin_clzll(value);
+        if (bucket >= HISTOGRAM_BUCKETS) bucket = HISTOGRAM_BUCKETS - 1;
+    }
+    bumpMetric(&block->buckets[histogram][bucket], 1);
+    bumpMetric(&block->sums[histogram], value);
+}
+
+/* Monotonic clock in nanoseconds, for latency histograms */
+static inline uint64_t metricClockNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* Start time for one call in every METRIC_SAMPLE_PERIOD, 0 otherwise */
+static inline uint64_t metricSampleClock(MetricCounter counter) {
+    uint64_t count = atomic_load_explicit(&threadMetrics()->counters[counter],
+                                          memory_order_relaxed);
+    return (count & (METRIC_SAMPLE_PERIOD - 1)) == 0 ? metricClockNs() : 0;
+}
+
+/* One load migration: count, migrated total and size histogram */
+static inline void metricMigration(float amount) {
+    uint64_t milli = (uint64_t)llrintf(amount * 1000.0f);
+    metricAdd(METRIC_MIGRATIONS, 1);
+    metricAdd(METRIC_MIGRATED_LOAD, milli);
+    metricObserve(HISTOGRAM_MIGRATION_LOAD, milli);
+}
+
+#if LOAD_BALANCER_METRICS
+#define METRIC_ADD(counter, n) metricAdd((counter), (uint64_t)(n))
+#define METRIC_MIGRATION(amount) metricMigration(amount)
+#define METRIC_OBSERVE(histogram, value) metricObserve((histogram), (uint64_t)(value))
+#define METRIC_CLOCK(var) uint64_t var = metricClockNs()
+#define METRIC_SAMPLE_CLOCK(var, counter) uint64_t var = metricSampleClock(counter)
+#define METRIC_OBSERVE_SINCE(histogram, start) \
+    do { if (start) metricObserve((histogram), metricClockNs() - (start)); } while (0)
+#else
+#define METRIC_ADD(counter, n) ((void)0)
+#define METRIC_MIGRATION(amount) ((void)0)
+#define METRIC_OBSERVE(histogram, value) ((void)0)
+#define METRIC_CLOCK(var) ((void)0)
+#define METRIC_SAMPLE_CLOCK(var, counter) ((void)0)
+#define METRIC_OBSERVE_SINCE(histogram, start) ((void)0)
+#endif
+
+/* Sum every live thread's block and the retired totals into snapshot
+ * Wait-free for the recording threads; the registry lock only keeps the
+ * block list stable. snapshot->threads counts live threads.
+ * Time Complexity: O(live threads x (counters + histogram buckets))
+ */
+void takeMetricsSnapshot(MetricsSnapshot* snapshot) {
+    memset(snapshot, 0, sizeof(MetricsSnapshot));
+    
+    pthread_mutex_lock(&metricsLock);
+    for (MetricsBlock* block = &retiredMetrics; block;
+         block = (block == &retiredMetrics) ? metricsBlocks : block->next) {
+        for (int c = 0; c < NUM_METRIC_COUNTERS; c++) {
+            snapshot->counters[c] += atomic_load_explicit(&block->counters[c],
+                                                          memory_order_relaxed);
+        }
+        for (int h = 0; h < NUM_METRIC_HISTOGRAMS; h++) {
+            for (int b = 0; b < HISTOGRAM_BUCKETS; b++) {
+                uint64_t n = atomic_load_explicit(&block->buckets[h][b],
+                                                  memory_order_relaxed);
+                snapshot->buckets[h][b] += n;
+                snapshot->counts[h] += n;
+            }
+            snapshot->sums[h] += atomic_load_explicit(&block->sums[h],
+                                                      memory_order_relaxed);
+        }
+        snapshot->threads += (block != &retiredMetrics);
+    }
+    pthread_mutex_unlock(&metricsLock);
+}
+
+/* Zero every registered block and the retired totals (call while no
+ * thread is recording)
+ * Time Complexity: O(live threads)
+ */
+void resetMetrics(void) {
+    pthread_mutex_lock(&metricsLock);
+    memset(&retiredMetrics, 0, sizeof(MetricsBlock));
+    for (MetricsBlock* block = metricsBlocks; block; block = block->next) {
+        MetricsBlock* next = block->next;
+        void* memory = block->memory;
+        memset(block, 0, sizeof(MetricsBlock));
+        block->next = next;
+        block->memory = memory;
+    }
+    pthread_mutex_unlock(&metricsLock);
+}
+
+/* Inclusive upper bound of bucket b in stored units (last bucket: none) */
+static double histogramBucketBound(int b) {
+    return (double)((1ULL << b) - 1);
+}
+
+/* Write snapshot as one line of JSON
+ * Time Complexity: O(counters + histogram buckets)
+ */
+void writeMetricsJson(FILE* out, const MetricsSnapshot* snapshot, double timestamp) {
+    fprintf(out, "{\"timestamp\": %.3f, \"threads\": %d, \"counters\": {",
+            timestamp, snapshot->threads);
+    for (int c = 0; c < NUM_METRIC_COUNTERS; c++) {
+        fprintf(out, "%s\"%s\": %.15g", c ? ", " : "", counterInfo[c].name,
+                snapshot->counters[c] / counterInfo[c].scale);
+    }
+    fprintf(out, "}, \"histograms\": {");
+    for (int h = 0; h < NUM_METRIC_HISTOGRAMS; h++) {
+        const MetricInfo* info = &histogramInfo[h];
+        fprintf(out, "%s\"%s\": {\"count\": %llu, \"sum\": %.15g, \"buckets\": [",
+                h ? ", " : "", info->name, (unsigned long long)snapshot->counts[h],
+                snapshot->sums[h] / info->scale);
+        
+        // Only non-empty buckets, as [upper bound, count] pairs
+        int first = 1;
+        for (int b = 0; b < HISTOGRAM_BUCKETS; b++) {
+            if (snapshot->buckets[h][b] == 0) continue;
+            if (b == HISTOGRAM_BUCKETS - 1) {
+                fprintf(out, "%s[null, %llu]", first ? "" : ", ",
+                        (unsigned long long)snapshot->buckets[h][b]);
+            } else {
+                fprintf(out, "%s[%.9g, %llu]", first ? "" : ", ",
+                        histogramBucketBound(b) / info->scale,
+                        (unsigned long long)snapshot->buckets[h][b]);
+            }
+            first = 0;
+        }
+        fprintf(out, "]}");
+    }
+    fprintf(out, "}}\n");
+}
+
+/* Write snapshot in the Prometheus text exposition format
+ * Counters become lb_<name>_total; histograms get cumulative le buckets
+ * up to the highest non-empty one, then +Inf, _sum and _count.
+ * Time Complexity: O(counters + histogram buckets)
+ */
+void writeMetricsPrometheus(FILE* out, const MetricsSnapshot* snapshot) {
+    for (int c = 0; c < NUM_METRIC_COUNTERS; c++) {
+        const MetricInfo* info = &counterInfo[c];
+        fprintf(out, "# HELP lb_%s_total %s\n# TYPE lb_%s_total counter\n",
+                info->name, info->help, info->name);
+        fprintf(out, "lb_%s_total %.15g\n", info->name,
+                snapshot->counters[c] / info->scale);
+    }
+    for (int h = 0; h < NUM_METRIC_HISTOGRAMS; h++) {
+        const MetricInfo* info = &histogramInfo[h];
+        fprintf(out, "# HELP lb_%s %s\n# TYPE lb_%s histogram\n",
+                info->name, info->help, info->name);
+        
+        int last = -1;
+        for (int b = 0; b < HISTOGRAM_BUCKETS - 1; b++) {
+            if (snapshot->buckets[h][b]) last = b;
+        }
+        uint64_t cumulative = 0;
+        for (int b = 0; b <= last; b++) {
+            cumulative += snapshot->buckets[h][b];
+            fprintf(out, "lb_%s_bucket{le=\"%.9g\"} %llu\n", info->name,
+                    histogramBucketBound(b) / info->scale,
+                    (unsigned long long)cumulative);
+        }
+        fprintf(out, "lb_%s_bucket{le=\"+Inf\"} %llu\n", info->name,
+                (unsigned long long)snapshot->counts[h]);
+        fprintf(out, "lb_%s_sum %.15g\n", info->name, snapshot->sums[h] / info->scale);
+        fprintf(out, "lb_%s_count %llu\n", info->name,
+                (unsigned long long)snapshot->counts[h]);
+    }
+}
+
+/* Take a snapshot and write it to path: JSON lines are appended,
+ * Prometheus text replaces the file (written aside, then renamed, so a
+ * scraper never reads half a file)
+ * Returns 0, or -1 if the file cannot be written.
+ */
+int exportMetrics(const char* path, MetricsFormat format) {
+    MetricsSnapshot snapshot;
+    takeMetricsSnapshot(&snapshot);
+    
+    if (format == METRICS_FORMAT_JSON) {
+        FILE* out = fopen(path, "a");
+        if (out == NULL) return -1;
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        writeMetricsJson(out, &snapshot, now.tv_sec + now.tv_nsec * 1e-9);
+        fclose(out);
+        return 0;
+    }
+    
+    char tmpPath[sizeof(((MetricsExporter*)0)->path) + 8];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+    FILE* out = fopen(tmpPath, "w");
+    if (out == NULL) return -1;
+    writeMetricsPrometheus(out, &snapshot);
+    fclose(out);
+    return rename(tmpPath, path);
+}
+
+static void* metricsExporterThread(void* arg) {
+    MetricsExporter* exporter = (MetricsExporter*)arg;
+    struct timespec period = {exporter->periodMs / 1000,
+                              (long)(exporter->periodMs % 1000) * 1000000L};
+    
+    while (atomic_load(&exporter->running)) {
+        nanosleep(&period, NULL);
+        if (exportMetrics(exporter->path, exporter->format) == 0) {
+            exporter->snapshots++;
+        }
+    }
+    return NULL;
+}
+
+/* Start exporting a snapshot to path every periodMs
+ * A JSON export starts from an empty file. Returns NULL (with a message)
+ * if the file or the thread cannot be created.
+ * Time Complexity: O(1); each export is O(threads x buckets)
+ */
+MetricsExporter* startMetricsExporter(const char* path, MetricsFormat format,
+                                      int periodMs) {
+    if (strlen(path) >= sizeof(((MetricsExporter*)0)->path)) {
+        printf("Metrics path too long: '%s'\n", path);
+        return NULL;
+    }
+    FILE* out = fopen(path, "w");
+    if (out == NULL) {
+        printf("Cannot open metrics file '%s'\n", path);
+        return NULL;
+    }
+    fclose(out);
+    
+    MetricsExporter* exporter = (MetricsExporter*)malloc(sizeof(MetricsExporter));
+    strcpy(exporter->path, path);
+    exporter->format = format;
+    exporter->periodMs = periodMs;
+    exporter->snapshots = 0;
+    atomic_init(&exporter->running, 1);
+    
+    if (pthread_create(&exporter->thread, NULL, metricsExporterThread, exporter) != 0) {
+        printf("Cannot start metrics exporter thread\n");
+        free(exporter);
+        return NULL;
+    }
+    return exporter;
+}
+
+/* Stop the exporter, write one final snapshot and free it
+ * Returns the number of snapshots written.
+ * Time Complexity: O(1) plus up to one period waiting for the thread
+ */
+long stopMetricsExporter(MetricsExporter* exporter) {
+    atomic_store(&exporter->running, 0);
+    pthread_join(exporter->thread, NULL);
+    if (exportMetrics(exporter->path, exporter->format) == 0) {
+        exporter->snapshots++;
+    }
+    long snapshots = exporter->snapshots;
+    free(exporter);
+    return snapshots;
+}
+
+/* ============================================================================
+ * GRAPH FUNCTIONS
+ * ============================================================================ */
+
+/* Create a graph with numServers nodes and no edges in arena (NULL = malloc)
+ * Time Complexity: O(n)
+ */
+Graph* createGraphIn(Arena* arena, int numServers) {
+    Graph* graph = (Graph*)lbAlloc(arena, sizeof(Graph));
+    graph->arena = arena;
+    graph->numServers = numServers;
+    graph->numEdges = 0;
+    
+    // Every row starts empty
+    graph->offsets = (int*)lbCalloc(arena, numServers + 1, sizeof(int));
+    graph->neighbors = NULL;
+    
+    graph->edgeSrc = NULL;
+    graph->edgeDst = NULL;
+    graph->numPending = 0;
+    graph->pendingCapacity = 0;
+    
+    return graph;
+}
+
+/* Create a malloc-backed graph with numServers nodes and no edges
+ * Time Complexity: O(n)
+ */
+Graph* createGraph(int numServers) {
+    return createGraphIn(NULL, numServers);
+}
+
+/* Add a directed edge from src to dest in the graph
+ * The edge is appended to the pending edge list (grown by doubling, so no
+ * per-edge allocation) and becomes visible after buildGraphCSR.
+ * Time Complexity: O(1) amortized
+ */
+void addEdge(Graph* graph, int src, int dest) {
+    if (src < 0 || src >= graph->numServers ||
+        dest < 0 || dest >= graph->numServers) {
+        printf("Edge %d → %d out of range!\n", src, dest);
+        return;
+    }
+    
+    if (graph->numPending == graph->pendingCapacity) {
+        int newCapacity = graph->pendingCapacity ? 2 * graph->pendingCapacity : 16;
+        size_t oldBytes = graph->pendingCapacity * sizeof(int);
+        graph->edgeSrc = (int*)lbRealloc(graph->arena, graph->edgeSrc, oldBytes,
+                                         newCapacity * sizeof(int));
+        graph->edgeDst = (int*)lbRealloc(graph->arena, graph->edgeDst, oldBytes,
+                                         newCapacity * sizeof(int));
+        graph->pendingCapacity = newCapacity;
+    }
+    
+    graph->edgeSrc[graph->numPending] = src;
+    graph->edgeDst[graph->numPending] = dest;
+    graph->numPending++;
+}
+
+/* qsort order for neighbor IDs */
+static int compareNeighbors(const void* a, const void* b) {
+    int x = *(const int*)a;
+    int y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+/* Sort one CSR row in place
+ * Insertion sort for the usual short rows, qsort from 32 entries on so a
+ * hub row with d edges costs O(d log d) instead of O(d^2).
+ * Time Complexity: O(d log d) (O(d^2) below 32 entries)
+ */
+static void sortRow(int* row, int length) {
+    if (length >= 32) {
+        qsort(row, length, sizeof(int), compareNeighbors);
+        return;
+    }
+    for (int i = 1; i < length; i++) {
+        int v = row[i];
+        int j = i - 1;
+        while (j >= 0 && row[j] > v) {
+            row[j + 1] = row[j];
+            j--;
+        }
+        row[j + 1] = v;
+    }
+}
+
+/* Fold all pending edges into the CSR arrays
+ * Pass 1 adds pending out-degrees to the built row lengths and prefix-sums
+ * them into offsets; built rows are copied over as they are. Pass 2
+ * scatters pending destinations after them. Only rows that gained edges
+ * are sorted, and repeated edges are dropped while compacting, so addEdge
+ * may be called again after a build without re-sorting the whole graph.
+ * Time Complexity: O(V + E + P log d) for P pending edges, d = max out-degree
+ */
+void buildGraphCSR(Graph* graph) {
+    if (graph->numPending == 0) return;
+    
+    int n = graph->numServers;
+    int m = graph->numEdges + graph->numPending;
+    const int* built = graph->offsets;
+    Arena* arena = graph->arena;
+    int* offsets = (int*)lbCalloc(arena, n + 1, sizeof(int));
+    int* neighbors = (int*)lbAlloc(arena, m * sizeof(int));
+    int* cursor = (int*)lbAlloc(arena, n * sizeof(int));
+    
+    // Pass 1: row lengths (built + pending), prefix sum, copy built rows
+    for (int e = 0; e < graph->numPending; e++) {
+        offsets[graph->edgeSrc[e] + 1]++;
+    }
+    for (int u = 0; u < n; u++) {
+        int builtDegree = built[u + 1] - built[u];
+        offsets[u + 1] += offsets[u] + builtDegree;
+        cursor[u] = offsets[u] + builtDegree;
+        if (builtDegree > 0) {
+            memcpy(neighbors + offsets[u], graph->neighbors + built[u],
+                   builtDegree * sizeof(int));
+        }
+    }
+    
+    // Pass 2: scatter pending destinations after the built ones
+    for (int e = 0; e < graph->numPending; e++) {
+        neighbors[cursor[graph->edgeSrc[e]]++] = graph->edgeDst[e];
+    }
+    lbFree(arena, cursor);
+    
+    // Sort rows that gained edges and drop repeated edges while compacting
+    int write = 0;
+    int rowStart = 0;
+    for (int u = 0; u < n; u++) {
+        int rowEnd = offsets[u + 1];
+        if (rowEnd - rowStart > built[u + 1] - built[u]) {
+            sortRow(neighbors + rowStart, rowEnd - rowStart);
+        }
+        
+        offsets[u] = write;
+        for (int k = rowStart; k < rowEnd; k++) {
+            if (write == offsets[u] || neighbors[write - 1] != neighbors[k]) {
+                neighbors[write++] = neighbors[k];
+            }
+        }
+        rowStart = rowEnd;
+    }
+    offsets[n] = write;
+    
+    lbFree(arena, graph->offsets);
+    lbFree(arena, graph->neighbors);
+    graph->offsets = offsets;
+    if (arena == NULL) {
+        // Return the space of dropped duplicates (arena memory stays put)
+        graph->neighbors = (write > 0) ? (int*)realloc(neighbors, write * sizeof(int))
+                                       : (free(neighbors), NULL);
+    } else {
+        graph->neighbors = neighbors;
+    }
+    graph->numEdges = write;
+    graph->numPending = 0;
+}
+
+/* Number of outgoing edges of server u (graph must be built)
+ * Time Complexity: O(1)
+ */
+int graphDegree(const Graph* graph, int u) {
+    return graph->offsets[u + 1] - graph->offsets[u];
+}
+
+/* Contiguous neighbor IDs of server u, graphDegree(graph, u) entries
+ * Time Complexity: O(1)
+ */
+const int* graphNeighbors(const Graph* graph, int u) {
+    return graph->neighbors + graph->offsets[u];
+}
+
+/* Free graph memory (arena graphs are released by freeArena)
+ * Time Complexity: O(1)
+ */
+void freeGraph(Graph* graph) {
+    if (graph->arena) return;
+    free(graph->offsets);
+    free(graph->neighbors);
+    free(graph->edgeSrc);
+    free(graph->edgeDst);
+    free(graph);
+}
+
+/* Build the demo's random topology: 1-3 outgoing edges per server
+ * Self-loops are skipped and repeated picks are de-duplicated by the CSR
+ * build, so a server may end up with fewer edges.
+ * Time Complexity: O(V + E)
+ */
+Graph* generateRandomTopologyIn(Arena* arena, int numServers) {
+    Graph* graph = createGraphIn(arena, numServers);
+    Rng* rng = threadRng();
+    
+    for (int i = 0; i < numServers; i++) {
+        int neighbors = 1 + (int)rngBelow(rng, 3);  // 1-3 connections per server
+        for (int j = 0; j < neighbors; j++) {
+            int dest = (int)rngBelow(rng, (uint32_t)numServers);
+            if (dest != i) {
+                addEdge(graph, i, dest);
+            }
+        }
+    }
+    
+    buildGraphCSR(graph);
+    return graph;
+}
+
+/* Malloc-backed generateRandomTopologyIn
+ * Time Complexity: O(V + E)
+ */
+Graph* generateRandomTopology(int numServers) {
+    return generateRandomTopologyIn(NULL, numServers);
+}
+
+/* Create BFS workspace for graphs of up to numServers nodes
+ * Time Complexity: O(n)
+ */
+HopSearch* createHopSearch(int numServers) {
+    HopSearch* search = (HopSearch*)malloc(sizeof(HopSearch));
+    search->capacity = numServers;
+    search->queue = (int*)malloc(numServers * sizeof(int));
+    search->hops = (int*)malloc(numServers * sizeof(int));
+    for (int i = 0; i < numServers; i++) {
+        search->hops[i] = -1;
+    }
+    return search;
+}
+
+/* Breadth-first search from src following edges, up to maxHops away
+ * Fills search->hops[] for every reached server and search->queue with the
+ * reached servers in BFS order. Returns the number of servers reached
+ * (including src). Call clearHopSearch before reusing the workspace.
+ * Time Complexity: O(V + E) worst case, only the visited region in practice
+ */
+int searchWithinHops(Graph* graph, int src, int maxHops, HopSearch* search) {
+    buildGraphCSR(graph);
+    
+    int head = 0, tail = 0;
+    search->queue[tail++] = src;
+    search->hops[src] = 0;
+    
+    while (head < tail) {
+        int u = search->queue[head++];
+        if (search->hops[u] >= maxHops) continue;
+        
+        const int* row = graphNeighbors(graph, u);
+        int degree = graphDegree(graph, u);
+        for (int k = 0; k < degree; k++) {
+            int v = row[k];
+            if (search->hops[v] == -1) {
+                search->hops[v] = search->hops[u] + 1;
+                search->queue[tail++] = v;
+            }
+        }
+    }
+    
+    return tail;
+}
+
+/* Reset the hop distances written by the last search
+ * Time Complexity: O(reached)
+ */
+void clearHopSearch(HopSearch* search, int reached) {
+    for (int k = 0; k < reached; k++) {
+        search->hops[search->queue[k]] = -1;
+    }
+}
+
+/* Free BFS workspace
+ * Time Complexity: O(1)
+ */
+void freeHopSearch(HopSearch* search) {
+    free(search->queue);
+    free(search->hops);
+    free(search);
+}
+
+/* ============================================================================
+ * MIN HEAP FUNCTIONS
+ * ============================================================================ */
+
+/* Create a d-ary min heap with given capacity and arity (2, 4 or 8) in
+ * arena (NULL = malloc)
+ * With 8-byte HeapNodes, the 8 children of a node fill exactly one 64-byte
+ * cache line (4 children fill half of one), so each level of heapifyDown
+ * touches a single line. Server IDs must lie in [0, capacity).
+ * Time Complexity: O(n)
+ */
+MinHeap* createDaryHeapIn(Arena* arena, int capacity, int arity) {
+    if (arity != 2 && arity != 4 && arity != 8) {
+        printf("Unsupported heap arity %d, using 2\n", arity);
+        arity = 2;
+    }
+    
+    MinHeap* heap = (MinHeap*)lbAlloc(arena, sizeof(MinHeap));
+    heap->arena = arena;
+    
+    // Over-allocate one cache line and shift arr so that &arr[1] is aligned:
+    // children of node i start at arity*i + 1, a multiple of arity past 1
+    heap->block = lbAlloc(arena, capacity * sizeof(HeapNode) + CACHE_LINE_SIZE);
+    uintptr_t firstChild = (uintptr_t)heap->block + sizeof(HeapNode);
+    uintptr_t aligned = (firstChild + CACHE_LINE_SIZE - 1) &
+                        ~(uintptr_t)(CACHE_LINE_SIZE - 1);
+    heap->arr = (HeapNode*)(aligned - sizeof(HeapNode));
+    
+    heap->pos = (int*)lbAlloc(arena, capacity * sizeof(int));
+    heap->size = 0;
+    heap->capacity = capacity;
+    heap->arity = arity;
+    
+    // No server is in the heap yet
+    for (int i = 0; i < capacity; i++) {
+        heap->pos[i] = -1;
+    }
+    
+    return heap;
+}
+
+/* Create a malloc-backed d-ary min heap
+ * Time Complexity: O(n)
+ */
+MinHeap* createDaryHeap(int capacity, int arity) {
+    return createDaryHeapIn(NULL, capacity, arity);
+}
+
+/* Create a binary min heap with given capacity
+ * Time Complexity: O(n)
+ */
+MinHeap* createMinHeap(int capacity) {
+    return createDaryHeap(capacity, 2);
+}
+
+/* Move a node up the heap to maintain min-heap property
+ * Hole-based: larger parents are shifted down into the hole and the saved
+ * node is written once at its final slot, instead of swapping every level.
+ * Time Complexity: O(log n)
+ */
+void heapifyUp(MinHeap* heap, int index) {
+    HeapNode* arr = heap->arr;
+    int* pos = heap->pos;
+    HeapNode node = arr[index];
+    int levels = 0;
+    
+    while (index > 0) {
+        int parentIdx = (index - 1) / heap->arity;
+        HeapNode parent = arr[parentIdx];
+        
+        // Stop once the parent is no larger than the moving node
+        if (!(node.load < parent.load)) break;
+        
+        arr[index] = parent;
+        pos[parent.serverId] = index;
+        index = parentIdx;
+        levels++;
+    }
+    
+    arr[index] = node;
+    pos[node.serverId] = index;
+    
+    METRIC_ADD(METRIC_HEAP_SIFT_UPS, 1);
+    METRIC_ADD(METRIC_HEAP_SIFT_LEVELS, levels);
+    METRIC_OBSERVE(HISTOGRAM_SIFT_LEVELS, levels);
+    (void)levels;
+}
+
+/* Hole-based sift-down for a compile-time arity
+ * Child selection uses conditional moves rather than branches; inlined per
+ * arity so the child loop is fully unrolled.
+ * Returns the number of levels the node moved.
+ * Time Complexity: O(arity * log n)
+ */
+static inline int siftDownFixed(HeapNode* arr, int* pos, int size,
+                                int index, const int arity) {
+    HeapNode node = arr[index];
+    int levels = 0;
+    
+    for (;;) {
+        int firstChild = arity * index + 1;
+        if (firstChild >= size) break;
+        
+        // Pick the smallest existing child (leftmost on ties)
+        int smallest = firstChild;
+        if (firstChild + arity <= size) {
+            for (int k = 1; k < arity; k++) {
+                int child = firstChild + k;
+                smallest = (arr[child].load < arr[smallest].load) ? child : smallest;
+            }
+        } else {
+            for (int child = firstChild + 1; child < size; child++) {
+                smallest = (arr[child].load < arr[smallest].load) ? child : smallest;
+            }
+        }
+        
+        // Stop once no child is smaller than the moving node
+        if (!(arr[smallest].load < node.load)) break;
+        
+        arr[index] = arr[smallest];
+        pos[arr[index].serverId] = index;
+        index = smallest;
+        levels++;
+    }
+    
+    arr[index] = node;
+    pos[node.serverId] = index;
+    return levels;
+}
+
+/* Move a node down the heap to maintain min-heap property
+ * Time Complexity: O(log n)
+ */
+void heapifyDown(MinHeap* heap, int index) {
+    int levels;
+    switch (heap->arity) {
+        case 4:
+            levels = siftDownFixed(heap->arr, heap->pos, heap->size, index, 4);
+            break;
+        case 8:
+            levels = siftDownFixed(heap->arr, heap->pos, heap->size, index, 8);
+            break;
+        default:
+            levels = siftDownFixed(heap->arr, heap->pos, heap->size, index, 2);
+            break;
+    }
+    
+    METRIC_ADD(METRIC_HEAP_SIFT_DOWNS, 1);
+    METRIC_ADD(METRIC_HEAP_SIFT_LEVELS, levels);
+    METRIC_OBSERVE(HISTOGRAM_SIFT_LEVELS, levels);
+    (void)levels;
+}
+
+/* Insert a server into the min heap
+ * Time Complexity: O(log n)
+ */
+void insertHeap(MinHeap* heap, int serverId, float load) {
+    if (heap->size >= heap->capacity) {
+        printf("Heap capacity exceeded!\n");
+        return;
+    }
+    
+    if (serverId < 0 || serverId >= heap->capacity) {
+        printf("Server %d out of heap range!\n", serverId);
+        return;
+    }
+    
+    if (heap->pos[serverId] != -1) {
+        printf("Server %d already in heap!\n", serverId);
+        return;
+    }
+    
+    heap->arr[heap->size].serverId = serverId;
+    heap->arr[heap->size].load = load;
+    heap->pos[serverId] = heap->size;
+    
+    heapifyUp(heap, heap->size);
+    heap->size++;
+}
+
+/* Extract and return the server with minimum load
+ * Time Complexity: O(log n)
+ */
+HeapNode extractMin(MinHeap* heap) {
+    HeapNode min = heap->arr[0];
+    METRIC_ADD(METRIC_HEAP_EXTRACTS, 1);
+    
+    heap->arr[0] = heap->arr[heap->size - 1];
+    heap->pos[heap->arr[0].serverId] = 0;
+    heap->pos[min.serverId] = -1;
+    heap->size--;
+    
+    if (heap->size > 0) {
+        heapifyDown(heap, 0);
+    }
+    
+    return min;
+}
+
+/* Return the server with minimum load without removing it
+ * Time Complexity: O(1)
+ */
+HeapNode peekMin(MinHeap* heap) {
+    return heap->arr[0];
+}
+
+/* Change the root's load in place and sift it down once
+ * Replaces an extractMin + insertHeap pair when the minimum server stays in
+ * the heap with a new (typically larger) load.
+ * Time Complexity: O(log n)
+ */
+void replaceTop(MinHeap* heap, float newLoad) {
+    if (heap->size == 0) {
+        printf("Heap is empty!\n");
+        return;
+    }
+    
+    heap->arr[0].load = newLoad;
+    heapifyDown(heap, 0);
+}
+
+/* Update a server's load in the heap
+ * Time Complexity: O(log n) - position index gives the slot in O(1)
+ */
+void updateHeap(MinHeap* heap, int serverId, float newLoad) {
+    // Look up the server's slot in the heap
+    int index = -1;
+    if (serverId >= 0 && serverId < heap->capacity) {
+        index = heap->pos[serverId];
+    }
+    
+    if (index == -1) {
+        METRIC_ADD(METRIC_HEAP_UPDATE_MISSES, 1);
+        printf("Server %d not found in heap!\n", serverId);
+        return;
+    }
+    
+    METRIC_ADD(METRIC_HEAP_UPDATES, 1);
+    heap->arr[index].load = newLoad;
+    
+    // Reheapify from this position
+    int parentIdx = (index - 1) / heap->arity;
+    if (index > 0 && heap->arr[index].load < heap->arr[parentIdx].load) {
+        heapifyUp(heap, index);
+    } else {
+        heapifyDown(heap, index);
+    }
+}
+
+/* Rebuild the heap from scratch with servers 0..count-1 and their keys
+ * Floyd's bottom-up heapify: sift down every internal node from the last
+ * one to the root. Cheaper than count insertHeap calls or count updateHeap
+ * calls when many keys changed at once.
+ * Time Complexity: O(n)
+ */
+void buildHeap(MinHeap* heap, const float* keys, int count) {
+    if (count > heap->capacity) {
+        printf("Heap capacity exceeded!\n");
+        return;
+    }
+    
+    for (int i = 0; i < count; i++) {
+        heap->arr[i].serverId = i;
+        heap->arr[i].load = keys[i];
+        heap->pos[i] = i;
+    }
+    for (int i = count; i < heap->capacity; i++) {
+        heap->pos[i] = -1;
+    }
+    heap->size = count;
+    
+    if (count < 2) return;
+    for (int i = (count - 2) / heap->arity; i >= 0; i--) {
+        heapifyDown(heap, i);
+    }
+}
+
+/* Free heap memory (arena heaps are released by freeArena)
+ * Time Complexity: O(1)
+ */
+void freeMinHeap(MinHeap* heap) {
+    if (heap->arena) return;
+    free(heap->block);
+    free(heap->pos);
+    free(heap);
+}
+
+/* ============================================================================
+ * SIMD SCAN KERNELS
+ * ============================================================================ */
+
+/* Per-lane running state of a fused sum/argmax/argmin scan
+ * Each lane keeps its own sum, max, min and the server index where its max
+ * and min were first seen. The ISA is chosen at compile time: AVX2
+ * (-mavx2 / -march=native), SSE2 (x86-64 default) or NEON (arm64).
+ */
+#if defined(__AVX2__)
+#define SCAN_LANES 8
+typedef struct {
+    __m256 sum, maxv, minv;
+    __m256i maxi, mini, idx;
+} ScanLanes;
+
+static inline void scanLanesInit(ScanLanes* st) {
+    st->sum = _mm256_setzero_ps();
+    st->maxv = _mm256_set1_ps(-INFINITY);
+    st->minv = _mm256_set1_ps(INFINITY);
+    st->maxi = _mm256_setzero_si256();
+    st->mini = _mm256_setzero_si256();
+    st->idx = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+}
+
+static inline void scanLanesStep(ScanLanes* st, __m256 loads) {
+    __m256 gt = _mm256_cmp_ps(loads, st->maxv, _CMP_GT_OQ);
+    __m256 lt = _mm256_cmp_ps(loads, st->minv, _CMP_LT_OQ);
+    
+    st->sum = _mm256_add_ps(st->sum, loads);
+    st->maxv = _mm256_blendv_ps(st->maxv, loads, gt);
+    st->minv = _mm256_blendv_ps(st->minv, loads, lt);
+    st->maxi = _mm256_blendv_epi8(st->maxi, st->idx, _mm256_castps_si256(gt));
+    st->mini = _mm256_blendv_epi8(st->mini, st->idx, _mm256_castps_si256(lt));
+    st->idx = _mm256_add_epi32(st->idx, _mm256_set1_epi32(8));
+}
+
+static inline void scanLanesStore(const ScanLanes* st, float* maxs, int* maxis,
+                                  float* mins, int* minis, float* sums) {
+    _mm256_storeu_ps(maxs, st->maxv);
+    _mm256_storeu_ps(mins, st->minv);
+    _mm256_storeu_ps(sums, st->sum);
+    _mm256_storeu_si256((__m256i*)maxis, st->maxi);
+    _mm256_storeu_si256((__m256i*)minis, st->mini);
+}
+#elif defined(__SSE2__)
+#define SCAN_LANES 4
+typedef struct {
+    __m128 sum, maxv, minv;
+    __m128i maxi, mini, idx;
+} ScanLanes;
+
+static inline void scanLanesInit(ScanLanes* st) {
+    st->sum = _mm_setzero_ps();
+    st->maxv = _mm_set1_ps(-INFINITY);
+    st->minv = _mm_set1_ps(INFINITY);
+    st->maxi = _mm_setzero_si128();
+    st->mini = _mm_setzero_si128();
+    st->idx = _mm_setr_epi32(0, 1, 2, 3);
+}
+
+static inline void scanLanesStep(ScanLanes* st, __m128 loads) {
+    __m128 gt = _mm_cmpgt_ps(loads, st->maxv);
+    __m128 lt = _mm_cmplt_ps(loads, st->minv);
+    __m128i gti = _mm_castps_si128(gt);
+    __m128i lti = _mm_castps_si128(lt);
+    
+    // SSE2 has no blendv: select with and/andnot/or
+    st->sum = _mm_add_ps(st->sum, loads);
+    st->maxv = _mm_or_ps(_mm_and_ps(gt, loads), _mm_andnot_ps(gt, st->maxv));
+    st->minv = _mm_or_ps(_mm_and_ps(lt, loads), _mm_andnot_ps(lt, st->minv));
+    st->maxi = _mm_or_si128(_mm_and_si128(gti, st->idx), _mm_andnot_si128(gti, st->maxi));
+    st->mini = _mm_or_si128(_mm_and_si128(lti, st->idx), _mm_andnot_si128(lti, st->mini));
+    st->idx = _mm_add_epi32(st->idx, _mm_set1_epi32(4));
+}
+
+static inline void scanLanesStore(const ScanLanes* st, float* maxs, int* maxis,
+                                  float* mins, int* minis, float* sums) {
+    _mm_storeu_ps(maxs, st->maxv);
+    _mm_storeu_ps(mins, st->minv);
+    _mm_storeu_ps(sums, st->sum);
+    _mm_storeu_si128((__m128i*)maxis, st->maxi);
+    _mm_storeu_si128((__m128i*)minis, st->mini);
+}
+#elif defined(__ARM_NEON)
+#define SCAN_LANES 4
+typedef struct {
+    float32x4_t sum, maxv, minv;
+    uint32x4_t maxi, mini, idx;
+} ScanLanes;
+
+static inline void scanLanesInit(ScanLanes* st) {
+    static const uint32_t laneIds[4] = {0, 1, 2, 3};
+    st->sum = vdupq_n_f32(0.0f);
+    st->maxv = vdupq_n_f32(-INFINITY);
+    st->minv = vdupq_n_f32(INFINITY);
+    st->maxi = vdupq_n_u32(0);
+    st->mini = vdupq_n_u32(0);
+    st->idx = vld1q_u32(laneIds);
+}
+
+static inline void scanLanesStep(ScanLanes* st, float32x4_t loads) {
+    uint32x4_t gt = vcgtq_f32(loads, st->maxv);
+    uint32x4_t lt = vcltq_f32(loads, st->minv);
+    
+    st->sum = vaddq_f32(st->sum, loads);
+    st->maxv = vbslq_f32(gt, loads, st->maxv);
+    st->minv = vbslq_f32(lt, loads, st->minv);
+    st->maxi = vbslq_u32(gt, st->idx, st->maxi);
+    st->mini = vbslq_u32(lt, st->idx, st->mini);
+    st->idx = vaddq_u32(st->idx, vdupq_n_u32(4));
+}
+
+static inline void scanLanesStore(const ScanLanes* st, float* maxs, int* maxis,
+                                  float* mins, int* minis, float* sums) {
+    vst1q_f32(maxs, st->maxv);
+    vst1q_f32(mins, st->minv);
+    vst1q_f32(sums, st->sum);
+    vst1q_u32((uint32_t*)maxis, st->maxi);
+    vst1q_u32((uint32_t*)minis, st->mini);
+}
+#endif
+
+#ifdef SCAN_LANES
+/* Fold per-lane max/min candidates into the final LoadScan
+ * On equal loads the lower server index wins, matching the scalar scans.
+ * Time Complexity: O(lanes)
+ */
+static void scanLanesFinish(const ScanLanes* st, LoadScan* scan) {
+    float maxv[SCAN_LANES], minv[SCAN_LANES], sumv[SCAN_LANES];
+    int maxi[SCAN_LANES], mini[SCAN_LANES];
+    scanLanesStore(st, maxv, maxi, minv, mini, sumv);
+    
+    float maxLoad = maxv[0], minLoad = minv[0];
+    scan->mostLoaded = maxi[0];
+    scan->leastLoaded = mini[0];
+    scan->totalLoad = 0.0f;
+    
+    for (int l = 0; l < SCAN_LANES; l++) {
+        scan->totalLoad += sumv[l];
+        if (maxv[l] > maxLoad || (maxv[l] == maxLoad && maxi[l] < scan->mostLoaded)) {
+            maxLoad = maxv[l];
+            scan->mostLoaded = maxi[l];
+        }
+        if (minv[l] < minLoad || (minv[l] == minLoad && mini[l] < scan->leastLoaded)) {
+            minLoad = minv[l];
+            scan->leastLoaded = mini[l];
+        }
+    }
+}
+#endif
+
+/* Continue a scan over loads[from..n) with the scalar loop
+ * Strict comparisons keep the first index on ties.
+ * Time Complexity: O(n - from)
+ */
+static void scanTail(LoadScan* scan, const float* loads, int from, int numServers) {
+    float maxLoad = loads[scan->mostLoaded];
+    float minLoad = loads[scan->leastLoaded];
+    
+    for (int i = from; i < numServers; i++) {
+        float load = loads[i];
+        scan->totalLoad += load;
+        if (load > maxLoad) {
+            maxLoad = load;
+            scan->mostLoaded = i;
+        }
+        if (load < minLoad) {
+            minLoad = load;
+            scan->leastLoaded = i;
+        }
+    }
+}
+
+/* Fused sum/argmax/argmin over a contiguous load array
+ * Replaces separate average, max and min passes with one vectorized pass
+ * (plain vector loads); the scalar loop handles the tail and targets
+ * without SIMD. Used for the ServerTable currentLoad column.
+ * Time Complexity: O(n)
+ */
+LoadScan scanLoadArray(const float* loads, int numServers) {
+    LoadScan scan = {0.0f, 0, 0};
+    if (numServers <= 0) return scan;
+    
+    int i = 0;
+    
+#ifdef SCAN_LANES
+    if (numServers >= SCAN_LANES) {
+        ScanLanes st;
+        scanLanesInit(&st);
+        
+        for (; i + SCAN_LANES <= numServers; i += SCAN_LANES) {
+#if defined(__AVX2__)
+            scanLanesStep(&st, _mm256_loadu_ps(loads + i));
+#elif defined(__SSE2__)
+            scanLanesStep(&st, _mm_loadu_ps(loads + i));
+#else
+            scanLanesStep(&st, vld1q_f32(loads + i));
+#endif
+        }
+        
+        scanLanesFinish(&st, &scan);
+    }
+#endif
+    
+    scanTail(&scan, loads, i, numServers);
+    return scan;
+}
+
+/* Fused sum/argmax/argmin of per-server dominant shares
+ * Server i's share is max over d of loads[d][i] x invCapacity[d][i]: each
+ * step multiplies and folds every dimension's columns with vector max
+ * before the usual lane update, so the pass costs about one scalar scan
+ * per dimension. totalLoad is the sum of shares. dimensions = 1 gives
+ * plain utilization of one column.
+ * Time Complexity: O(dimensions x n)
+ */
+LoadScan scanDominantShares(float* const* loads, float* const* invCapacity,
+                            int dimensions, int numServers) {
+    LoadScan scan = {0.0f, 0, 0};
+    if (numServers <= 0) return scan;
+    
+    int i = 0;
+    
+#ifdef SCAN_LANES
+    if (numServers >= SCAN_LANES) {
+        ScanLanes st;
+        scanLanesInit(&st);
+        
+        for (; i + SCAN_LANES <= numServers; i += SCAN_LANES) {
+#if defined(__AVX2__)
+            __m256 share = _mm256_setzero_ps();
+            for (int d = 0; d < dimensions; d++) {
+                share = _mm256_max_ps(share, _mm256_mul_ps(_mm256_loadu_ps(loads[d] + i),
+                                                           _mm256_loadu_ps(invCapacity[d] + i)));
+            }
+#elif defined(__SSE2__)
+            __m128 share = _mm_setzero_ps();
+            for (int d = 0; d < dimensions; d++) {
+                share = _mm_max_ps(share, _mm_mul_ps(_mm_loadu_ps(loads[d] + i),
+                                                     _mm_loadu_ps(invCapacity[d] + i)));
+            }
+#else
+            float32x4_t share = vdupq_n_f32(0.0f);
+            for (int d = 0; d < dimensions; d++) {
+                share = vmaxq_f32(share, vmulq_f32(vld1q_f32(loads[d] + i),
+                                                   vld1q_f32(invCapacity[d] + i)));
+            }
+#endif
+            scanLanesStep(&st, share);
+        }
+        
+        scanLanesFinish(&st, &scan);
+    }
+#endif
+    
+    // Scalar tail, same tie-breaking as scanTail
+    float maxShare = -INFINITY, minShare = INFINITY;
+    for (int k = (i > 0) ? -2 : 0; k < 0; k++) {
+        int id = (k == -2) ? scan.mostLoaded : scan.leastLoaded;
+        float share = 0.0f;
+        for (int d = 0; d < dimensions; d++) {
+            float util = loads[d][id] * invCapacity[d][id];
+            share = (util > share) ? util : share;
+        }
+        if (k == -2) maxShare = share;
+        else minShare = share;
+    }
+    for (; i < numServers; i++) {
+        float share = 0.0f;
+        for (int d = 0; d < dimensions; d++) {
+            float util = loads[d][i] * invCapacity[d][i];
+            share = (util > share) ? util : share;
+        }
+        scan.totalLoad += share;
+        if (share > maxShare) {
+            maxShare = share;
+            scan.mostLoaded = i;
+        }
+        if (share < minShare) {
+            minShare = share;
+            scan.leastLoaded = i;
+        }
+    }
+    return scan;
+}
+
+/* ============================================================================
+ * IMBALANCE TRACKER
+ * ============================================================================ */
+
+/* Most loaded of two servers (-1 = none); ties keep a, the lower index */
+static inline int maxLoadOf(const ServerTable* table, int a, int b) {
+    if (a < 0) return b;
+    if (b < 0) return a;
+    return (table->currentLoad[b] > table->currentLoad[a]) ? b : a;
+}
+
+static inline int minLoadOf(const ServerTable* table, int a, int b) {
+    if (a < 0) return b;
+    if (b < 0) return a;
+    return (table->currentLoad[b] < table->currentLoad[a]) ? b : a;
+}
+
+static inline int maxUtilOf(const ServerTable* table, int a, int b) {
+    if (a < 0) return b;
+    if (b < 0) return a;
+    return (table->currentLoad[b] * table->invCapacity[b] >
+            table->currentLoad[a] * table->invCapacity[a]) ? b : a;
+}
+
+static inline int minUtilOf(const ServerTable* table, int a, int b) {
+    if (a < 0) return b;
+    if (b < 0) return a;
+    return (table->currentLoad[b] * table->invCapacity[b] <
+            table->currentLoad[a] * table->invCapacity[a]) ? b : a;
+}
+
+/* Recompute one internal node from its two children */
+static inline void playExtremes(const ServerTable* table, ExtremesNode* nodes, int node) {
+    const ExtremesNode* left = &nodes[2 * node];
+    const ExtremesNode* right = &nodes[2 * node + 1];
+    nodes[node].maxLoad = maxLoadOf(table, left->maxLoad, right->maxLoad);
+    nodes[node].minLoad = minLoadOf(table, left->minLoad, right->minLoad);
+    nodes[node].maxUtil = maxUtilOf(table, left->maxUtil, right->maxUtil);
+    nodes[node].minUtil = minUtilOf(table, left->minUtil, right->minUtil);
+}
+
+/* Create a tracker for a fleet of numServers (empty until attached)
+ * Time Complexity: O(n)
+ */
+ImbalanceTracker* createImbalanceTracker(int numServers) {
+    ImbalanceTracker* tracker = (ImbalanceTracker*)malloc(sizeof(ImbalanceTracker));
+    tracker->numServers = numServers;
+    tracker->numLeaves = 1;
+    while (tracker->numLeaves < numServers) {
+        tracker->numLeaves *= 2;
+    }
+    tracker->totalLoad = 0.0;
+    tracker->nodes = (ExtremesNode*)malloc(2 * tracker->numLeaves * sizeof(ExtremesNode));
+    return tracker;
+}
+
+/* Attach a tracker to a table and build it from the current loads
+ * Call after capacities are set. From then on every load change on the
+ * table replays its leaf-to-root path; calling it again resynchronizes the
+ * running total. Only one thread may change the table's loads while a
+ * tracker is attached.
+ * Time Complexity: O(n)
+ */
+void attachImbalanceTracker(ServerTable* table, ImbalanceTracker* tracker) {
+    ExtremesNode* nodes = tracker->nodes;
+    double total = 0.0;
+    for (int leaf = 0; leaf < tracker->numLeaves; leaf++) {
+        int id = (leaf < table->numServers) ? leaf : -1;
+        nodes[tracker->numLeaves + leaf] = (ExtremesNode){id, id, id, id};
+        if (id >= 0) {
+            total += table->currentLoad[id];
+        }
+    }
+    for (int node = tracker->numLeaves - 1; node >= 1; node--) {
+        playExtremes(table, nodes, node);
+    }
+    tracker->totalLoad = total;
+    table->tracker = tracker;
+}
+
+/* Fold one server's load change into the running total and the tree
+ * Time Complexity: O(log n)
+ */
+static inline void trackLoadChange(ServerTable* table, int serverId, float delta) {
+    ImbalanceTracker* tracker = table->tracker;
+    tracker->totalLoad += delta;
+    for (int node = (tracker->numLeaves + serverId) >> 1; node >= 1; node >>= 1) {
+        playExtremes(table, tracker->nodes, node);
+    }
+}
+
+/* Fleet extremes: the tree root
+ * Time Complexity: O(1)
+ */
+static inline ExtremesNode trackedExtremes(const ImbalanceTracker* tracker) {
+    return tracker->nodes[1];
+}
+
+/* Free a tracker (detach it from its table first)
+ * Time Complexity: O(1)
+ */
+void freeImbalanceTracker(ImbalanceTracker* tracker) {
+    free(tracker->nodes);
+    free(tracker);
+}
+
+/* ============================================================================
+ * LOAD COUNTERS
+ * ============================================================================ */
+
+/* Create zeroed per-server atomic load counters, one cache line each
+ * Time Complexity: O(n)
+ */
+LoadCounters* createLoadCounters(int numServers) {
+    LoadCounters* counters = (LoadCounters*)malloc(sizeof(LoadCounters));
+    counters->numServers = numServers;
+    
+    // sizeof(LoadCounter) is a whole number of cache lines
+    counters->block = malloc(numServers * sizeof(LoadCounter) + CACHE_LINE_SIZE);
+    uintptr_t aligned = ((uintptr_t)counters->block + CACHE_LINE_SIZE - 1) &
+                        ~(uintptr_t)(CACHE_LINE_SIZE - 1);
+    counters->counters = (LoadCounter*)aligned;
+    
+    for (int i = 0; i < numServers; i++) {
+        atomic_init(&counters->counters[i].load, 0);
+        atomic_init(&counters->counters[i].tasks, 0);
+    }
+    
+    return counters;
+}
+
+/* Add a load delta (and assigned task count) to one server's counter
+ * Time Complexity: O(1), wait-free
+ */
+static inline void addLoadCounter(LoadCounters* counters, int serverId,
+                                  float delta, int tasks) {
+    LoadCounter* counter = &counters->counters[serverId];
+    atomic_fetch_add_explicit(&counter->load,
+                              (int64_t)llrint(delta * LOAD_FIXED_SCALE),
+                              memory_order_relaxed);
+    if (tasks) {
+        atomic_fetch_add_explicit(&counter->tasks, tasks, memory_order_relaxed);
+    }
+}
+
+/* Mirror a load change of the table into its counters and tracker, if attached */
+static inline void publishLoadChange(ServerTable* table, int serverId,
+                                     float delta, int tasks) {
+    if (table->counters) {
+        addLoadCounter(table->counters, serverId, delta, tasks);
+    }
+    if (table->tracker) {
+        trackLoadChange(table, serverId, delta);
+    }
+}
+
+/* Attach counters to a table and seed them from its current loads
+ * Call before dispatchers start; from then on every assignment and
+ * migration on the table is mirrored into the counters.
+ * Time Complexity: O(n)
+ */
+void attachLoadCounters(ServerTable* table, LoadCounters* counters) {
+    for (int i = 0; i < table->numServers; i++) {
+        atomic_store_explicit(&counters->counters[i].load,
+                              (int64_t)llrint(table->currentLoad[i] * LOAD_FIXED_SCALE),
+                              memory_order_relaxed);
+    }
+    table->counters = counters;
+}
+
+/* Current load of one server, safe from any thread
+ * Time Complexity: O(1), wait-free
+ */
+float readLoadCounter(const LoadCounters* counters, int serverId) {
+    int64_t fixed = atomic_load_explicit(&counters->counters[serverId].load,
+                                         memory_order_relaxed);
+    return (float)(fixed / LOAD_FIXED_SCALE);
+}
+
+/* Free counter memory (detach from the table first)
+ * Time Complexity: O(1)
+ */
+void freeLoadCounters(LoadCounters* counters) {
+    free(counters->block);
+    free(counters);
+}
+
+/* Create snapshot storage for numServers servers
+ * Time Complexity: O(1)
+ */
+LoadSnapshot* createLoadSnapshot(int numServers) {
+    LoadSnapshot* snapshot = (LoadSnapshot*)malloc(sizeof(LoadSnapshot));
+    snapshot->numServers = numServers;
+    snapshot->loads = (float*)malloc(numServers * sizeof(float));
+    snapshot->tasks = (int64_t*)malloc(numServers * sizeof(int64_t));
+    snapshot->totalLoad = 0.0;
+    snapshot->totalTasks = 0;
+    snapshot->mostLoaded = 0;
+    snapshot->leastLoaded = 0;
+    return snapshot;
+}
+
+/* Copy every counter into snapshot, with totals and extremes
+ * Wait-free: one relaxed load per counter, no locks and no retries, so a
+ * monitoring thread never delays dispatchers.
+ * Time Complexity: O(n)
+ */
+void takeLoadSnapshot(const LoadCounters* counters, LoadSnapshot* snapshot) {
+    int n = (counters->numServers < snapshot->numServers) ? counters->numServers
+                                                         : snapshot->numServers;
+    double totalLoad = 0.0;
+    int64_t totalTasks = 0;
+    int mostLoaded = 0, leastLoaded = 0;
+    
+    for (int i = 0; i < n; i++) {
+        const LoadCounter* counter = &counters->counters[i];
+        float load = (float)(atomic_load_explicit(&counter->load, memory_order_relaxed) /
+                             LOAD_FIXED_SCALE);
+        int64_t tasks = atomic_load_explicit(&counter->tasks, memory_order_relaxed);
+        snapshot->loads[i] = load;
+        snapshot->tasks[i] = tasks;
+        totalLoad += load;
+        totalTasks += tasks;
+        if (load > snapshot->loads[mostLoaded]) mostLoaded = i;
+        if (load < snapshot->loads[leastLoaded]) leastLoaded = i;
+    }
+    
+    snapshot->totalLoad = totalLoad;
+    snapshot->totalTasks = totalTasks;
+    snapshot->mostLoaded = mostLoaded;
+    snapshot->leastLoaded = leastLoaded;
+}
+
+/* Print a snapshot like the demo's server listing (capacities are read
+ * from the table, which dispatchers never modify)
+ * Time Complexity: O(n)
+ */
+void printLoadSnapshot(const LoadSnapshot* snapshot, const ServerTable* servers) {
+    printf("\n--- Server States (snapshot) ---\n");
+    for (int i = 0; i < snapshot->numServers; i++) {
+        printf("Server %d: Load = %6.2f/%6.2f (%.1f%%), %lld tasks\n",
+               i, snapshot->loads[i], servers->capacity[i],
+               snapshot->loads[i] * servers->invCapacity[i] * 100.0f,
+               (long long)snapshot->tasks[i]);
+    }
+    printf("\nAverage Load: %.2f\n", snapshot->totalLoad / snapshot->numServers);
+}
+
+/* Free snapshot memory
+ * Time Complexity: O(1)
+ */
+void freeLoadSnapshot(LoadSnapshot* snapshot) {
+    free(snapshot->loads);
+    free(snapshot->tasks);
+    free(snapshot);
+}
+
+/* Monitor loop: snapshot the counters and print a summary every period */
+static void* loadMonitorThread(void* arg) {
+    LoadMonitor* monitor = (LoadMonitor*)arg;
+    const ServerTable* servers = monitor->servers;
+    LoadSnapshot* snapshot = monitor->snapshot;
+    struct timespec period = {monitor->periodMs / 1000,
+                              (long)(monitor->periodMs % 1000) * 1000000L};
+    
+    while (atomic_load(&monitor->running)) {
+        nanosleep(&period, NULL);
+        takeLoadSnapshot(servers->counters, snapshot);
+        monitor->snapshots++;
+        
+        float maxLoad = snapshot->loads[snapshot->mostLoaded];
+        float minLoad = snapshot->loads[snapshot->leastLoaded];
+        printf("[monitor] %lld tasks, avg %.2f, max %.2f (server %d), min %.2f (server %d)\n",
+               (long long)snapshot->totalTasks, snapshot->totalLoad / snapshot->numServers,
+               maxLoad, snapshot->mostLoaded, minLoad, snapshot->leastLoaded);
+    }
+    return NULL;
+}
+
+/* Start a monitor thread over a table with attached counters
+ * Time Complexity: O(n) per period in the monitor thread
+ */
+LoadMonitor* startLoadMonitor(const ServerTable* servers, int periodMs) {
+    LoadMonitor* monitor = (LoadMonitor*)malloc(sizeof(LoadMonitor));
+    monitor->servers = servers;
+    monitor->snapshot = createLoadSnapshot(servers->numServers);
+    monitor->periodMs = periodMs;
+    monitor->snapshots = 0;
+    atomic_init(&monitor->running, 1);
+    
+    if (pthread_create(&monitor->thread, NULL, loadMonitorThread, monitor) != 0) {
+        printf("Cannot start load monitor thread\n");
+        freeLoadSnapshot(monitor->snapshot);
+        free(monitor);
+        return NULL;
+    }
+    return monitor;
+}
+
+/* Stop and free a monitor; returns the number of snapshots it took
+ * Time Complexity: O(1) plus up to one period waiting for the thread
+ */
+long stopLoadMonitor(LoadMonitor* monitor) {
+    atomic_store(&monitor->running, 0);
+    pthread_join(monitor->thread, NULL);
+    long snapshots = monitor->snapshots;
+    freeLoadSnapshot(monitor->snapshot);
+    free(monitor);
+    return snapshots;
+}
+
+/* ============================================================================
+ * SERVER TABLE FUNCTIONS
+ * ============================================================================ */
+
+/* Round a column length up to a whole number of cache lines */
+static size_t serverTableStride(int numServers) {
+    size_t perLine = CACHE_LINE_SIZE / sizeof(float);
+    return ((size_t)numServers + perLine - 1) / perLine * perLine;
+}
+
+/* Create a structure-of-arrays table for numServers servers in arena
+ * (NULL = malloc)
+ * All columns live in one allocation, each starting on a cache line.
+ * Loads start at 0; capacities must be set with setServerCapacity.
+ * Time Complexity: O(n)
+ */
+ServerTable* createServerTableIn(Arena* arena, int numServers) {
+    ServerTable* table = (ServerTable*)lbAlloc(arena, sizeof(ServerTable));
+    size_t stride = serverTableStride(numServers);
+    
+    table->arena = arena;
+    table->block = lbAlloc(arena, 3 * stride * sizeof(float) + CACHE_LINE_SIZE);
+    uintptr_t aligned = ((uintptr_t)table->block + CACHE_LINE_SIZE - 1) &
+                        ~(uintptr_t)(CACHE_LINE_SIZE - 1);
+    
+    table->numServers = numServers;
+    table->capacity = (float*)aligned;
+    table->currentLoad = table->capacity + stride;
+    table->invCapacity = table->currentLoad + stride;
+    table->counters = NULL;
+    table->tracker = NULL;
+    table->resources = NULL;
+    
+    for (int i = 0; i < numServers; i++) {
+        table->capacity[i] = 0.0f;
+        table->currentLoad[i] = 0.0f;
+        table->invCapacity[i] = 0.0f;
+    }
+    
+    return table;
+}
+
+/* Create a malloc-backed server table
+ * Time Complexity: O(n)
+ */
+ServerTable* createServerTable(int numServers) {
+    return createServerTableIn(NULL, numServers);
+}
+
+/* Set a server's capacity and refresh its cached reciprocal
+ * Time Complexity: O(1)
+ */
+void setServerCapacity(ServerTable* table, int serverId, float capacity) {
+    table->capacity[serverId] = capacity;
+    table->invCapacity[serverId] = 1.0f / capacity;
+}
+
+/* Calculate load percentage for one server of the table
+ * Time Complexity: O(1)
+ */
+float getServerLoadPercentage(const ServerTable* table, int serverId) {
+    return table->currentLoad[serverId] * table->invCapacity[serverId] * 100.0f;
+}
+
+/* Write every server's load percentage into out[0..numServers)
+ * Contiguous multiply over two columns, so the compiler vectorizes it.
+ * Time Complexity: O(n)
+ */
+void computeLoadPercentages(const ServerTable* table, float* restrict out) {
+    const float* restrict load = table->currentLoad;
+    const float* restrict invCapacity = table->invCapacity;
+    
+    for (int i = 0; i < table->numServers; i++) {
+        out[i] = load[i] * invCapacity[i] * 100.0f;
+    }
+}
+
+/* Total load plus most/least loaded server of the table in one pass
+ * Time Complexity: O(n)
+ */
+LoadScan scanServerTable(const ServerTable* table) {
+    return scanLoadArray(table->currentLoad, table->numServers);
+}
+
+/* Relaxed atomic read of one load slot
+ * The columns stay plain floats so the SIMD scans can stream them; the
+ * lock-free d-choices path goes through the GCC/Clang __atomic builtins.
+ */
+static inline float loadServerLoad(const float* slot) {
+    float value;
+    __atomic_load(slot, &value, __ATOMIC_RELAXED);
+    return value;
+}
+
+/* Atomically add delta to one load slot (CAS loop); returns the new load */
+static inline float atomicAddServerLoad(float* slot, float delta) {
+    float expected, desired;
+    __atomic_load(slot, &expected, __ATOMIC_RELAXED);
+    do {
+        desired = expected + delta;
+    } while (!__atomic_compare_exchange(slot, &expected, &desired, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    return desired;
+}
+
+/* Power-of-d-choices assignment: sample d random servers, place the task on
+ * the one with the lowest utilization and add its load atomically
+ * Needs no heap and no lock, so any number of threads may call it at once;
+ * rng is the caller's own generator. Samples may repeat.
+ * Returns the chosen server.
+ * Time Complexity: O(d)
+ */
+int dChoicesAssignTask(ServerTable* table, float taskLoad, int d, Rng* rng) {
+    uint32_t n = (uint32_t)table->numServers;
+    int best = (int)rngBelow(rng, n);
+    float bestUtil = loadServerLoad(&table->currentLoad[best]) * table->invCapacity[best];
+    
+    for (int k = 1; k < d; k++) {
+        int candidate = (int)rngBelow(rng, n);
+        float util = loadServerLoad(&table->currentLoad[candidate]) *
+                     table->invCapacity[candidate];
+        if (util < bestUtil) {
+            bestUtil = util;
+            best = candidate;
+        }
+    }
+    
+    atomicAddServerLoad(&table->currentLoad[best], taskLoad);
+    publishLoadChange(table, best, taskLoad, 1);
+    METRIC_ADD(METRIC_TASKS_ASSIGNED, 1);
+    return best;
+}
+
+/* Free server table memory (arena tables are released by freeArena)
+ * Time Complexity: O(1)
+ */
+void freeServerTable(ServerTable* table) {
+    if (table->arena) return;
+    free(table->block);
+    free(table);
+}
+
+/* ============================================================================
+ * EVENT LOG
+ * ============================================================================ */
+
+/* Write slots [begin, end) of the ring to the sink's file (writer thread) */
+static void writeEventRange(EventSink* sink, uint64_t begin, uint64_t end) {
+    static const char* typeNames[] = {"assign", "migrate", "complete"};
+    
+    while (begin < end) {
+        // Contiguous run up to the end of the ring
+        int first = (int)(begin & (uint64_t)(sink->capacity - 1));
+        int count = sink->capacity - first;
+        if ((uint64_t)count > end - begin) {
+            count = (int)(end - begin);
+        }
+        
+        const SimEvent* events = sink->ring + first;
+        if (sink->format == EVENT_FORMAT_BINARY) {
+            fwrite(events, sizeof(SimEvent), count, sink->file);
+        } else {
+            for (int k = 0; k < count; k++) {
+                fprintf(sink->file, "%s,%d,%d,%d,%.4f,%.4f\n",
+                        typeNames[events[k].type], events[k].task,
+                        events[k].serverId, events[k].peerId,
+                        events[k].amount, events[k].load);
+            }
+        }
+        begin += count;
+    }
+}
+
+/* Writer thread: drain published ranges until the sink is closed */
+static void* eventWriterThread(void* arg) {
+    EventSink* sink = (EventSink*)arg;
+    
+    pthread_mutex_lock(&sink->lock);
+    for (;;) {
+        while (sink->readIndex == sink->publishedIndex && !sink->closing) {
+            pthread_cond_wait(&sink->dataReady, &sink->lock);
+        }
+        uint64_t begin = sink->readIndex;
+        uint64_t end = sink->publishedIndex;
+        if (begin == end) {
+            break;  // Closing and fully drained
+        }
+        
+        // Format and write without holding the lock
+        pthread_mutex_unlock(&sink->lock);
+        writeEventRange(sink, begin, end);
+        pthread_mutex_lock(&sink->lock);
+        
+        sink->readIndex = end;
+        pthread_cond_signal(&sink->spaceReady);
+    }
+    pthread_mutex_unlock(&sink->lock);
+    
+    fflush(sink->file);
+    return NULL;
+}
+
+/* Open an event sink writing to path and start its writer thread
+ * capacity is rounded up to a power of two (minimum 64). Binary files start
+ * with the 8-byte magic "LBEVENT1" and the uint32 record size.
+ * Returns NULL if the file cannot be opened or the thread cannot start.
+ * Time Complexity: O(1)
+ */
+EventSink* createEventSink(const char* path, EventFormat format, int capacity) {
+    FILE* file = fopen(path, format == EVENT_FORMAT_BINARY ? "wb" : "w");
+    if (file == NULL) {
+        printf("Cannot open event file '%s'\n", path);
+        return NULL;
+    }
+    
+    int ringSize = 64;
+    while (ringSize < capacity) {
+        ringSize *= 2;
+    }
+    
+    EventSink* sink = (EventSink*)malloc(sizeof(EventSink));
+    sink->ring = (SimEvent*)malloc(ringSize * sizeof(SimEvent));
+    sink->capacity = ringSize;
+    sink->chunkSize = ringSize / 4;
+    sink->format = format;
+    sink->file = file;
+    sink->writeIndex = 0;
+    sink->publishedIndex = 0;
+    sink->readIndex = 0;
+    sink->lastTask = 0;
+    sink->closing = 0;
+    sink->stalls = 0;
+    
+    if (format == EVENT_FORMAT_BINARY) {
+        uint32_t recordSize = (uint32_t)sizeof(SimEvent);
+        fwrite("LBEVENT1", 1, 8, file);
+        fwrite(&recordSize, sizeof(recordSize), 1, file);
+    } else {
+        fprintf(file, "event,task,server,peer,amount,load\n");
+    }
+    
+    pthread_mutex_init(&sink->lock, NULL);
+    pthread_cond_init(&sink->dataReady, NULL);
+    pthread_cond_init(&sink->spaceReady, NULL);
+    if (pthread_create(&sink->writer, NULL, eventWriterThread, sink) != 0) {
+        printf("Cannot start event writer thread\n");
+        pthread_mutex_destroy(&sink->lock);
+        pthread_cond_destroy(&sink->dataReady);
+        pthread_cond_destroy(&sink->spaceReady);
+        fclose(file);
+        free(sink->ring);
+        free(sink);
+        return NULL;
+    }
+    
+    return sink;
+}
+
+/* Hand filled slots to the writer; wait if the next chunk has no room
+ * Time Complexity: O(1) plus any wait for the writer
+ */
+static void publishEvents(EventSink* sink) {
+    pthread_mutex_lock(&sink->lock);
+    sink->publishedIndex = sink->writeIndex;
+    pthread_cond_signal(&sink->dataReady);
+    
+    if (sink->writeIndex + sink->chunkSize - sink->readIndex > (uint64_t)sink->capacity) {
+        sink->stalls++;
+        do {
+            pthread_cond_wait(&sink->spaceReady, &sink->lock);
+        } while (sink->writeIndex + sink->chunkSize - sink->readIndex >
+                 (uint64_t)sink->capacity);
+    }
+    pthread_mutex_unlock(&sink->lock);
+}
+
+/* Append one event (producer side, no locking except once per chunk)
+ * Time Complexity: O(1) amortized
+ */
+static inline void pushEvent(EventSink* sink, int type, int task, int serverId,
+                             int peerId, float amount, float load) {
+    SimEvent* event = &sink->ring[sink->writeIndex & (uint64_t)(sink->capacity - 1)];
+    event->type = type;
+    event->task = task;
+    event->serverId = serverId;
+    event->peerId = peerId;
+    event->amount = amount;
+    event->load = load;
+    
+    if (++sink->writeIndex - sink->publishedIndex >= (uint64_t)sink->chunkSize) {
+        publishEvents(sink);
+    }
+}
+
+/* Record a task placement
+ * Time Complexity: O(1) amortized
+ */
+void recordAssignment(EventSink* sink, int task, int serverId, float taskLoad,
+                      float newLoad) {
+    sink->lastTask = task;
+    pushEvent(sink, EVENT_ASSIGN, task, serverId, -1, taskLoad, newLoad);
+}
+
+/* Record a task completion
+ * Time Complexity: O(1) amortized
+ */
+void recordCompletion(EventSink* sink, int task, int serverId, float taskLoad,
+                      float newLoad) {
+    pushEvent(sink, EVENT_COMPLETE, task, serverId, -1, taskLoad, newLoad);
+}
+
+/* Record a load migration, tagged with the last assigned task
+ * Time Complexity: O(1) amortized
+ */
+void recordMigration(EventSink* sink, int from, int to, float amount,
+                     float fromLoad) {
+    pushEvent(sink, EVENT_MIGRATE, sink->lastTask, from, to, amount, fromLoad);
+}
+
+/* Number of events recorded so far
+ * Time Complexity: O(1)
+ */
+long long eventSinkCount(const EventSink* sink) {
+    return (long long)sink->writeIndex;
+}
+
+/* Flush every recorded event, stop the writer thread and free the sink
+ * Time Complexity: O(pending events)
+ */
+void closeEventSink(EventSink* sink) {
+    pthread_mutex_lock(&sink->lock);
+    sink->publishedIndex = sink->writeIndex;
+    sink->closing = 1;
+    pthread_cond_signal(&sink->dataReady);
+    pthread_mutex_unlock(&sink->lock);
+    
+    pthread_join(sink->writer, NULL);
+    
+    pthread_mutex_destroy(&sink->lock);
+    pthread_cond_destroy(&sink->dataReady);
+    pthread_cond_destroy(&sink->spaceReady);
+    fclose(sink->file);
+    free(sink->ring);
+    free(sink);
+}
+
+/* ============================================================================
+ * TRACE CAPTURE AND REPLAY
+ * ============================================================================ */
+
+/* Open a binary trace for writing and write its header
+ * Returns NULL if the file cannot be opened.
+ * Time Complexity: O(1)
+ */
+TraceWriter* createTraceWriter(const char* path) {
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        printf("Cannot open trace file '%s'\n", path);
+        return NULL;
+    }
+    
+    uint32_t header[2] = {(uint32_t)sizeof(TraceRecord), 0};
+    fwrite("LBTRACE1", 1, 8, file);
+    fwrite(header, sizeof(header), 1, file);
+    
+    TraceWriter* writer = (TraceWriter*)malloc(sizeof(TraceWriter));
+    writer->file = file;
+    writer->buffer = (TraceRecord*)malloc(TRACE_BUFFER_RECORDS * sizeof(TraceRecord));
+    writer->count = 0;
+    writer->written = 0;
+    clock_gettime(CLOCK_MONOTONIC, &writer->start);
+    return writer;
+}
+
+/* Seconds since the writer was opened: arrival times for runs without a
+ * virtual clock
+ * Time Complexity: O(1)
+ */
+double traceClock(const TraceWriter* writer) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - writer->start.tv_sec) +
+           (now.tv_nsec - writer->start.tv_nsec) * 1e-9;
+}
+
+/* Write the buffered records to the file
+ * Time Complexity: O(buffered records)
+ */
+static void flushTraceWriter(TraceWriter* writer) {
+    fwrite(writer->buffer, sizeof(TraceRecord), writer->count, writer->file);
+    writer->count = 0;
+}
+
+/* Append one arrival; affinity is the server the task must run on, or -1
+ * Time Complexity: O(1) amortized
+ */
+static inline void appendTraceRecord(TraceWriter* writer, double time, float load,
+                                     int affinity) {
+    TraceRecord* record = &writer->buffer[writer->count++];
+    record->time = time;
+    record->load = load;
+    record->affinity = affinity;
+    writer->written++;
+    if (writer->count == TRACE_BUFFER_RECORDS) {
+        flushTraceWriter(writer);
+    }
+}
+
+/* Flush and close a trace writer and free it
+ * Returns the number of records written, or -1 if a write failed.
+ * Time Complexity: O(buffered records)
+ */
+long long closeTraceWriter(TraceWriter* writer) {
+    flushTraceWriter(writer);
+    int failed = ferror(writer->file);
+    if (fclose(writer->file) != 0) {
+        failed = 1;
+    }
+    
+    long long written = failed ? -1 : writer->written;
+    free(writer->buffer);
+    free(writer);
+    return written;
+}
+
+/* Open a binary trace for streaming replay
+ * Only the header is read here; records are mapped a window at a time by
+ * nextTraceRecords. A partial record at the end of the file (an
+ * interrupted capture) is ignored.
+ * Returns NULL if the file cannot be opened or is not a trace.
+ * Time Complexity: O(1)
+ */
+TraceReader* openTraceReader(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        printf("Cannot open trace file '%s'\n", path);
+        return NULL;
+    }
+    
+    unsigned char header[16] = {0};
+    struct stat info;
+    ssize_t got = (fstat(fd, &info) == 0) ? read(fd, header, sizeof(header)) : -1;
+    uint32_t recordSize;
+    memcpy(&recordSize, header + 8, sizeof(recordSize));
+    if (got != (ssize_t)sizeof(header) || memcmp(header, "LBTRACE1", 8) != 0 ||
+        recordSize != sizeof(TraceRecord)) {
+        printf("'%s' is not a binary task trace\n", path);
+        close(fd);
+        return NULL;
+    }
+    
+    // Whole pages, so every window starts at a page-aligned file offset
+    long pageSize = sysconf(_SC_PAGESIZE);
+    size_t windowSize = TRACE_WINDOW_BYTES;
+    if (pageSize > 0 && windowSize % (size_t)pageSize != 0) {
+        windowSize += (size_t)pageSize - windowSize % (size_t)pageSize;
+    }
+    
+    TraceReader* reader = (TraceReader*)malloc(sizeof(TraceReader));
+    reader->fd = fd;
+    snprintf(reader->path, sizeof(reader->path), "%s", path);
+    reader->numRecords = (long long)((info.st_size - (off_t)sizeof(header)) /
+                                     (off_t)sizeof(TraceRecord));
+    reader->nextRecord = 0;
+    reader->windowSize = windowSize;
+    reader->windowOffset = 0;
+    reader->windowBytes = 0;
+    reader->window = NULL;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    return reader;
+}
+
+/* Number of whole records in the trace
+ * Time Complexity: O(1)
+ */
+long long traceRecordCount(const TraceReader* reader) {
+    return reader->numRecords;
+}
+
+/* Next contiguous run of up to max records, read in place from the mapping
+ * Sets *count (0 at the end of the trace); the records stay valid until the
+ * next call. Entering a new window unmaps the previous one, maps the new
+ * one and starts readahead of the window after it, so disk reads overlap
+ * with replay of the current window.
+ * Returns NULL at the end of the trace or if a window cannot be mapped.
+ * Time Complexity: O(1) per call, page faults amortized over the window
+ */
+const TraceRecord* nextTraceRecords(TraceReader* reader, int max, int* count) {
+    *count = 0;
+    if (reader->nextRecord >= reader->numRecords || max <= 0) {
+        return NULL;
+    }
+    
+    off_t offset = (off_t)(16 + reader->nextRecord * (long long)sizeof(TraceRecord));
+    off_t windowEnd = reader->windowOffset + (off_t)reader->windowBytes;
+    if (reader->windowBytes == 0 || offset < reader->windowOffset || offset >= windowEnd) {
+        if (reader->windowBytes > 0) {
+            munmap(reader->window, reader->windowBytes);
+            reader->windowBytes = 0;
+        }
+        
+        off_t start = offset - offset % (off_t)reader->windowSize;
+        off_t traceEnd = (off_t)(16 + reader->numRecords * (long long)sizeof(TraceRecord));
+        size_t bytes = reader->windowSize;
+        if ((off_t)bytes > traceEnd - start) {
+            bytes = (size_t)(traceEnd - start);
+        }
+        
+        void* window = mmap(NULL, bytes, PROT_READ, MAP_PRIVATE, reader->fd, start);
+        if (window == MAP_FAILED) {
+            printf("Cannot map trace file '%s'\n", reader->path);
+            reader->nextRecord = reader->numRecords;
+            return NULL;
+        }
+        posix_madvise(window, bytes, POSIX_MADV_SEQUENTIAL);
+        posix_fadvise(reader->fd, start + (off_t)bytes, (off_t)reader->windowSize,
+                      POSIX_FADV_WILLNEED);
+        
+        reader->window = (unsigned char*)window;
+        reader->windowOffset = start;
+        reader->windowBytes = bytes;
+        windowEnd = start + (off_t)bytes;
+    }
+    
+    long long available = (long long)(windowEnd - offset) / (long long)sizeof(TraceRecord);
+    if (available > max) {
+        available = max;
+    }
+    *count = (int)available;
+    reader->nextRecord += available;
+    return (const TraceRecord*)(reader->window + (offset - reader->windowOffset));
+}
+
+/* Restart the replay from the first record
+ * Time Complexity: O(1)
+ */
+void rewindTraceReader(TraceReader* reader) {
+    reader->nextRecord = 0;
+}
+
+/* Unmap the current window, close the file and free the reader
+ * Time Complexity: O(1)
+ */
+void closeTraceReader(TraceReader* reader) {
+    if (reader->windowBytes > 0) {
+        munmap(reader->window, reader->windowBytes);
+    }
+    close(reader->fd);
+    free(reader);
+}
+
+/* Copy the next count replayed tasks into loads and pins
+ * Affinities outside [0, numServers) - e.g. from a trace captured on a
+ * larger fleet - become -1. Replay stops at the first record whose load is
+ * negative or not finite.
+ * Returns the number of tasks read and sets *pinned to how many of them
+ * carry an affinity.
+ * Time Complexity: O(count)
+ */
+static int readReplayBatch(TraceReader* reader, float* loads, int* pins, int count,
+                           int numServers, int* pinned) {
+    int filled = 0;
+    *pinned = 0;
+    while (filled < count) {
+        int run;
+        const TraceRecord* records = nextTraceRecords(reader, count - filled, &run);
+        if (records == NULL) {
+            break;
+        }
+        
+        for (int k = 0; k < run; k++) {
+            float load = records[k].load;
+            if (!(load >= 0.0f) || !isfinite(load)) {
+                printf("%s: record %lld: invalid task load\n", reader->path,
+                       reader->nextRecord - run + k);
+                reader->nextRecord = reader->numRecords;
+                return filled;
+            }
+            int pin = records[k].affinity;
+            if (pin < 0 || pin >= numServers) {
+                pin = -1;
+            }
+            loads[filled] = load;
+            pins[filled] = pin;
+            *pinned += (pin >= 0);
+            filled++;
+        }
+    }
+    return filled;
+}
+
+/* ============================================================================
+ * MULTI-RESOURCE SERVERS
+ * ============================================================================ */
+
+static const char* resourceNames[RESOURCE_DIMENSIONS] = {"cpu", "memory", "network"};
+
+/* Create per-dimension columns for numServers servers in arena (NULL =
+ * malloc); weights (NULL = all 1) scale each dimension's utilization
+ * Loads start at 0; capacities must be set with setResourceCapacity.
+ * Time Complexity: O(n)
+ */
+ResourceTable* createResourceTableIn(Arena* arena, int numServers, const float* weights) {
+    ResourceTable* table = (ResourceTable*)lbAlloc(arena, sizeof(ResourceTable));
+    size_t stride = serverTableStride(numServers);
+    
+    table->arena = arena;
+    table->numServers = numServers;
+    table->block = lbAlloc(arena, 3 * RESOURCE_DIMENSIONS * stride * sizeof(float) +
+                                  CACHE_LINE_SIZE);
+    uintptr_t aligned = ((uintptr_t)table->block + CACHE_LINE_SIZE - 1) &
+                        ~(uintptr_t)(CACHE_LINE_SIZE - 1);
+    
+    float* column = (float*)aligned;
+    for (int d = 0; d < RESOURCE_DIMENSIONS; d++) {
+        table->weight[d] = weights ? weights[d] : 1.0f;
+        table->capacity[d] = column;
+        table->load[d] = column + stride;
+        table->invCapacity[d] = column + 2 * stride;
+        column += 3 * stride;
+        for (int i = 0; i < numServers; i++) {
+            table->capacity[d][i] = 0.0f;
+            table->load[d][i] = 0.0f;
+            table->invCapacity[d][i] = 0.0f;
+        }
+    }
+    
+    return table;
+}
+
+/* Attach vector loads to a server table with no load yet
+ * The scalar columns become the sum over dimensions (setResourceCapacity
+ * and every vector update keep them so), so counters, trackers, events and
+ * statistics keep working on total load.
+ * Time Complexity: O(1)
+ */
+void attachResourceTable(ServerTable* table, ResourceTable* resources) {
+    table->resources = resources;
+}
+
+/* Set one server's capacity vector; its scalar capacity becomes the sum
+ * Time Complexity: O(dimensions)
+ */
+void setResourceCapacity(ServerTable* table, int serverId, const float* capacity) {
+    ResourceTable* resources = table->resources;
+    float total = 0.0f;
+    for (int d = 0; d < RESOURCE_DIMENSIONS; d++) {
+        resources->capacity[d][serverId] = capacity[d];
+        resources->invCapacity[d][serverId] = resources->weight[d] / capacity[d];
+        total += capacity[d];
+    }
+    setServerCapacity(table, serverId, total);
+}
+
+/* Highest weighted utilization over the dimensions (the dominant share)
+ * Time Complexity: O(dimensions)
+ */
+static inline float dominantShare(const ResourceTable* resources, int serverId) {
+    float share = 0.0f;
+    for (int d = 0; d < RESOURCE_DIMENSIONS; d++) {
+        float util = resources->load[d][serverId] * resources->invCapacity[d][serverId];
+        share = (util > share) ? util : share;
+    }
+    return share;
+}
+
+/* Dominant share of a server after adding demand
+ * Time Complexity: O(dimensions)
+ */
+static inline float projectedDominantShare(const ResourceTable* resources, int serverId,
+                                           const float* demand) {
+    float share = 0.0f;
+    for (int d = 0; d < RESOURCE_DIMENSIONS; d++) {
+        float util = (resources->load[d][serverId] + demand[d]) *
+                     resources->invCapacity[d][serverId];
+        share = (util > share) ? util : share;
+    }
+    return share;
+}
+
+/* Draw a task demand vector: one random dimension takes a load in
+ * [MIN_TASK_LOAD, MAX_TASK_LOAD], the others RESOURCE_SECONDARY_SHARE of
+ * a draw from the same range
+ * Returns the total demand.
+ * Time Complexity: O(dimensions)
+ */
+float drawResourceDemand(Rng* rng, float* demand) {
+    int stressed = (int)rngBelow(rng, RESOURCE_DIMENSIONS);
+    float total = 0.0f;
+    for (int d = 0; d < RESOURCE_DIMENSIONS; d++) {
+        demand[d] = rngRange(rng, MIN_TASK_LOAD, MAX_TASK_LOAD);
+        if (d != stressed) {
+            demand[d] *= RESOURCE_SECONDARY_SHARE;
+        }
+        total += demand[d];
+    }
+    return total;
+}
+
+/* Place one vector task on the server with the lowest projected dominant
+ * share and update that server's heap key (ASSIGN_BY_DOMINANT_SHARE)
+ * As in ASSIGN_BY_UTILIZATION, the root's child group (one cache line) is
+ * probed with the exact projection. Returns the chosen server.
+ * Time Complexity: O(log n + arity x dimensions)
+ */
+int assignVectorTask(ServerTable* servers, MinHeap* heap, const float* demand) {
+    METRIC_SAMPLE_CLOCK(start, METRIC_TASKS_ASSIGNED);
+    ResourceTable* resources = servers->resources;
+    
+    int best = heap->arr[0].serverId;
+    float bestShare = projectedDominantShare(resources, best, demand);
+    int lastChild = (heap->arity + 1 < heap->size) ? heap->arity + 1 : heap->size;
+    for (int child = 1; child < lastChild; child++) {
+        int id = heap->arr[child].serverId;
+        float share = projectedDominantShare(resources, id, demand);
+        if (share < bestShare) {
+            bestShare = share;
+            best = id;
+        }
+    }
+    
+    float total = 0.0f;
+    for (int d = 0; d < RESOURCE_DIMENSIONS; d++) {
+        resources->load[d][best] += demand[d];
+        total += demand[d];
+    }
+    servers->currentLoad[best] += total;
+    publishLoadChange(servers, best, total, 1);
+    
+    float newKey = dominantShare(resources, best);
+    if (best == peekMin(heap).serverId) {
+        replaceTop(heap, newKey);
+    } else {
+        updateHeap(heap, best, newKey);
+    }
+    
+    METRIC_ADD(METRIC_TASKS_ASSIGNED, 1);
+    METRIC_OBSERVE_SINCE(HISTOGRAM_ASSIGN_NS, start);
+    return best;
+}
+
+/* Remove a fraction of one server's load vector (completing tasks)
+ * The caller updates the scalar load by the same share.
+ * Time Complexity: O(dimensions)
+ */
+static void releaseResources(ResourceTable* resources, int serverId, float fraction) {
+    for (int d = 0; d < RESOURCE_DIMENSIONS; d++) {
+        resources->load[d][serverId] -= resources->load[d][serverId] * fraction;
+    }
+}
+
+/* Single-pair rebalancing on vector loads (rebalanceLoads with resources)
+ * Balance is judged on dominant shares, the same quantity the heap keys
+ * on: with heterogeneous capacities a single dimension may never even out,
+ * but the dominant shares can. scanDominantShares folds every dimension's
+ * weighted utilization columns into one SIMD pass that yields the donor
+ * (highest share) and the receiver (lowest). Load moves as a bundle, the
+ * way migrated tasks carry their whole demand: the donor gives away the
+ * same fraction of every component, sized to move half of its excess
+ * share over the mean.
+ * Returns the migrated load (sum over dimensions).
+ * Time Complexity: O(dimensions x n)
+ */
+float rebalanceResources(ServerTable* servers, MinHeap* heap,
+                         const SimulationOptions* opts) {
+    ResourceTable* resources = servers->resources;
+    int numServers = servers->numServers;
+    
+    LoadScan scan = scanDominantShares(resources->load, resources->invCapacity,
+                                       RESOURCE_DIMENSIONS, numServers);
+    int donor = scan.mostLoaded;
+    int receiver = scan.leastLoaded;
+    float donorShare = dominantShare(resources, donor);
+    float imbalance = (donorShare - dominantShare(resources, receiver)) * 100.0f;
+    if (imbalance <= opts->rebalanceThreshold) {
+        return 0.0f;
+    }
+    
+    float meanShare = scan.totalLoad / numServers;
+    float fraction = 0.5f * (donorShare - meanShare) / donorShare;
+    if (!(fraction > 0.0f)) {
+        return 0.0f;
+    }
+    
+    int worst = 0;
+    for (int d = 1; d < RESOURCE_DIMENSIONS; d++) {
+        if (resources->load[d][donor] * resources->invCapacity[d][donor] >
+            resources->load[worst][donor] * resources->invCapacity[worst][donor]) {
+            worst = d;
+        }
+    }
+    
+    float migrationAmount = 0.0f;
+    for (int d = 0; d < RESOURCE_DIMENSIONS; d++) {
+        float amount = resources->load[d][donor] * fraction;
+        resources->load[d][donor] -= amount;
+        resources->load[d][receiver] += amount;
+        migrationAmount += amount;
+    }
+    
+    if (opts->logLevel >= LOG_INFO) {
+        printf("\n⚠️  REBALANCING TRIGGERED ⚠️\n");
+        printf("   Dominant-share imbalance: %.2f%% (threshold: %.2f%%)\n",
+               imbalance, opts->rebalanceThreshold);
+        printf("   Server %d is %s-bound\n", donor, resourceNames[worst]);
+        printf("   Server %d → Server %d: %.1f%% of its load vector\n",
+               donor, receiver, fraction * 100.0f);
+        printf("   Migrating %.2f load units\n", migrationAmount);
+    }
+    
+    servers->currentLoad[donor] -= migrationAmount;
+    servers->currentLoad[receiver] += migrationAmount;
+    publishLoadChange(servers, donor, -migrationAmount, 0);
+    publishLoadChange(servers, receiver, migrationAmount, 0);
+    METRIC_MIGRATION(migrationAmount);
+    
+    if (opts->events) {
+        recordMigration(opts->events, donor, receiver, migrationAmount,
+                        servers->currentLoad[donor]);
+    }
+    
+    updateHeap(heap, donor, dominantShare(resources, donor));
+    updateHeap(heap, receiver, dominantShare(resources, receiver));
+    return migrationAmount;
+}
+
+/* Free the per-dimension columns
+ * Time Complexity: O(1)
+ */
+void freeResourceTable(ResourceTable* resources) {
+    lbFree(resources->arena, resources->block);
+    lbFree(resources->arena, resources);
+}
+
+/* ============================================================================
+ * REBALANCING AND SIMULATION
+ * ============================================================================ */
+
+/* Default simulation options from the compile-time configuration
+ * Time Complexity: O(1)
+ */
+SimulationOptions defaultSimulationOptions(void) {
+    SimulationOptions opts;
+    opts.assignmentMode = ASSIGNMENT_MODE;
+    opts.selectionPolicy = SELECTION_POLICY;
+    opts.choices = NUM_CHOICES;
+    opts.rebalanceMode = REBALANCE_MODE;
+    opts.rebalanceThreshold = REBALANCE_THRESHOLD;
+    opts.rebalanceInterval = REBALANCE_INTERVAL;
+    opts.maxMigrationHops = MAX_MIGRATION_HOPS;
+    opts.batchSize = BATCH_SIZE;
+    opts.taskLifetime = TASK_LIFETIME;
+    opts.logLevel = LOG_LEVEL;
+    opts.events = NULL;
+    opts.capture = NULL;
+    opts.replay = NULL;
+    opts.admission = ADMISSION_POLICY;
+    opts.admissionQueue = ADMISSION_QUEUE;
+    opts.admissionLimit = ADMISSION_LIMIT;
+    opts.hierarchy = NULL;
+    return opts;
+}
+
+/* Heap key of a server under the given assignment mode
+ * ASSIGN_BY_UTILIZATION projects a mean-sized task onto the server, so the
+ * root is the server whose utilization grows least from a typical task.
+ * ASSIGN_BY_DOMINANT_SHARE keys on the highest weighted utilization of any
+ * resource (plain utilization without a ResourceTable).
+ * Time Complexity: O(1)
+ */
+float serverHeapKey(const ServerTable* servers, int serverId, AssignmentMode mode) {
+    if (mode == ASSIGN_BY_DOMINANT_SHARE) {
+        return servers->resources
+                   ? dominantShare(servers->resources, serverId)
+                   : servers->currentLoad[serverId] * servers->invCapacity[serverId];
+    }
+    if (mode == ASSIGN_BY_UTILIZATION) {
+        const float expectedTaskLoad = (MIN_TASK_LOAD + MAX_TASK_LOAD) / 2.0f;
+        return (servers->currentLoad[serverId] + expectedTaskLoad) *
+               servers->invCapacity[serverId];
+    }
+    return servers->currentLoad[serverId];
+}
+
+/* Pick the server with the lowest projected utilization for this task
+ * The heap orders servers by projection with a mean-sized task; the exact
+ * projection (load + taskLoad) / capacity may prefer one of the root's
+ * children (a larger server), so the root's child group - one cache line
+ * in a d-ary heap - is probed as well.
+ * Time Complexity: O(arity)
+ */
+static int pickByProjectedUtilization(const ServerTable* servers,
+                                      const MinHeap* heap, float taskLoad) {
+    int best = heap->arr[0].serverId;
+    float bestUtil = (servers->currentLoad[best] + taskLoad) * servers->invCapacity[best];
+    
+    int lastChild = heap->arity + 1;
+    if (lastChild > heap->size) {
+        lastChild = heap->size;
+    }
+    
+    for (int child = 1; child < lastChild; child++) {
+        int id = heap->arr[child].serverId;
+        float util = (servers->currentLoad[id] + taskLoad) * servers->invCapacity[id];
+        if (util < bestUtil) {
+            bestUtil = util;
+            best = id;
+        }
+    }
+    
+    return best;
+}
+
+/* Key of group g in the top-level heaps: mean load in ASSIGN_BY_LOAD
+ * mode, aggregate utilization otherwise
+ * Time Complexity: O(1)
+ */
+static float groupHeapKey(const HierarchicalBalancer* hierarchy, int g) {
+    if (hierarchy->assignmentMode == ASSIGN_BY_LOAD) {
+        int size = hierarchy->groupStart[g + 1] - hierarchy->groupStart[g];
+        return (float)(hierarchy->groupLoad[g] / size);
+    }
+    return (float)hierarchy->groupLoad[g] * hierarchy->groupInvCapacity[g];
+}
+
+/* Key of group g in hotGroups: -aggregate utilization in every mode, the
+ * measure the cross-group threshold test compares
+ * Time Complexity: O(1)
+ */
+static float hotGroupHeapKey(const HierarchicalBalancer* hierarchy, int g) {
+    return -(float)hierarchy->groupLoad[g] * hierarchy->groupInvCapacity[g];
+}
+
+/* Internal imbalance of group g: utilization of its most utilized member
+ * minus that of its coolest member, in percent
+ * Time Complexity: O(1)
+ */
+static float groupSpread(const HierarchicalBalancer* hierarchy,
+                         const ServerTable* servers, int g) {
+    const int* members = hierarchy->members + hierarchy->groupStart[g];
+    int hot = members[hierarchy->hottest[g]->arr[0].serverId];
+    int cool = members[hierarchy->coolest[g]->arr[0].serverId];
+    return getServerLoadPercentage(servers, hot) - getServerLoadPercentage(servers, cool);
+}
+
+/* Group the fleet and build both levels of heaps from the current loads
+ * graph = NULL cuts the IDs into contiguous racks; otherwise each group
+ * lies inside one connected component of graph (edges taken as
+ * undirected), components larger than groupSize being split into
+ * near-equal chunks in ID order. groupSize = 0 uses ceil(sqrt(n)), which
+ * balances the two levels. Allocates from servers->arena when set.
+ * Time Complexity: O(n + E α(n)) for E edges
+ */
+HierarchicalBalancer* createHierarchicalBalancer(const ServerTable* servers, const Graph* graph,
+                                                 int groupSize, AssignmentMode mode, int arity) {
+    int n = servers->numServers;
+    if (groupSize <= 0) {
+        groupSize = (int)ceil(sqrt((double)n));
+    }
+    if (groupSize > n) groupSize = n;
+    
+    Arena* arena = servers->arena;
+    HierarchicalBalancer* hierarchy =
+        (HierarchicalBalancer*)lbAlloc(arena, sizeof(HierarchicalBalancer));
+    hierarchy->numServers = n;
+    hierarchy->assignmentMode = mode;
+    hierarchy->arena = arena;
+    hierarchy->members = (int*)lbAlloc(arena, n * sizeof(int));
+    hierarchy->groupOf = (int*)lbAlloc(arena, n * sizeof(int));
+    hierarchy->memberIndex = (int*)lbAlloc(arena, n * sizeof(int));
+    
+    // Units to split into groups: the whole fleet, or each component
+    int* unitStart = (int*)malloc((n + 1) * sizeof(int));
+    int numUnits = 1;
+    unitStart[0] = 0;
+    unitStart[1] = n;
+    if (graph == NULL) {
+        for (int i = 0; i < n; i++) {
+            hierarchy->members[i] = i;
+        }
+    } else {
+        // Union-find with path halving; roots are the smallest ID of a component
+        int* parent = (int*)malloc(n * sizeof(int));
+        for (int i = 0; i < n; i++) {
+            parent[i] = i;
+        }
+        for (int u = 0; u < n; u++) {
+            const int* row = graphNeighbors(graph, u);
+            int degree = graphDegree(graph, u);
+            for (int e = 0; e < degree; e++) {
+                int a = u, b = row[e];
+                while (parent[a] != a) a = parent[a] = parent[parent[a]];
+                while (parent[b] != b) b = parent[b] = parent[parent[b]];
+                if (a < b) parent[b] = a;
+                else if (b < a) parent[a] = b;
+            }
+        }
+        
+        // Counting sort by component, components in order of their smallest ID
+        int* unitOf = hierarchy->groupOf;   // Scratch until groups are assigned
+        numUnits = 0;
+        for (int i = 0; i < n; i++) {
+            int root = i;
+            while (parent[root] != root) root = parent[root];
+            unitOf[i] = (root == i) ? numUnits++ : unitOf[root];
+            parent[i] = root;
+        }
+        for (int c = 0; c <= numUnits; c++) {
+            unitStart[c] = 0;
+        }
+        for (int i = 0; i < n; i++) {
+            unitStart[unitOf[i] + 1]++;
+        }
+        for (int c = 0; c < numUnits; c++) {
+            unitStart[c + 1] += unitStart[c];
+        }
+        for (int c = 0; c < numUnits; c++) {
+            parent[c] = unitStart[c];   // Reused: next free slot of component c
+        }
+        for (int i = 0; i < n; i++) {
+            hierarchy->members[parent[unitOf[i]]++] = i;
+        }
+        free(parent);
+    }
+    
+    // Each unit of size s becomes ceil(s / groupSize) near-equal groups
+    int numGroups = 0;
+    for (int c = 0; c < numUnits; c++) {
+        int size = unitStart[c + 1] - unitStart[c];
+        numGroups += (size + groupSize - 1) / groupSize;
+    }
+    hierarchy->numGroups = numGroups;
+    hierarchy->groupStart = (int*)lbAlloc(arena, (numGroups + 1) * sizeof(int));
+    int g = 0;
+    for (int c = 0; c < numUnits; c++) {
+        int size = unitStart[c + 1] - unitStart[c];
+        int chunks = (size + groupSize - 1) / groupSize;
+        int first = unitStart[c];
+        for (int k = 0; k < chunks; k++) {
+            hierarchy->groupStart[g++] = first;
+            first += size / chunks + (k < size % chunks ? 1 : 0);
+        }
+    }
+    hierarchy->groupStart[numGroups] = n;
+    free(unitStart);
+    
+    // Per-group heaps, aggregates and the three top-level heaps
+    hierarchy->coolest = (MinHeap**)lbAlloc(arena, numGroups * sizeof(MinHeap*));
+    hierarchy->hottest = (MinHeap**)lbAlloc(arena, numGroups * sizeof(MinHeap*));
+    hierarchy->groupLoad = (double*)lbAlloc(arena, numGroups * sizeof(double));
+    hierarchy->groupInvCapacity = (float*)lbAlloc(arena, numGroups * sizeof(float));
+    float* keys = (float*)calloc(n > numGroups ? n : numGroups, sizeof(float));
+    
+    for (g = 0; g < numGroups; g++) {
+        const int* members = hierarchy->members + hierarchy->groupStart[g];
+        int size = hierarchy->groupStart[g + 1] - hierarchy->groupStart[g];
+        double load = 0.0, capacity = 0.0;
+        for (int m = 0; m < size; m++) {
+            hierarchy->groupOf[members[m]] = g;
+            hierarchy->memberIndex[members[m]] = m;
+            load += servers->currentLoad[members[m]];
+            capacity += servers->capacity[members[m]];
+        }
+        hierarchy->groupLoad[g] = load;
+        hierarchy->groupInvCapacity[g] = (float)(1.0 / capacity);
+        
+        hierarchy->coolest[g] = createDaryHeapIn(arena, size, arity);
+        hierarchy->hottest[g] = createDaryHeapIn(arena, size, arity);
+        for (int m = 0; m < size; m++) {
+            keys[m] = serverHeapKey(servers, members[m], mode);
+        }
+        buildHeap(hierarchy->coolest[g], keys, size);
+        for (int m = 0; m < size; m++) {
+            keys[m] = -servers->currentLoad[members[m]] * servers->invCapacity[members[m]];
+        }
+        buildHeap(hierarchy->hottest[g], keys, size);
+    }
+    
+    hierarchy->groups = createDaryHeapIn(arena, numGroups, arity);
+    hierarchy->hotGroups = createDaryHeapIn(arena, numGroups, arity);
+    hierarchy->spreads = createDaryHeapIn(arena, numGroups, arity);
+    for (g = 0; g < numGroups; g++) {
+        keys[g] = groupHeapKey(hierarchy, g);
+    }
+    buildHeap(hierarchy->groups, keys, numGroups);
+    for (g = 0; g < numGroups; g++) {
+        keys[g] = hotGroupHeapKey(hierarchy, g);
+    }
+    buildHeap(hierarchy->hotGroups, keys, numGroups);
+    for (g = 0; g < numGroups; g++) {
+        keys[g] = -groupSpread(hierarchy, servers, g);
+    }
+    buildHeap(hierarchy->spreads, keys, numGroups);
+    free(keys);
+    
+    return hierarchy;
+}
+
+/* Free a hierarchical balancer (arena balancers are released by freeArena)
+ * Time Complexity: O(G) for G groups
+ */
+void freeHierarchicalBalancer(HierarchicalBalancer* hierarchy) {
+    if (hierarchy->arena) return;
+    for (int g = 0; g < hierarchy->numGroups; g++) {
+        freeMinHeap(hierarchy->coolest[g]);
+        freeMinHeap(hierarchy->hottest[g]);
+    }
+    freeMinHeap(hierarchy->groups);
+    freeMinHeap(hierarchy->hotGroups);
+    freeMinHeap(hierarchy->spreads);
+    free(hierarchy->coolest);
+    free(hierarchy->hottest);
+    free(hierarchy->groupLoad);
+    free(hierarchy->groupInvCapacity);
+    free(hierarchy->groupStart);
+    free(hierarchy->members);
+    free(hierarchy->groupOf);
+    free(hierarchy->memberIndex);
+    free(hierarchy);
+}
+
+/* Server a task goes to: the coolest member of the coolest group
+ * Time Complexity: O(1)
+ */
+int hierarchyTarget(const HierarchicalBalancer* hierarchy) {
+    int g = hierarchy->groups->arr[0].serverId;
+    int m = hierarchy->coolest[g]->arr[0].serverId;
+    return hierarchy->members[hierarchy->groupStart[g] + m];
+}
+
+/* Re-key a server whose load just changed by delta, and its group
+ * Time Complexity: O(log S + log G)
+ */
+void refreshHierarchy(HierarchicalBalancer* hierarchy, const ServerTable* servers,
+                      int serverId, float delta) {
+    int g = hierarchy->groupOf[serverId];
+    int m = hierarchy->memberIndex[serverId];
+    hierarchy->groupLoad[g] += delta;
+    
+    updateHeap(hierarchy->coolest[g], m,
+               serverHeapKey(servers, serverId, hierarchy->assignmentMode));
+    updateHeap(hierarchy->hottest[g], m,
+               -servers->currentLoad[serverId] * servers->invCapacity[serverId]);
+    
+    updateHeap(hierarchy->groups, g, groupHeapKey(hierarchy, g));
+    updateHeap(hierarchy->hotGroups, g, hotGroupHeapKey(hierarchy, g));
+    updateHeap(hierarchy->spreads, g, -groupSpread(hierarchy, servers, g));
+}
+
+/* Load to move from donor to receiver: half the donor's excess over
+ * meanLoad, capped so the receiver never ends up more utilized than the
+ * donor (0 if the donor has nothing to give)
+ * Time Complexity: O(1)
+ */
+static float hierarchyMigrationAmount(const ServerTable* servers, int donor,
+                                      int receiver, float meanLoad) {
+    float amount = (servers->currentLoad[donor] - meanLoad) * 0.5f;
+    float equalize = (servers->currentLoad[donor] * servers->capacity[receiver] -
+                      servers->currentLoad[receiver] * servers->capacity[donor]) /
+                     (servers->capacity[donor] + servers->capacity[receiver]);
+    if (amount > equalize) {
+        amount = equalize;
+    }
+    return (amount > 0.0f) ? amount : 0.0f;
+}
+
+/* One hierarchical rebalancing pass, rack-local first
+ * If some group's internal spread exceeds the threshold, its most utilized
+ * member sends load to its coolest member, so the work never leaves the
+ * group. Otherwise, if the aggregate utilization of the hottest and the
+ * coolest group differ by more than the threshold, the hottest group's
+ * most utilized member sends load to the coolest group's coolest member.
+ * Amounts are half the donor's excess over the mean load of the groups
+ * involved. Each group stays within the threshold internally and across
+ * groups, so the fleet-wide server spread is at most about twice the
+ * threshold. Returns the amount of load migrated.
+ * Time Complexity: O(log S + log G)
+ */
+float rebalanceHierarchy(HierarchicalBalancer* hierarchy, ServerTable* servers,
+                         const SimulationOptions* opts) {
+    float threshold = opts->rebalanceThreshold;
+    const int* start = hierarchy->groupStart;
+    
+    // Rack-local: the group with the widest internal spread
+    int from = hierarchy->spreads->arr[0].serverId;
+    int to = from;
+    float imbalance = -hierarchy->spreads->arr[0].load;
+    int donor = 0, receiver = 0;
+    float amount = 0.0f;
+    if (imbalance > threshold) {
+        donor = hierarchy->members[start[from] + hierarchy->hottest[from]->arr[0].serverId];
+        receiver = hierarchy->members[start[from] + hierarchy->coolest[from]->arr[0].serverId];
+        float meanLoad = (float)(hierarchy->groupLoad[from] / (start[from + 1] - start[from]));
+        amount = hierarchyMigrationAmount(servers, donor, receiver, meanLoad);
+    }
+    
+    // Cross-group: hottest group -> coolest group
+    if (amount <= 0.0f) {
+        from = hierarchy->hotGroups->arr[0].serverId;
+        to = hierarchy->groups->arr[0].serverId;
+        imbalance = ((float)hierarchy->groupLoad[from] * hierarchy->groupInvCapacity[from] -
+                     (float)hierarchy->groupLoad[to] * hierarchy->groupInvCapacity[to]) * 100.0f;
+        if (from == to || imbalance <= threshold) {
+            return 0.0f;
+        }
+        donor = hierarchy->members[start[from] + hierarchy->hottest[from]->arr[0].serverId];
+        receiver = hierarchy->members[start[to] + hierarchy->coolest[to]->arr[0].serverId];
+        float meanLoad = (float)((hierarchy->groupLoad[from] + hierarchy->groupLoad[to]) /
+                                 (start[from + 1] - start[from] + start[to + 1] - start[to]));
+        amount = hierarchyMigrationAmount(servers, donor, receiver, meanLoad);
+        if (amount <= 0.0f) {
+            return 0.0f;
+        }
+    }
+    
+    if (opts->logLevel >= LOG_INFO) {
+        printf("\n⚠️  REBALANCING TRIGGERED ⚠️\n");
+        if (from == to) {
+            printf("   Imbalance: %.2f%% within group %d (threshold: %.2f%%)\n",
+                   imbalance, from, threshold);
+        } else {
+            printf("   Imbalance: %.2f%% from group %d to group %d (threshold: %.2f%%)\n",
+                   imbalance, from, to, threshold);
+        }
+        printf("   Server %d (%.2f%%) → Server %d (%.2f%%)\n",
+               donor, getServerLoadPercentage(servers, donor),
+               receiver, getServerLoadPercentage(servers, receiver));
+        printf("   Migrating %.2f load units\n", amount);
+    }
+    
+    servers->currentLoad[donor] -= amount;
+    servers->currentLoad[receiver] += amount;
+    publishLoadChange(servers, donor, -amount, 0);
+    publishLoadChange(servers, receiver, amount, 0);
+    METRIC_MIGRATION(amount);
+    METRIC_ADD(METRIC_LOCAL_MIGRATIONS, from == to);
+    
+    if (opts->events) {
+        recordMigration(opts->events, donor, receiver, amount,
+                        servers->currentLoad[donor]);
+    }
+    
+    refreshHierarchy(hierarchy, servers, donor, -amount);
+    refreshHierarchy(hierarchy, servers, receiver, amount);
+    
+    if (opts->logLevel >= LOG_INFO) {
+        printf("   ✓ Rebalancing complete\n");
+    }
+    
+    return amount;
+}
+
+/* Rebalance loads across servers if imbalance exceeds threshold
+ * With an ImbalanceTracker attached the average and the extremes come from
+ * the tracker, so a pass that finds the fleet balanced costs O(1). Tables
+ * with vector loads are rebalanced on dominant shares by rebalanceResources.
+ * Returns the amount of load migrated (0 if no rebalancing was needed).
+ * Time Complexity: O(n), or O(log n) with a tracker
+ */
+float rebalanceLoads(ServerTable* servers, MinHeap* heap,
+                     const SimulationOptions* opts) {
+    if (servers->resources) {
+        return rebalanceResources(servers, heap, opts);
+    }
+    float threshold = opts->rebalanceThreshold;
+    
+    // Average, most and least loaded server: tracked, or from one fused pass
+    float avgLoad;
+    int mostLoadedIdx, leastLoadedIdx;
+    if (servers->tracker) {
+        ExtremesNode extremes = trackedExtremes(servers->tracker);
+        avgLoad = (float)(servers->tracker->totalLoad / servers->numServers);
+        mostLoadedIdx = extremes.maxLoad;
+        leastLoadedIdx = extremes.minLoad;
+    } else {
+        LoadScan scan = scanServerTable(servers);
+        avgLoad = scan.totalLoad / servers->numServers;
+        mostLoadedIdx = scan.mostLoaded;
+        leastLoadedIdx = scan.leastLoaded;
+    }
+    
+    float mostLoadedPercent = getServerLoadPercentage(servers, mostLoadedIdx);
+    float leastLoadedPercent = getServerLoadPercentage(servers, leastLoadedIdx);
+    
+    float imbalance = mostLoadedPercent - leastLoadedPercent;
+    
+    // Check if rebalancing is needed
+    if (imbalance <= threshold) {
+        return 0.0f;
+    }
+    
+    float migrationAmount = (servers->currentLoad[mostLoadedIdx] - avgLoad) * 0.5;
+    
+    if (opts->logLevel >= LOG_INFO) {
+        printf("\n⚠️  REBALANCING TRIGGERED ⚠️\n");
+        printf("   Imbalance: %.2f%% (threshold: %.2f%%)\n", imbalance, threshold);
+        printf("   Server %d (%.2f%%) → Server %d (%.2f%%)\n",
+               mostLoadedIdx, mostLoadedPercent,
+               leastLoadedIdx, leastLoadedPercent);
+        printf("   Migrating %.2f load units\n", migrationAmount);
+    }
+    
+    // Perform load migration
+    servers->currentLoad[mostLoadedIdx] -= migrationAmount;
+    servers->currentLoad[leastLoadedIdx] += migrationAmount;
+    publishLoadChange(servers, mostLoadedIdx, -migrationAmount, 0);
+    publishLoadChange(servers, leastLoadedIdx, migrationAmount, 0);
+    METRIC_MIGRATION(migrationAmount);
+    
+    if (opts->events) {
+        recordMigration(opts->events, mostLoadedIdx, leastLoadedIdx,
+                        migrationAmount, servers->currentLoad[mostLoadedIdx]);
+    }
+    
+    // Update heap with new keys
+    updateHeap(heap, mostLoadedIdx,
+               serverHeapKey(servers, mostLoadedIdx, opts->assignmentMode));
+    updateHeap(heap, leastLoadedIdx,
+               serverHeapKey(servers, leastLoadedIdx, opts->assignmentMode));
+    
+    if (opts->logLevel >= LOG_INFO) {
+        printf("   ✓ Rebalancing complete\n");
+    }
+    
+    return migrationAmount;
+}
+
+/* Create plan scratch space for a fleet of numServers
+ * Time Complexity: O(1)
+ */
+RebalancePlan* createRebalancePlan(int numServers) {
+    RebalancePlan* plan = (RebalancePlan*)malloc(sizeof(RebalancePlan));
+    plan->capacity = numServers;
+    plan->numMigrations = 0;
+    plan->targetPercent = 0.0f;
+    plan->migrations = (Migration*)malloc(numServers * sizeof(Migration));
+    plan->donors = (RebalanceCandidate*)malloc(numServers * sizeof(RebalanceCandidate));
+    plan->receivers = (RebalanceCandidate*)malloc(numServers * sizeof(RebalanceCandidate));
+    plan->scratch = (float*)malloc(numServers * sizeof(float));
+    return plan;
+}
+
+/* Free plan memory
+ * Time Complexity: O(1)
+ */
+void freeRebalancePlan(RebalancePlan* plan) {
+    free(plan->migrations);
+    free(plan->donors);
+    free(plan->receivers);
+    free(plan->scratch);
+    free(plan);
+}
+
+/* qsort order: largest deviation first, lower serverId on ties */
+static int compareCandidates(const void* a, const void* b) {
+    const RebalanceCandidate* x = (const RebalanceCandidate*)a;
+    const RebalanceCandidate* y = (const RebalanceCandidate*)b;
+    if (x->deviation > y->deviation) return -1;
+    if (x->deviation < y->deviation) return 1;
+    return x->serverId - y->serverId;
+}
+
+/* Plan a full migration set for the fleet in one pass
+ * The target is the fleet utilization (total load / total capacity). Servers
+ * above it are donors, servers below it receivers; both lists are sorted by
+ * distance from the target and matched greedily, each migration moving
+ * min(donor excess, receiver deficit). A partly matched donor or receiver
+ * that is within threshold / 2 of the target is passed over while any
+ * candidate behind it is not; matching stops once the worst remaining donor
+ * and receiver are both within that band, so the resulting spread is at
+ * most about the threshold. With an
+ * ImbalanceTracker attached a balanced fleet is rejected in O(1).
+ * Returns the number of planned migrations (0 if spread <= threshold).
+ * Time Complexity: O(n log n)
+ */
+int planRebalance(const ServerTable* servers, float threshold, RebalancePlan* plan) {
+    int n = servers->numServers;
+    plan->numMigrations = 0;
+    
+    // Utilization spread decides whether a pass is needed at all
+    if (servers->tracker) {
+        ExtremesNode extremes = trackedExtremes(servers->tracker);
+        if (getServerLoadPercentage(servers, extremes.maxUtil) -
+            getServerLoadPercentage(servers, extremes.minUtil) <= threshold) {
+            return 0;
+        }
+    }
+    computeLoadPercentages(servers, plan->scratch);
+    LoadScan spread = scanLoadArray(plan->scratch, n);
+    if (plan->scratch[spread.mostLoaded] - plan->scratch[spread.leastLoaded] <= threshold) {
+        return 0;
+    }
+    
+    float totalLoad = 0.0f, totalCapacity = 0.0f;
+    for (int i = 0; i < n; i++) {
+        totalLoad += servers->currentLoad[i];
+        totalCapacity += servers->capacity[i];
+    }
+    float target = totalLoad / totalCapacity;
+    plan->targetPercent = target * 100.0f;
+    
+    // Split the fleet around the target
+    int numDonors = 0, numReceivers = 0;
+    for (int i = 0; i < n; i++) {
+        float deviation = plan->scratch[i] - plan->targetPercent;
+        float amount = servers->currentLoad[i] - target * servers->capacity[i];
+        if (deviation > 0.0f) {
+            plan->donors[numDonors].serverId = i;
+            plan->donors[numDonors].amount = amount;
+            plan->donors[numDonors].deviation = deviation;
+            numDonors++;
+        } else if (deviation < 0.0f) {
+            plan->receivers[numReceivers].serverId = i;
+            plan->receivers[numReceivers].amount = -amount;
+            plan->receivers[numReceivers].deviation = -deviation;
+            numReceivers++;
+        }
+    }
+    
+    qsort(plan->donors, numDonors, sizeof(RebalanceCandidate), compareCandidates);
+    qsort(plan->receivers, numReceivers, sizeof(RebalanceCandidate), compareCandidates);
+    
+    // Greedy matching: worst donor with worst receiver
+    float band = threshold / 2.0f;
+    int d = 0, r = 0;
+    while (d < numDonors && r < numReceivers && plan->numMigrations < plan->capacity) {
+        RebalanceCandidate* donor = &plan->donors[d];
+        RebalanceCandidate* receiver = &plan->receivers[r];
+        
+        float donorDev = donor->amount * servers->invCapacity[donor->serverId] * 100.0f;
+        float receiverDev = receiver->amount * servers->invCapacity[receiver->serverId] * 100.0f;
+        if (donorDev <= band && receiverDev <= band) {
+            // Only the heads were drawn down; the next candidates in each
+            // list are untouched and the worst remaining ones
+            int donorsLeft = d + 1 < numDonors && plan->donors[d + 1].deviation > band;
+            int receiversLeft = r + 1 < numReceivers &&
+                                plan->receivers[r + 1].deviation > band;
+            if (!donorsLeft && !receiversLeft) break;
+            d += donorsLeft;
+            r += receiversLeft;
+            continue;
+        }
+        
+        float amount = (donor->amount < receiver->amount) ? donor->amount : receiver->amount;
+        Migration* m = &plan->migrations[plan->numMigrations++];
+        m->from = donor->serverId;
+        m->to = receiver->serverId;
+        m->amount = amount;
+        
+        donor->amount -= amount;
+        receiver->amount -= amount;
+        if (donor->amount <= 0.0f) d++;
+        if (receiver->amount <= 0.0f) r++;
+    }
+    
+    return plan->numMigrations;
+}
+
+/* Apply every planned migration, then rebuild the heap once
+ * One Floyd heapify replaces two updateHeap calls per migration.
+ * Returns the total load migrated.
+ * Time Complexity: O(n)
+ */
+float applyRebalancePlan(ServerTable* servers, MinHeap* heap,
+                         RebalancePlan* plan, AssignmentMode mode) {
+    float migrated = 0.0f;
+    
+    for (int k = 0; k < plan->numMigrations; k++) {
+        const Migration* m = &plan->migrations[k];
+        servers->currentLoad[m->from] -= m->amount;
+        servers->currentLoad[m->to] += m->amount;
+        publishLoadChange(servers, m->from, -m->amount, 0);
+        publishLoadChange(servers, m->to, m->amount, 0);
+        METRIC_MIGRATION(m->amount);
+        migrated += m->amount;
+    }
+    
+    if (plan->numMigrations > 0) {
+        for (int i = 0; i < servers->numServers; i++) {
+            plan->scratch[i] = serverHeapKey(servers, i, mode);
+        }
+        buildHeap(heap, plan->scratch, servers->numServers);
+    }
+    
+    return migrated;
+}
+
+/* Multi-pair rebalancing: plan the whole migration set, apply it in a batch
+ * Returns the amount of load migrated (0 if no rebalancing was needed).
+ * Time Complexity: O(n log n)
+ */
+float rebalanceMultiPair(ServerTable* servers, MinHeap* heap, RebalancePlan* plan,
+                         const SimulationOptions* opts) {
+    if (planRebalance(servers, opts->rebalanceThreshold, plan) == 0) {
+        return 0.0f;
+    }
+    
+    if (opts->logLevel >= LOG_INFO) {
+        printf("\n⚠️  REBALANCING TRIGGERED ⚠️\n");
+        printf("   Target utilization: %.2f%% (threshold: %.2f%%)\n",
+               plan->targetPercent, opts->rebalanceThreshold);
+        for (int k = 0; k < plan->numMigrations; k++) {
+            printf("   Server %d → Server %d: %.2f load units\n",
+                   plan->migrations[k].from, plan->migrations[k].to,
+                   plan->migrations[k].amount);
+        }
+    }
+    
+    float migrated = applyRebalancePlan(servers, heap, plan, opts->assignmentMode);
+    
+    if (opts->events) {
+        for (int k = 0; k < plan->numMigrations; k++) {
+            const Migration* m = &plan->migrations[k];
+            recordMigration(opts->events, m->from, m->to, m->amount,
+                            servers->currentLoad[m->from]);
+        }
+    }
+    
+    if (opts->logLevel >= LOG_INFO) {
+        printf("   ✓ Rebalancing complete (%d migrations, %.2f units)\n",
+               plan->numMigrations, migrated);
+    }
+    
+    return migrated;
+}
+
+/* Topology-aware rebalancing: migrate only within the network graph
+ * The hottest server (highest utilization) sends load to the least utilized
+ * server reachable within opts->maxMigrationHops along graph edges (fewer
+ * hops wins on ties). The amount is half the excess above the fleet average,
+ * as in rebalanceLoads, capped so the receiver never ends up hotter than the
+ * donor. The migrated load x hop count is added to *hopCost. With an
+ * ImbalanceTracker attached the global check is O(1).
+ * Returns the amount of load migrated (0 if no rebalancing was needed).
+ * Time Complexity: O(n + visited edges), or O(visited edges) with a tracker
+ */
+float rebalanceTopology(ServerTable* servers, Graph* graph, MinHeap* heap,
+                        HopSearch* search, const SimulationOptions* opts,
+                        double* hopCost) {
+    int n = servers->numServers;
+    float threshold = opts->rebalanceThreshold;
+    
+    // Global spread decides whether a pass is needed at all
+    float maxPercent = -INFINITY, minPercent = INFINITY, totalLoad = 0.0f;
+    int hot = 0;
+    if (servers->tracker) {
+        ExtremesNode extremes = trackedExtremes(servers->tracker);
+        hot = extremes.maxUtil;
+        maxPercent = getServerLoadPercentage(servers, hot);
+        minPercent = getServerLoadPercentage(servers, extremes.minUtil);
+        totalLoad = (float)servers->tracker->totalLoad;
+    } else {
+        for (int i = 0; i < n; i++) {
+            float percent = getServerLoadPercentage(servers, i);
+            totalLoad += servers->currentLoad[i];
+            if (percent > maxPercent) {
+                maxPercent = percent;
+                hot = i;
+            }
+            if (percent < minPercent) {
+                minPercent = percent;
+            }
+        }
+    }
+    if (maxPercent - minPercent <= threshold) {
+        return 0.0f;
+    }
+    
+    // Least utilized server reachable from the hot one
+    int reached = searchWithinHops(graph, hot, opts->maxMigrationHops, search);
+    int target = -1;
+    float targetPercent = maxPercent;
+    for (int k = 1; k < reached; k++) {
+        int id = search->queue[k];
+        float percent = getServerLoadPercentage(servers, id);
+        if (percent < targetPercent) {  // BFS order: fewer hops wins ties
+            targetPercent = percent;
+            target = id;
+        }
+    }
+    int hops = (target >= 0) ? search->hops[target] : 0;
+    clearHopSearch(search, reached);
+    
+    if (target < 0) {
+        return 0.0f;  // Isolated or no cooler server within reach
+    }
+    
+    // Half the excess above average, never past equal utilization
+    float migrationAmount = (servers->currentLoad[hot] - totalLoad / n) * 0.5f;
+    float equalize = (servers->currentLoad[hot] * servers->capacity[target] -
+                      servers->currentLoad[target] * servers->capacity[hot]) /
+                     (servers->capacity[hot] + servers->capacity[target]);
+    if (migrationAmount > equalize) {
+        migrationAmount = equalize;
+    }
+    if (migrationAmount <= 0.0f) {
+        return 0.0f;
+    }
+    
+    if (opts->logLevel >= LOG_INFO) {
+        printf("\n⚠️  REBALANCING TRIGGERED ⚠️\n");
+        printf("   Imbalance: %.2f%% (threshold: %.2f%%)\n",
+               maxPercent - minPercent, threshold);
+        printf("   Server %d (%.2f%%) → Server %d (%.2f%%), %d hop%s\n",
+               hot, maxPercent, target, targetPercent, hops, hops == 1 ? "" : "s");
+        printf("   Migrating %.2f load units\n", migrationAmount);
+    }
+    
+    servers->currentLoad[hot] -= migrationAmount;
+    servers->currentLoad[target] += migrationAmount;
+    publishLoadChange(servers, hot, -migrationAmount, 0);
+    publishLoadChange(servers, target, migrationAmount, 0);
+    METRIC_MIGRATION(migrationAmount);
+    
+    if (opts->events) {
+        recordMigration(opts->events, hot, target, migrationAmount,
+                        servers->currentLoad[hot]);
+    }
+    
+    updateHeap(heap, hot, serverHeapKey(servers, hot, opts->assignmentMode));
+    updateHeap(heap, target, serverHeapKey(servers, target, opts->assignmentMode));
+    
+    if (hopCost) {
+        *hopCost += migrationAmount * hops;
+    }
+    
+    if (opts->logLevel >= LOG_INFO) {
+        printf("   ✓ Rebalancing complete\n");
+    }
+    
+    return migrationAmount;
+}
+
+/* Place one task on a given server (a replayed task with an affinity)
+ * heap may be NULL (d-choices runs). Returns serverId.
+ * Time Complexity: O(log n) - one sift in the heap (or in each hierarchy level)
+ */
+int assignTaskTo(ServerTable* servers, MinHeap* heap, int serverId, float taskLoad,
+                 const SimulationOptions* opts) {
+    servers->currentLoad[serverId] += taskLoad;
+    publishLoadChange(servers, serverId, taskLoad, 1);
+    if (opts->hierarchy) {
+        refreshHierarchy(opts->hierarchy, servers, serverId, taskLoad);
+    } else if (heap) {
+        updateHeap(heap, serverId, serverHeapKey(servers, serverId, opts->assignmentMode));
+    }
+    
+    METRIC_ADD(METRIC_TASKS_ASSIGNED, 1);
+    return serverId;
+}
+
+/* Place one task on the best server and update that server's heap key
+ * The least-loaded root is used directly in ASSIGN_BY_LOAD mode; in
+ * ASSIGN_BY_UTILIZATION mode the root's child group is probed too. With
+ * opts->hierarchy set, the heap is unused and the coolest member of the
+ * coolest group is picked instead.
+ * Returns the chosen server.
+ * Time Complexity: O(log n), O(log S + log G) with a hierarchy
+ */
+int assignTask(ServerTable* servers, MinHeap* heap, float taskLoad,
+               const SimulationOptions* opts) {
+    METRIC_SAMPLE_CLOCK(start, METRIC_TASKS_ASSIGNED);
+    
+    if (opts->hierarchy) {
+        int serverId = assignTaskTo(servers, heap, hierarchyTarget(opts->hierarchy),
+                                    taskLoad, opts);
+        METRIC_OBSERVE_SINCE(HISTOGRAM_ASSIGN_NS, start);
+        return serverId;
+    }
+    
+    // Find least-loaded server using heap
+    int serverId = peekMin(heap).serverId;
+    if (opts->assignmentMode == ASSIGN_BY_UTILIZATION) {
+        serverId = pickByProjectedUtilization(servers, heap, taskLoad);
+    }
+    
+    // Assign task to this server
+    servers->currentLoad[serverId] += taskLoad;
+    publishLoadChange(servers, serverId, taskLoad, 1);
+    float newKey = serverHeapKey(servers, serverId, opts->assignmentMode);
+    
+    // Update the root in place with a single sift-down
+    if (serverId == peekMin(heap).serverId) {
+        replaceTop(heap, newKey);
+    } else {
+        updateHeap(heap, serverId, newKey);
+    }
+    
+    METRIC_ADD(METRIC_TASKS_ASSIGNED, 1);
+    METRIC_OBSERVE_SINCE(HISTOGRAM_ASSIGN_NS, start);
+    return serverId;
+}
+
+/* Create a sort workspace for batches of up to capacity tasks
+ * Time Complexity: O(1)
+ */
+BatchPlan* createBatchPlan(int capacity) {
+    BatchPlan* plan = (BatchPlan*)malloc(sizeof(BatchPlan));
+    plan->capacity = capacity;
+    plan->keys = (uint64_t*)malloc(capacity * sizeof(uint64_t));
+    plan->scratch = (uint64_t*)malloc(capacity * sizeof(uint64_t));
+    return plan;
+}
+
+/* Free batch workspace
+ * Time Complexity: O(1)
+ */
+void freeBatchPlan(BatchPlan* plan) {
+    free(plan->keys);
+    free(plan->scratch);
+    free(plan);
+}
+
+/* Sort batch keys ascending by their upper 32 bits (the load part)
+ * Keys start in task order, so a stable LSD radix sort keeps ties in
+ * arrival order. Passes whose byte is the same for every key (common:
+ * task loads span a narrow exponent range) are skipped. Small batches use
+ * insertion sort.
+ * Time Complexity: O(k) for k keys (O(k^2) below 32 keys)
+ */
+static void sortBatchKeys(BatchPlan* plan, int n) {
+    uint64_t* keys = plan->keys;
+    if (n < 32) {
+        for (int i = 1; i < n; i++) {
+            uint64_t key = keys[i];
+            int j = i - 1;
+            while (j >= 0 && keys[j] > key) {
+                keys[j + 1] = keys[j];
+                j--;
+            }
+            keys[j + 1] = key;
+        }
+        return;
+    }
+    
+    uint64_t* scratch = plan->scratch;
+    for (int shift = 32; shift < 64; shift += 8) {
+        int count[257] = {0};
+        for (int i = 0; i < n; i++) {
+            count[((keys[i] >> shift) & 0xFF) + 1]++;
+        }
+        if (count[((keys[0] >> shift) & 0xFF) + 1] == n) {
+            continue;
+        }
+        for (int d = 0; d < 256; d++) {
+            count[d + 1] += count[d];
+        }
+        for (int i = 0; i < n; i++) {
+            scratch[count[(keys[i] >> shift) & 0xFF]++] = keys[i];
+        }
+        uint64_t* swapKeys = keys;
+        keys = scratch;
+        scratch = swapKeys;
+    }
+    
+    if (keys != plan->keys) {
+        memcpy(plan->keys, keys, n * sizeof(uint64_t));
+    }
+}
+
+/* Assign a whole batch of tasks, largest first (LPT)
+ * Task loads must be non-negative.
+ * Greedy placement in decreasing load order packs tighter than arrival
+ * order: the big tasks are spread first and the small ones fill the gaps.
+ * Each placement is a single in-place sift of the heap root.
+ * placements[i] receives the server chosen for tasks[i].
+ * Returns n, or -1 if n exceeds the plan's capacity.
+ * Time Complexity: O(k log n) for a batch of k tasks
+ */
+int assignBatch(ServerTable* servers, MinHeap* heap, BatchPlan* plan,
+                const float* tasks, int n, int* placements,
+                const SimulationOptions* opts) {
+    if (n > plan->capacity) {
+        printf("Batch of %d tasks exceeds plan capacity %d\n", n, plan->capacity);
+        return -1;
+    }
+    
+    // Non-negative floats order like their bit patterns; invert for descending
+    for (int i = 0; i < n; i++) {
+        uint32_t bits;
+        memcpy(&bits, &tasks[i], sizeof(bits));
+        plan->keys[i] = ((uint64_t)~bits << 32) | (uint32_t)i;
+    }
+    sortBatchKeys(plan, n);
+    
+    for (int i = 0; i < n; i++) {
+        int task = (int)(uint32_t)plan->keys[i];
+        placements[task] = assignTask(servers, heap, tasks[task], opts);
+    }
+    
+    return n;
+}
+
+/* Create a pool for up to capacity in-flight tasks on numServers servers,
+ * in arena (NULL = malloc)
+ * Time Complexity: O(capacity + numServers)
+ */
+TaskTable* createTaskTableIn(Arena* arena, int capacity, int numServers) {
+    TaskTable* tasks = (TaskTable*)lbAlloc(arena, sizeof(TaskTable));
+    tasks->arena = arena;
+    tasks->capacity = capacity;
+    tasks->numActive = 0;
+    tasks->load = (float*)lbAlloc(arena, capacity * sizeof(float));
+    tasks->serverId = (int*)lbAlloc(arena, capacity * sizeof(int));
+    tasks->task = (int*)lbAlloc(arena, capacity * sizeof(int));
+    tasks->next = (int*)lbAlloc(arena, capacity * sizeof(int));
+    
+    for (int i = 0; i < capacity; i++) {
+        tasks->serverId[i] = -1;
+        tasks->next[i] = i + 1;
+    }
+    if (capacity > 0) {
+        tasks->next[capacity - 1] = -1;
+    }
+    tasks->freeHead = (capacity > 0) ? 0 : -1;
+    tasks->numServers = numServers;
+    tasks->residentLoad = (double*)lbCalloc(arena, numServers, sizeof(double));
+    
+    return tasks;
+}
+
+/* Create a malloc-backed task pool
+ * Time Complexity: O(capacity + numServers)
+ */
+TaskTable* createTaskTable(int capacity, int numServers) {
+    return createTaskTableIn(NULL, capacity, numServers);
+}
+
+/* Free task pool memory (arena pools are released by freeArena)
+ * Time Complexity: O(1)
+ */
+void freeTaskTable(TaskTable* tasks) {
+    if (tasks->arena) return;
+    free(tasks->load);
+    free(tasks->serverId);
+    free(tasks->task);
+    free(tasks->next);
+    free(tasks->residentLoad);
+    free(tasks);
+}
+
+/* Remember that task (arrival number) with taskLoad runs on serverId
+ * Returns the task id for completeTask, or -1 if the pool is full.
+ * Time Complexity: O(1)
+ */
+int trackTask(TaskTable* tasks, int task, int serverId, float taskLoad) {
+    int id = tasks->freeHead;
+    if (id == -1) {
+        printf("Task table full (%d tasks in flight)\n", tasks->capacity);
+        return -1;
+    }
+    
+    tasks->freeHead = tasks->next[id];
+    tasks->load[id] = taskLoad;
+    tasks->serverId[id] = serverId;
+    tasks->task[id] = task;
+    tasks->residentLoad[serverId] += taskLoad;
+    tasks->numActive++;
+    return id;
+}
+
+/* Finish a tracked task: remove its share of its server's load and
+ * decrease the server's heap key
+ * Rebalancing migrates load, not tasks, so a server's load no longer
+ * equals the sum of its running tasks. Each task therefore releases its
+ * fraction of the server's resident task load (load x currentLoad /
+ * residentLoad), and the last running task releases whatever is left, so
+ * migrated load leaves with the tasks on the server it moved to.
+ * heap may be NULL (d-choices runs). The slot is returned to the pool.
+ * Returns the server the task ran on, or -1 for an invalid id.
+ * Time Complexity: O(log n) - one sift-up in the heap
+ */
+int completeTask(ServerTable* servers, MinHeap* heap, TaskTable* tasks, int id,
+                 const SimulationOptions* opts) {
+    if (id < 0 || id >= tasks->capacity || tasks->serverId[id] == -1) {
+        printf("Task id %d is not running\n", id);
+        return -1;
+    }
+    
+    int serverId = tasks->serverId[id];
+    double resident = tasks->residentLoad[serverId];
+    float amount = servers->currentLoad[serverId];
+    if (resident > tasks->load[id]) {
+        amount = (float)(amount * (tasks->load[id] / resident));
+    }
+    tasks->residentLoad[serverId] = (resident > tasks->load[id])
+                                        ? resident - tasks->load[id] : 0.0;
+    if (servers->resources && servers->currentLoad[serverId] > 0.0f) {
+        // Vector loads shrink by the same share as the total
+        releaseResources(servers->resources, serverId,
+                         amount / servers->currentLoad[serverId]);
+    }
+    servers->currentLoad[serverId] -= amount;
+    publishLoadChange(servers, serverId, -amount, 0);
+    METRIC_ADD(METRIC_TASKS_COMPLETED, 1);
+    if (opts->hierarchy) {
+        refreshHierarchy(opts->hierarchy, servers, serverId, -amount);
+    } else if (heap) {
+        updateHeap(heap, serverId, serverHeapKey(servers, serverId, opts->assignmentMode));
+    }
+    if (opts->events) {
+        recordCompletion(opts->events, tasks->task[id], serverId, amount,
+                         servers->currentLoad[serverId]);
+    }
+    
+    tasks->serverId[id] = -1;
+    tasks->next[id] = tasks->freeHead;
+    tasks->freeHead = id;
+    tasks->numActive--;
+    return serverId;
+}
+
+/* Create an admission queue with room for capacity pending tasks
+ * virtualTime selects the unit of waits: virtual seconds (event engine)
+ * or arrivals (loop engine).
+ * Time Complexity: O(1)
+ */
+AdmissionQueue* createAdmissionQueue(int capacity, int virtualTime) {
+    AdmissionQueue* queue = (AdmissionQueue*)calloc(1, sizeof(AdmissionQueue));
+    queue->slots = (PendingTask*)malloc((capacity > 0 ? capacity : 1) * sizeof(PendingTask));
+    queue->capacity = capacity;
+    queue->virtualTime = virtualTime;
+    return queue;
+}
+
+/* Free an admission queue
+ * Time Complexity: O(1)
+ */
+void freeAdmissionQueue(AdmissionQueue* queue) {
+    free(queue->slots);
+    free(queue);
+}
+
+/* Server a task would be placed on, or -1 if it does not fit there
+ * The check uses the server the heap selection picks (the root, the
+ * best projected utilization among the root's group, or the hierarchy's
+ * pick with opts->hierarchy set), so admission never
+ * changes where admitted tasks go; with ASSIGN_BY_UTILIZATION that is the
+ * server with the most relative headroom. A task fits if the server stays
+ * within opts->admissionLimit percent of its capacity. A task too large
+ * for an idle server is still admitted there, so it cannot block the
+ * queue forever; a server counts as idle up to IDLE_LOAD_EPSILON of its
+ * capacity, since completions can leave float rounding residue behind.
+ * Time Complexity: O(1), O(d) with ASSIGN_BY_UTILIZATION
+ */
+int admissionTarget(const ServerTable* servers, const MinHeap* heap, float taskLoad,
+                    int pin, const SimulationOptions* opts) {
+    int serverId = pin;
+    if (serverId < 0 && opts->hierarchy) {
+        serverId = hierarchyTarget(opts->hierarchy);
+    } else if (serverId < 0) {
+        serverId = (opts->assignmentMode == ASSIGN_BY_UTILIZATION)
+                       ? pickByProjectedUtilization(servers, heap, taskLoad)
+                       : heap->arr[0].serverId;
+    }
+    
+    float load = servers->currentLoad[serverId];
+    float limit = servers->capacity[serverId] * opts->admissionLimit * 0.01f;
+    int idle = (load <= servers->capacity[serverId] * IDLE_LOAD_EPSILON);
+    return (load + taskLoad <= limit || idle) ? serverId : -1;
+}
+
+/* Place a task (on its pinned server if pin >= 0) only if it fits
+ * Returns the server, or -1 if the task must wait.
+ * Time Complexity: O(log n)
+ */
+int admitTask(ServerTable* servers, MinHeap* heap, float taskLoad, int pin,
+              const SimulationOptions* opts) {
+    if (admissionTarget(servers, heap, taskLoad, pin, opts) < 0) {
+        return -1;
+    }
+    return (pin >= 0) ? assignTaskTo(servers, heap, pin, taskLoad, opts)
+                      : assignTask(servers, heap, taskLoad, opts);
+}
+
+/* Queue a task that did not fit
+ * A full queue rejects the newcomer (ADMIT_REJECT) or sheds its oldest
+ * task to make room (ADMIT_SHED_OLDEST); a queue of capacity 0 rejects
+ * every such task.
+ * Returns 1 if the task was queued, 0 if it was rejected.
+ * Time Complexity: O(1)
+ */
+int offerPendingTask(AdmissionQueue* queue, const PendingTask* task,
+                     AdmissionPolicy policy) {
+    if (queue->count == queue->capacity) {
+        if (policy != ADMIT_SHED_OLDEST || queue->capacity == 0) {
+            queue->rejected++;
+            METRIC_ADD(METRIC_TASKS_REJECTED, 1);
+            return 0;
+        }
+        queue->head = (queue->head + 1) % queue->capacity;
+        queue->count--;
+        queue->shed++;
+        METRIC_ADD(METRIC_TASKS_SHED, 1);
+    }
+    
+    queue->slots[(queue->head + queue->count) % queue->capacity] = *task;
+    queue->count++;
+    queue->queued++;
+    if (queue->count > queue->maxDepth) {
+        queue->maxDepth = queue->count;
+    }
+    METRIC_ADD(METRIC_TASKS_QUEUED, 1);
+    METRIC_OBSERVE(HISTOGRAM_QUEUE_DEPTH, queue->count);
+    return 1;
+}
+
+/* Oldest pending task, or NULL if the queue is empty
+ * Time Complexity: O(1)
+ */
+const PendingTask* peekPendingTask(const AdmissionQueue* queue) {
+    return (queue->count > 0) ? &queue->slots[queue->head] : NULL;
+}
+
+/* Remove the oldest pending task after admitting it at time now
+ * Time Complexity: O(1)
+ */
+void popPendingTask(AdmissionQueue* queue, double now) {
+    double wait = now - queue->slots[queue->head].arrival;
+    queue->totalWait += wait;
+    queue->head = (queue->head + 1) % queue->capacity;
+    queue->count--;
+    if (queue->virtualTime) {
+        METRIC_OBSERVE(HISTOGRAM_QUEUE_WAIT_NS, llrint(wait * 1e9));
+    } else {
+        METRIC_OBSERVE(HISTOGRAM_QUEUE_WAIT_ARRIVALS, llrint(wait));
+    }
+}
+
+/* Add an admission queue's counters to stats (may be NULL)
+ * Time Complexity: O(1)
+ */
+static void addAdmissionStats(SimulationStats* stats, const AdmissionQueue* queue) {
+    if (stats == NULL) return;
+    stats->tasksQueued += queue->queued;
+    stats->tasksRejected += queue->rejected;
+    stats->tasksShed += queue->shed;
+    stats->tasksWaiting += queue->count;
+    if (queue->maxDepth > stats->maxQueueDepth) {
+        stats->maxQueueDepth = queue->maxDepth;
+    }
+    stats->queueWait += queue->totalWait;
+}
+
+/* Run one rebalancing pass with the engine selected by opts->rebalanceMode
+ * plan is required for REBALANCE_MULTI_PAIR, graph and search for
+ * REBALANCE_TOPOLOGY; otherwise the single-pair rebalanceLoads is used.
+ * With opts->hierarchy set, rebalanceHierarchy runs whatever the mode.
+ * Returns the amount of load migrated.
+ * Time Complexity: O(n) to O(n log n) depending on the mode
+ */
+float rebalancePass(ServerTable* servers, Graph* graph, MinHeap* heap,
+                    RebalancePlan* plan, HopSearch* search,
+                    const SimulationOptions* opts, double* hopCost) {
+    METRIC_CLOCK(start);
+    float migrated;
+    if (opts->hierarchy) {
+        migrated = rebalanceHierarchy(opts->hierarchy, servers, opts);
+    } else if (opts->rebalanceMode == REBALANCE_MULTI_PAIR && plan) {
+        migrated = rebalanceMultiPair(servers, heap, plan, opts);
+    } else if (opts->rebalanceMode == REBALANCE_TOPOLOGY && graph && search) {
+        migrated = rebalanceTopology(servers, graph, heap, search, opts, hopCost);
+    } else {
+        migrated = rebalanceLoads(servers, heap, opts);
+    }
+    
+    METRIC_ADD(METRIC_REBALANCE_CHECKS, 1);
+    METRIC_ADD(METRIC_REBALANCES, migrated > 0.0f);
+    METRIC_OBSERVE_SINCE(HISTOGRAM_REBALANCE_NS, start);
+    return migrated;
+}
+
+/* Simulate task assignment to servers
+ * Task loads come from opts->replay when set (at most numTasks of them;
+ * tasks with an affinity go straight to their server), otherwise from the
+ * thread's seeded stream. opts->capture records every arrival. Tables with
+ * vector loads get demand vectors (drawResourceDemand), placed one at a
+ * time by assignVectorTask; batchLoads then holds their totals.
+ * With opts->admission set (heap selection, scalar loads), a task that
+ * would take its server past opts->admissionLimit waits in a bounded
+ * AdmissionQueue, behind any earlier waiting task, and is admitted when
+ * departures make room; batches are then placed one task at a time.
+ * Counters are added to stats (may be NULL).
+ * Time Complexity: O(n log n) for n tasks
+ */
+void simulateTaskAssignment(ServerTable* servers, Graph* graph, MinHeap* heap, 
+                           int numTasks, const SimulationOptions* opts,
+                           SimulationStats* stats) {
+    if (opts->logLevel >= LOG_DEBUG) {
+        printf("\n--- Assigning %d Tasks Dynamically ---\n", numTasks);
+    }
+    
+    RebalancePlan* plan = NULL;
+    HopSearch* search = NULL;
+    if (opts->rebalanceMode == REBALANCE_MULTI_PAIR) {
+        plan = createRebalancePlan(servers->numServers);
+    } else if (opts->rebalanceMode == REBALANCE_TOPOLOGY && graph != NULL) {
+        search = createHopSearch(servers->numServers);
+    }
+    double hopCost = 0.0;
+    
+    // Task loads and d-choices samples share the thread's seeded stream
+    int useChoices = (opts->selectionPolicy == SELECT_D_CHOICES);
+    Rng* rng = threadRng();
+    
+    // Tasks arrive opts->batchSize at a time; heap batches go through assignBatch
+    int batchSize = (opts->batchSize > 1) ? opts->batchSize : 1;
+    float* batchLoads = (float*)malloc(batchSize * sizeof(float));
+    int* placements = (int*)malloc(batchSize * sizeof(int));
+    AdmissionQueue* admission = NULL;
+    if (opts->admission != ADMIT_ALL && !useChoices && !servers->resources) {
+        admission = createAdmissionQueue(opts->admissionQueue, 0);
+    }
+    BatchPlan* batchPlan = (batchSize > 1 && !useChoices && !servers->resources && !admission)
+                               ? createBatchPlan(batchSize) : NULL;
+    
+    // Vector loads: one demand vector per task of the batch
+    float* batchDemand = NULL;
+    if (servers->resources) {
+        batchDemand = (float*)malloc((size_t)batchSize * RESOURCE_DIMENSIONS * sizeof(float));
+    }
+    
+    // Replay: per-task affinities, and the unpinned part of mixed batches
+    int* batchPins = NULL;
+    float* freeLoads = NULL;
+    int* freeSlots = NULL;
+    int* freePlacements = NULL;
+    if (opts->replay) {
+        batchPins = (int*)malloc(batchSize * sizeof(int));
+        if (batchPlan) {
+            freeLoads = (float*)malloc(batchSize * sizeof(float));
+            freeSlots = (int*)malloc(batchSize * sizeof(int));
+            freePlacements = (int*)malloc(batchSize * sizeof(int));
+        }
+    }
+    
+    // Steady state: each task completes opts->taskLifetime arrivals after it
+    // started. Running task ids wait in a FIFO ring in start order, with the
+    // arrival number each one started at (later than its own once queued).
+    int lifetime = opts->taskLifetime;
+    TaskTable* running = NULL;
+    int* departures = NULL;
+    int* startedAt = NULL;
+    int ringSize = lifetime + batchSize + (admission ? admission->capacity : 0);
+    int ringHead = 0, ringCount = 0;
+    if (lifetime > 0) {
+        running = createTaskTable(ringSize, servers->numServers);
+        departures = (int*)malloc(ringSize * sizeof(int));
+        startedAt = (int*)malloc(ringSize * sizeof(int));
+    }
+    
+    for (int first = 1; first <= numTasks; first += batchSize) {
+        int count = (numTasks - first + 1 < batchSize) ? numTasks - first + 1 : batchSize;
+        
+        // Task loads: demand vectors, the next records of the trace, or random loads
+        int pinned = 0;
+        if (batchDemand) {
+            for (int i = 0; i < count; i++) {
+                batchLoads[i] = drawResourceDemand(rng, batchDemand + i * RESOURCE_DIMENSIONS);
+            }
+        } else if (opts->replay) {
+            count = readReplayBatch(opts->replay, batchLoads, batchPins, count,
+                                    servers->numServers, &pinned);
+            if (count == 0) {
+                break;
+            }
+        } else {
+            rngFillUniform(rng, batchLoads, count, MIN_TASK_LOAD, MAX_TASK_LOAD);
+        }
+        
+        if (opts->capture) {
+            double stamp = traceClock(opts->capture);
+            for (int i = 0; i < count; i++) {
+                appendTraceRecord(opts->capture, stamp, batchLoads[i],
+                                  pinned ? batchPins[i] : -1);
+            }
+        }
+        
+        if (batchDemand) {
+            for (int i = 0; i < count; i++) {
+                placements[i] = assignVectorTask(servers, heap,
+                                                 batchDemand + i * RESOURCE_DIMENSIONS);
+            }
+        } else if (admission) {
+            // Tasks that fit are placed; the rest wait behind any queued ones
+            for (int i = 0; i < count; i++) {
+                int pin = pinned ? batchPins[i] : -1;
+                placements[i] = (admission->count == 0)
+                    ? admitTask(servers, heap, batchLoads[i], pin, opts) : -1;
+                if (placements[i] >= 0) continue;
+                
+                PendingTask pending = {first + i, 0.0, batchLoads[i], first + i, pin};
+                int queued = offerPendingTask(admission, &pending, opts->admission);
+                if (opts->logLevel >= LOG_DEBUG) {
+                    printf("Task %2d %s | %d waiting\n", first + i,
+                           queued ? "queued  " : "rejected", admission->count);
+                }
+            }
+        } else if (useChoices) {
+            for (int i = 0; i < count; i++) {
+                placements[i] = (pinned && batchPins[i] >= 0)
+                    ? assignTaskTo(servers, heap, batchPins[i], batchLoads[i], opts)
+                    : dChoicesAssignTask(servers, batchLoads[i], opts->choices, rng);
+            }
+        } else if (batchPlan && pinned == 0) {
+            assignBatch(servers, heap, batchPlan, batchLoads, count, placements, opts);
+        } else if (batchPlan && pinned < count) {
+            // Pinned tasks go to their servers; the rest are packed as a batch
+            int numFree = 0;
+            for (int i = 0; i < count; i++) {
+                if (batchPins[i] >= 0) {
+                    placements[i] = assignTaskTo(servers, heap, batchPins[i],
+                                                 batchLoads[i], opts);
+                } else {
+                    freeLoads[numFree] = batchLoads[i];
+                    freeSlots[numFree++] = i;
+                }
+            }
+            assignBatch(servers, heap, batchPlan, freeLoads, numFree, freePlacements, opts);
+            for (int k = 0; k < numFree; k++) {
+                placements[freeSlots[k]] = freePlacements[k];
+            }
+        } else {
+            for (int i = 0; i < count; i++) {
+                placements[i] = (pinned && batchPins[i] >= 0)
+                    ? assignTaskTo(servers, heap, batchPins[i], batchLoads[i], opts)
+                    : assignTask(servers, heap, batchLoads[i], opts);
+            }
+        }
+        
+        // For batches, newLoad is the server's load after the whole batch
+        int last = first + count - 1;
+        int placed = 0;
+        for (int i = 0; i < count; i++) {
+            int task = first + i;
+            int serverId = placements[i];
+            if (serverId < 0) continue;   // Queued or rejected
+            float newLoad = servers->currentLoad[serverId];
+            placed++;
+            
+            if (opts->events) {
+                recordAssignment(opts->events, task, serverId, batchLoads[i], newLoad);
+            }
+            
+            if (opts->logLevel >= LOG_DEBUG) {
+                float percentage = getServerLoadPercentage(servers, serverId);
+                printf("Task %2d → Server %d | Load: %6.2f/%6.2f (%.1f%%)\n",
+                       task, serverId, newLoad,
+                       servers->capacity[serverId], percentage);
+            }
+            
+            if (running) {
+                int slot = (ringHead + ringCount++) % ringSize;
+                departures[slot] = trackTask(running, task, serverId, batchLoads[i]);
+                startedAt[slot] = task;
+            }
+        }
+        
+        // Complete every task that has run for lifetime arrivals
+        while (ringCount > 0 && startedAt[ringHead] <= last - lifetime) {
+            completeTask(servers, heap, running, departures[ringHead], opts);
+            ringHead = (ringHead + 1) % ringSize;
+            ringCount--;
+            if (stats) {
+                stats->tasksCompleted++;
+            }
+        }
+        
+        // Departures made room: admit waiting tasks in arrival order
+        const PendingTask* next;
+        while (admission && (next = peekPendingTask(admission)) != NULL) {
+            int serverId = admitTask(servers, heap, next->load, next->pin, opts);
+            if (serverId < 0) break;
+            float newLoad = servers->currentLoad[serverId];
+            placed++;
+            
+            if (opts->events) {
+                recordAssignment(opts->events, next->task, serverId, next->load, newLoad);
+            }
+            if (opts->logLevel >= LOG_DEBUG) {
+                printf("Task %2d → Server %d | Load: %6.2f/%6.2f (%.1f%%) after %d arrivals\n",
+                       next->task, serverId, newLoad, servers->capacity[serverId],
+                       getServerLoadPercentage(servers, serverId), last - next->task);
+            }
+            if (running) {
+                int slot = (ringHead + ringCount++) % ringSize;
+                departures[slot] = trackTask(running, next->task, serverId, next->load);
+                startedAt[slot] = last;
+            }
+            popPendingTask(admission, last);
+        }
+        
+        // Rebalance periodically: once per batch that crosses an interval boundary
+        float migrated = 0.0f;
+        if (last / opts->rebalanceInterval != (first - 1) / opts->rebalanceInterval) {
+            migrated = rebalancePass(servers, graph, heap, plan, search, opts,
+                                     &hopCost);
+        }
+        
+        if (stats) {
+            stats->tasksAssigned += placed;
+            if (migrated > 0.0f) {
+                stats->rebalances++;
+                stats->migratedLoad += migrated;
+            }
+        }
+    }
+    
+    if (stats) {
+        stats->migrationHopCost += hopCost;
+    }
+    if (admission) {
+        addAdmissionStats(stats, admission);
+        freeAdmissionQueue(admission);
+    }
+    free(batchLoads);
+    free(placements);
+    free(batchDemand);
+    free(batchPins);
+    free(freeLoads);
+    free(freeSlots);
+    free(freePlacements);
+    if (running) {
+        freeTaskTable(running);
+        free(departures);
+        free(startedAt);
+    }
+    if (batchPlan) {
+        freeBatchPlan(batchPlan);
+    }
+    if (plan) {
+        freeRebalancePlan(plan);
+    }
+    if (search) {
+        freeHopSearch(search);
+    }
+}
+
+/* ============================================================================
+ * SHARDED BALANCER
+ * ============================================================================ */
+
+/* Split the fleet into numShards contiguous shards, each with its own heap
+ * numShards is clamped to [1, numServers]. The balancer does not own
+ * servers. Keys follow opts->assignmentMode.
+ * Time Complexity: O(n log n)
+ */
+ShardedBalancer* createShardedBalancer(ServerTable* servers, int numShards,
+                                       const SimulationOptions* opts) {
+    int n = servers->numServers;
+    if (numShards < 1) numShards = 1;
+    if (numShards > n) numShards = n;
+    
+    ShardedBalancer* balancer = (ShardedBalancer*)malloc(sizeof(ShardedBalancer));
+    balancer->servers = servers;
+    balancer->numShards = numShards;
+    balancer->assignmentMode = opts->assignmentMode;
+    balancer->rebalanceThreshold = opts->rebalanceThreshold;
+    atomic_init(&balancer->running, 0);
+    balancer->periodUs = 0;
+    balancer->rebalances = 0;
+    balancer->migratedLoad = 0.0;
+    
+    // Shard array aligned to a cache line (sizeof(Shard) is a multiple of it)
+    balancer->block = malloc(numShards * sizeof(Shard) + CACHE_LINE_SIZE);
+    uintptr_t aligned = ((uintptr_t)balancer->block + CACHE_LINE_SIZE - 1) &
+                        ~(uintptr_t)(CACHE_LINE_SIZE - 1);
+    balancer->shards = (Shard*)aligned;
+    
+    int first = 0;
+    for (int s = 0; s < numShards; s++) {
+        Shard* shard = &balancer->shards[s];
+        int count = n / numShards + (s < n % numShards ? 1 : 0);
+        
+        pthread_mutex_init(&shard->lock, NULL);
+        shard->heap = createDaryHeap(count, HEAP_ARITY);
+        shard->firstServer = first;
+        shard->numServers = count;
+        shard->tasksAssigned = 0;
+        
+        float totalLoad = 0.0f, totalCapacity = 0.0f;
+        for (int i = 0; i < count; i++) {
+            insertHeap(shard->heap, i,
+                       serverHeapKey(servers, first + i, opts->assignmentMode));
+            totalLoad += servers->currentLoad[first + i];
+            totalCapacity += servers->capacity[first + i];
+        }
+        shard->totalLoad = totalLoad;
+        shard->invTotalCapacity = 1.0f / totalCapacity;
+        atomic_init(&shard->utilization, totalLoad / totalCapacity);
+        
+        first += count;
+    }
+    
+    return balancer;
+}
+
+/* Assign one task; safe to call from many threads at once
+ * Power-of-two-choices: the less utilized of two random shards (read
+ * without locking) takes the task at its heap root, under its lock.
+ * rng is the caller's per-thread generator.
+ * Returns the global ID of the chosen server.
+ * Time Complexity: O(log(n / shards)) plus lock hand-off
+ */
+int shardedAssignTask(ShardedBalancer* balancer, float taskLoad, Rng* rng) {
+    int s = 0;
+    if (balancer->numShards > 1) {
+        int a = (int)rngBelow(rng, (uint32_t)balancer->numShards);
+        int b = (int)rngBelow(rng, (uint32_t)(balancer->numShards - 1));
+        if (b >= a) b++;
+        float utilA = atomic_load_explicit(&balancer->shards[a].utilization,
+                                           memory_order_relaxed);
+        float utilB = atomic_load_explicit(&balancer->shards[b].utilization,
+                                           memory_order_relaxed);
+        s = (utilB < utilA) ? b : a;
+    }
+    
+    Shard* shard = &balancer->shards[s];
+    ServerTable* servers = balancer->servers;
+    
+    pthread_mutex_lock(&shard->lock);
+    int serverId = shard->firstServer + peekMin(shard->heap).serverId;
+    servers->currentLoad[serverId] += taskLoad;
+    publishLoadChange(servers, serverId, taskLoad, 1);
+    replaceTop(shard->heap, serverHeapKey(servers, serverId, balancer->assignmentMode));
+    shard->totalLoad += taskLoad;
+    shard->tasksAssigned++;
+    atomic_store_explicit(&shard->utilization,
+                          shard->totalLoad * shard->invTotalCapacity,
+                          memory_order_relaxed);
+    pthread_mutex_unlock(&shard->lock);
+    
+    METRIC_ADD(METRIC_TASKS_ASSIGNED, 1);
+    return serverId;
+}
+
+/* One cross-shard rebalancing pass
+ * If the shard utilization spread exceeds the threshold, the most loaded
+ * server of the hottest shard sends load to the root (least loaded) of the
+ * coolest shard: half its excess over the two shards' average load, capped
+ * so the receiver never ends up hotter than the donor. Both shard locks are
+ * taken in index order.
+ * Returns the amount of load migrated.
+ * Time Complexity: O(shards + n / shards)
+ */
+float rebalanceShards(ShardedBalancer* balancer) {
+    if (balancer->numShards < 2) {
+        return 0.0f;
+    }
+    METRIC_ADD(METRIC_REBALANCE_CHECKS, 1);
+    
+    int hot = 0, cold = 0;
+    float maxUtil = -INFINITY, minUtil = INFINITY;
+    for (int s = 0; s < balancer->numShards; s++) {
+        float util = atomic_load_explicit(&balancer->shards[s].utilization,
+                                          memory_order_relaxed);
+        if (util > maxUtil) {
+            maxUtil = util;
+            hot = s;
+        }
+        if (util < minUtil) {
+            minUtil = util;
+            cold = s;
+        }
+    }
+    if ((maxUtil - minUtil) * 100.0f <= balancer->rebalanceThreshold) {
+        return 0.0f;
+    }
+    
+    Shard* from = &balancer->shards[hot];
+    Shard* to = &balancer->shards[cold];
+    Shard* firstLock = (hot < cold) ? from : to;
+    Shard* secondLock = (hot < cold) ? to : from;
+    pthread_mutex_lock(&firstLock->lock);
+    pthread_mutex_lock(&secondLock->lock);
+    
+    ServerTable* servers = balancer->servers;
+    LoadScan scan = scanLoadArray(servers->currentLoad + from->firstServer,
+                                  from->numServers);
+    int donor = from->firstServer + scan.mostLoaded;
+    int receiver = to->firstServer + peekMin(to->heap).serverId;
+    
+    // Half the excess above the two shards' average, never past equal utilization
+    float avgLoad = (from->totalLoad + to->totalLoad) /
+                    (from->numServers + to->numServers);
+    float amount = (servers->currentLoad[donor] - avgLoad) * 0.5f;
+    float equalize = (servers->currentLoad[donor] * servers->capacity[receiver] -
+                      servers->currentLoad[receiver] * servers->capacity[donor]) /
+                     (servers->capacity[donor] + servers->capacity[receiver]);
+    if (amount > equalize) {
+        amount = equalize;
+    }
+    
+    if (amount > 0.0f) {
+        servers->currentLoad[donor] -= amount;
+        servers->currentLoad[receiver] += amount;
+        publishLoadChange(servers, donor, -amount, 0);
+        publishLoadChange(servers, receiver, amount, 0);
+        METRIC_MIGRATION(amount);
+        updateHeap(from->heap, donor - from->firstServer,
+                   serverHeapKey(servers, donor, balancer->assignmentMode));
+        updateHeap(to->heap, receiver - to->firstServer,
+                   serverHeapKey(servers, receiver, balancer->assignmentMode));
+        
+        from->totalLoad -= amount;
+        to->totalLoad += amount;
+        atomic_store_explicit(&from->utilization,
+                              from->totalLoad * from->invTotalCapacity,
+                              memory_order_relaxed);
+        atomic_store_explicit(&to->utilization,
+                              to->totalLoad * to->invTotalCapacity,
+                              memory_order_relaxed);
+    }
+    
+    pthread_mutex_unlock(&secondLock->lock);
+    pthread_mutex_unlock(&firstLock->lock);
+    
+    if (amount <= 0.0f) {
+        return 0.0f;
+    }
+    balancer->rebalances++;
+    balancer->migratedLoad += amount;
+    METRIC_ADD(METRIC_REBALANCES, 1);
+    return amount;
+}
+
+/* Background rebalancer: one pass every periodUs until stopped */
+static void* shardRebalancerThread(void* arg) {
+    ShardedBalancer* balancer = (ShardedBalancer*)arg;
+    struct timespec period;
+    period.tv_sec = balancer->periodUs / 1000000;
+    period.tv_nsec = (long)(balancer->periodUs % 1000000) * 1000;
+    
+    while (atomic_load(&balancer->running)) {
+        rebalanceShards(balancer);
+        nanosleep(&period, NULL);
+    }
+    return NULL;
+}
+
+/* Start the background rebalancing thread
+ * Returns 0 on success, -1 if it is already running or cannot start.
+ */
+int startShardRebalancer(ShardedBalancer* balancer, int periodUs) {
+    if (atomic_load(&balancer->running)) {
+        return -1;
+    }
+    balancer->periodUs = (periodUs > 0) ? periodUs : 1;
+    atomic_store(&balancer->running, 1);
+    if (pthread_create(&balancer->rebalancer, NULL, shardRebalancerThread,
+                       balancer) != 0) {
+        atomic_store(&balancer->running, 0);
+        printf("Cannot start shard rebalancer thread\n");
+        return -1;
+    }
+    return 0;
+}
+
+/* Stop and join the background rebalancing thread (no-op if not running) */
+void stopShardRebalancer(ShardedBalancer* balancer) {
+    if (atomic_exchange(&balancer->running, 0)) {
+        pthread_join(balancer->rebalancer, NULL);
+    }
+}
+
+/* Free balancer memory (stops the rebalancer; the ServerTable is kept)
+ * Time Complexity: O(shards)
+ */
+void freeShardedBalancer(ShardedBalancer* balancer) {
+    stopShardRebalancer(balancer);
+    for (int s = 0; s < balancer->numShards; s++) {
+        pthread_mutex_destroy(&balancer->shards[s].lock);
+        freeMinHeap(balancer->shards[s].heap);
+    }
+    free(balancer->block);
+    free(balancer);
+}
+
+/* Per-thread producer state for simulateSharded / simulateDChoices */
+typedef struct {
+    ShardedBalancer* balancer;  // Sharded heaps, or NULL for d-choices
+    ServerTable* servers;       // d-choices target table
+    int choices;                // d for d-choices
+    int numTasks;
+    Rng rng;
+    pthread_t thread;
+} TaskProducer;
+
+static void* taskProducerThread(void* arg) {
+    TaskProducer* producer = (TaskProducer*)arg;
+    for (int t = 0; t < producer->numTasks; t++) {
+        float taskLoad = rngRange(&producer->rng, MIN_TASK_LOAD, MAX_TASK_LOAD);
+        if (producer->balancer) {
+            shardedAssignTask(producer->balancer, taskLoad, &producer->rng);
+        } else {
+            dChoicesAssignTask(producer->servers, taskLoad, producer->choices,
+                               &producer->rng);
+        }
+    }
+    return NULL;
+}
+
+/* Split numTasks over numThreads producers, run them and wait for all
+ * Each producer gets its own stream split from the calling thread's
+ * generator, so a seeded run hands out the same streams. A share whose thread cannot be
+ * created runs on the calling thread. Returns the threads started.
+ */
+static int runTaskProducers(ShardedBalancer* balancer, ServerTable* servers,
+                            int choices, int numTasks, int numThreads) {
+    TaskProducer* producers = (TaskProducer*)malloc(numThreads * sizeof(TaskProducer));
+    
+    int started = 0;
+    for (int t = 0; t < numThreads; t++) {
+        producers[t].balancer = balancer;
+        producers[t].servers = servers;
+        producers[t].choices = choices;
+        producers[t].numTasks = numTasks / numThreads + (t < numTasks % numThreads ? 1 : 0);
+        producers[t].rng = splitRng(threadRng());
+        if (pthread_create(&producers[t].thread, NULL, taskProducerThread,
+                           &producers[t]) != 0) {
+            // Run this share on the calling thread instead
+            taskProducerThread(&producers[t]);
+            producers[t].numTasks = -1;
+        } else {
+            started++;
+        }
+    }
+    for (int t = 0; t < numThreads; t++) {
+        if (producers[t].numTasks >= 0) {
+            pthread_join(producers[t].thread, NULL);
+        }
+    }
+    
+    free(producers);
+    return started;
+}
+
+/* Seconds elapsed since start on the monotonic clock */
+static double secondsSince(const struct timespec* start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (double)(end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+/* Assign numTasks tasks from numThreads concurrent producers
+ * numShards = 0 uses SHARDS_PER_THREAD shards per producer. The background
+ * rebalancer runs every SHARD_REBALANCE_PERIOD_US while producers are
+ * active. Counters are added to stats (may be NULL).
+ * Returns the wall-clock seconds spent assigning.
+ * Time Complexity: O(numTasks * log(n / shards) / numThreads) wall clock
+ */
+double simulateSharded(ServerTable* servers, int numTasks, int numThreads,
+                       int numShards, const SimulationOptions* opts,
+                       SimulationStats* stats) {
+    if (numThreads < 1) numThreads = 1;
+    if (numShards < 1) numShards = numThreads * SHARDS_PER_THREAD;
+    
+    ShardedBalancer* balancer = createShardedBalancer(servers, numShards, opts);
+    
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    startShardRebalancer(balancer, SHARD_REBALANCE_PERIOD_US);
+    int started = runTaskProducers(balancer, servers, 0, numTasks, numThreads);
+    stopShardRebalancer(balancer);
+    double seconds = secondsSince(&start);
+    
+    if (opts->logLevel >= LOG_INFO) {
+        printf("\n--- Sharded Assignment: %d tasks, %d producer threads, %d shards ---\n",
+               numTasks, started, balancer->numShards);
+    }
+    if (stats) {
+        stats->tasksAssigned += numTasks;
+        stats->rebalances += (int)balancer->rebalances;
+        stats->migratedLoad += balancer->migratedLoad;
+    }
+    
+    freeShardedBalancer(balancer);
+    return seconds;
+}
+
+/* Assign numTasks tasks from numThreads producers with power-of-d-choices
+ * Lock-free: producers share only the atomically updated load column, and
+ * no rebalancing runs. Returns the wall-clock seconds spent assigning.
+ * Time Complexity: O(numTasks * d / numThreads) wall clock
+ */
+double simulateDChoices(ServerTable* servers, int numTasks, int numThreads,
+                        const SimulationOptions* opts, SimulationStats* stats) {
+    if (numThreads < 1) numThreads = 1;
+    
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int started = runTaskProducers(NULL, servers, opts->choices, numTasks, numThreads);
+    double seconds = secondsSince(&start);
+    
+    if (opts->logLevel >= LOG_INFO) {
+        printf("\n--- Power-of-%d-Choices Assignment: %d tasks, %d producer threads ---\n",
+               opts->choices, numTasks, started);
+    }
+    if (stats) {
+        stats->tasksAssigned += numTasks;
+    }
+    return seconds;
+}
+
+/* ============================================================================
+ * EVENT-DRIVEN SIMULATION
+ * ============================================================================ */
+
+#define EVENT_QUEUE_ARITY 4
+
+/* Workload from the #define defaults: Poisson arrivals, exponential service
+ * Time Complexity: O(1)
+ */
+WorkloadModel defaultWorkloadModel(void) {
+    WorkloadModel workload;
+    workload.arrivals = ARRIVAL_POISSON;
+    workload.arrivalRate = ARRIVAL_RATE;
+    workload.burstFactor = BURST_FACTOR;
+    workload.burstLength = BURST_LENGTH;
+    workload.service = SERVICE_EXPONENTIAL;
+    workload.serviceMean = SERVICE_MEAN;
+    workload.rebalancePeriod = REBALANCE_PERIOD;
+    workload.maxInFlight = MAX_IN_FLIGHT;
+    workload.tracePath[0] = '\0';
+    return workload;
+}
+
+/* Create an event queue holding up to capacity events
+ * Time Complexity: O(1)
+ */
+EventQueue* createEventQueue(int capacity) {
+    EventQueue* queue = (EventQueue*)malloc(sizeof(EventQueue));
+    
+    // Children of node i start at 4i + 1: align &events[1] to a cache line
+    queue->block = malloc(capacity * sizeof(TimedEvent) + CACHE_LINE_SIZE);
+    uintptr_t firstChild = (uintptr_t)queue->block + sizeof(TimedEvent);
+    uintptr_t aligned = (firstChild + CACHE_LINE_SIZE - 1) &
+                        ~(uintptr_t)(CACHE_LINE_SIZE - 1);
+    queue->events = (TimedEvent*)(aligned - sizeof(TimedEvent));
+    queue->size = 0;
+    queue->capacity = capacity;
+    return queue;
+}
+
+/* Free event queue memory
+ * Time Complexity: O(1)
+ */
+void freeEventQueue(EventQueue* queue) {
+    free(queue->block);
+    free(queue);
+}
+
+/* Schedule an event (the caller keeps size below capacity)
+ * Time Complexity: O(log n) - hole-based sift-up
+ */
+void pushTimedEvent(EventQueue* queue, double time, int type, int id) {
+    TimedEvent* events = queue->events;
+    int index = queue->size++;
+    
+    while (index > 0) {
+        int parent = (index - 1) / EVENT_QUEUE_ARITY;
+        if (events[parent].time <= time) break;
+        events[index] = events[parent];
+        index = parent;
+    }
+    events[index].time = time;
+    events[index].type = type;
+    events[index].id = id;
+}
+
+/* Sift event down from the root hole into its place */
+static void siftDownTimedEvent(EventQueue* queue, TimedEvent event) {
+    TimedEvent* events = queue->events;
+    int size = queue->size;
+    int index = 0;
+    
+    for (;;) {
+        int child = EVENT_QUEUE_ARITY * index + 1;
+        if (child >= size) break;
+        
+        // Earliest of up to EVENT_QUEUE_ARITY children (one cache line)
+        int best = child;
+        if (child + EVENT_QUEUE_ARITY <= size) {
+            int a = (events[child + 1].time < events[child].time) ? child + 1 : child;
+            int b = (events[child + 3].time < events[child + 2].time) ? child + 3 : child + 2;
+            best = (events[b].time < events[a].time) ? b : a;
+        } else {
+            for (int c = child + 1; c < size; c++) {
+                if (events[c].time < events[best].time) best = c;
+            }
+        }
+        
+        if (events[best].time >= event.time) break;
+        events[index] = events[best];
+        index = best;
+    }
+    events[index] = event;
+}
+
+/* Earliest event without removing it (queue must not be empty)
+ * Time Complexity: O(1)
+ */
+TimedEvent peekTimedEvent(const EventQueue* queue) {
+    return queue->events[0];
+}
+
+/* Remove and return the earliest event (queue must not be empty)
+ * Time Complexity: O(log n) - hole-based sift-down
+ */
+TimedEvent popTimedEvent(EventQueue* queue) {
+    TimedEvent first = queue->events[0];
+    TimedEvent last = queue->events[--queue->size];
+    if (queue->size > 0) {
+        siftDownTimedEvent(queue, last);
+    }
+    return first;
+}
+
+/* Replace the earliest event with a new one: pop + push in one sift
+ * Time Complexity: O(log n)
+ */
+void replaceTimedEvent(EventQueue* queue, double time, int type, int id) {
+    TimedEvent event;
+    event.time = time;
+    event.type = type;
+    event.id = id;
+    siftDownTimedEvent(queue, event);
+}
+
+/* Uniform double in (0, 1], safe to take the log of */
+static inline double uniformOpen(Rng* rng) {
+    return 1.0 - rngUniform(rng);
+}
+
+/* Exponential sample with the given mean */
+static inline double sampleExponential(Rng* rng, double mean) {
+    return -log(uniformOpen(rng)) * mean;
+}
+
+/* Arrival Source: State of the arrival process between arrivals */
+typedef struct {
+    const WorkloadModel* workload;
+    FILE* trace;
+    int inBurst;
+    double spellEnd;            // Bursty: when the current burst/idle spell ends
+    double burstRate, idleRate;
+    int traceLine;
+    TraceReader* replay;        // Binary trace, replaces workload->arrivals
+    int numServers;             // Replay: affinities at or above become -1
+} ArrivalSource;
+
+/* Next arrival after now: sets *time, *taskLoad, *service and *pin (the
+ * server a replayed task must run on, -1 = any)
+ * Returns 0, 1 when a trace is exhausted, or -1 (with a message giving the
+ * line or record) when it is malformed.
+ */
+static int nextArrival(ArrivalSource* source, Rng* rng, double now,
+                       double* time, float* taskLoad, double* service, int* pin) {
+    const WorkloadModel* workload = source->workload;
+    *pin = -1;
+    
+    if (source->replay) {
+        // Binary traces carry no service times: those come from the model
+        int count;
+        const TraceRecord* record = nextTraceRecords(source->replay, 1, &count);
+        if (record == NULL) {
+            return 1;
+        }
+        if (!(record->time >= now) || !(record->load >= 0.0f) || !isfinite(record->load)) {
+            printf("%s: record %lld: expected non-decreasing times and valid loads\n",
+                   source->replay->path, source->replay->nextRecord - 1);
+            return -1;
+        }
+        *time = record->time;
+        *taskLoad = record->load;
+        if (record->affinity >= 0 && record->affinity < source->numServers) {
+            *pin = record->affinity;
+        }
+        *service = (workload->service == SERVICE_FIXED)
+                       ? workload->serviceMean
+                       : sampleExponential(rng, workload->serviceMean);
+        return 0;
+    }
+    
+    if (workload->arrivals == ARRIVAL_TRACE) {
+        char line[256];
+        while (fgets(line, sizeof(line), source->trace) != NULL) {
+            source->traceLine++;
+            char* text = line;
+            while (*text == ' ' || *text == '\t') text++;
+            if (*text == '#' || *text == '\n' || *text == '\r' || *text == '\0') continue;
+            
+            double loadValue;
+            if (sscanf(text, "%lf %lf %lf", time, &loadValue, service) != 3 ||
+                *time < now || loadValue < 0.0 || *service < 0.0) {
+                printf("%s:%d: expected non-decreasing \"time load service\"\n",
+                       workload->tracePath, source->traceLine);
+                return -1;
+            }
+            *taskLoad = (float)loadValue;
+            return 0;
+        }
+        return 1;
+    }
+    
+    double t = now;
+    if (workload->arrivals == ARRIVAL_BURSTY) {
+        // Memoryless: redraw the gap from the spell boundary when it ends first
+        for (;;) {
+            double rate = source->inBurst ? source->burstRate : source->idleRate;
+            double next = t + sampleExponential(rng, 1.0 / rate);
+            if (next <= source->spellEnd) {
+                t = next;
+                break;
+            }
+            t = source->spellEnd;
+            source->inBurst = !source->inBurst;
+            source->spellEnd = t + sampleExponential(rng, workload->burstLength);
+        }
+    } else {
+        t += sampleExponential(rng, 1.0 / workload->arrivalRate);
+    }
+    
+    *time = t;
+    *taskLoad = rngRange(rng, MIN_TASK_LOAD, MAX_TASK_LOAD);
+    *service = (workload->service == SERVICE_FIXED)
+                   ? workload->serviceMean
+                   : sampleExponential(rng, workload->serviceMean);
+    return 0;
+}
+
+/* Run the discrete-event engine for numTasks arrivals
+ * Arrivals, departures and periodic rebalance passes are events in one
+ * time-ordered queue; each task holds its load from arrival until its
+ * service time has elapsed (completeTask). Rebalancing runs every
+ * workload->rebalancePeriod virtual seconds instead of every N tasks.
+ * Selection follows opts (heap or d-choices). Arrivals that find all
+ * workload->maxInFlight task slots busy are dropped and counted.
+ * opts->replay, when set, supplies arrival times, loads and affinities in
+ * place of workload->arrivals; opts->capture records every arrival.
+ * With opts->admission set (heap selection), arrivals that do not fit
+ * wait in an AdmissionQueue and are admitted as departures make room;
+ * their service time starts at admission.
+ * Returns the virtual time of the last event, or -1 if the trace cannot
+ * be opened or has a malformed line (arrivals stop there).
+ * Time Complexity: O(E (log F + log n)) for E events and F tasks in flight,
+ * plus O(n) to O(n log n) per rebalance pass
+ */
+double simulateEventDriven(ServerTable* servers, Graph* graph, MinHeap* heap,
+                           int numTasks, const WorkloadModel* workload,
+                           const SimulationOptions* opts, SimulationStats* stats) {
+    ArrivalSource source = {workload, NULL, 0, 0.0, 0.0, 0.0, 0, opts->replay,
+                            servers->numServers};
+    if (workload->arrivals == ARRIVAL_TRACE && source.replay == NULL) {
+        source.trace = fopen(workload->tracePath, "r");
+        if (source.trace == NULL) {
+            printf("Cannot open trace file '%s'\n", workload->tracePath);
+            return -1.0;
+        }
+    }
+    
+    // The thread's seeded stream, so --seed reproduces the whole run
+    Rng* rng = threadRng();
+    if (workload->arrivals == ARRIVAL_BURSTY && source.replay == NULL) {
+        // Burst and idle rates b:1 with equal mean spells keep the mean rate
+        source.idleRate = 2.0 * workload->arrivalRate / (workload->burstFactor + 1.0);
+        source.burstRate = workload->burstFactor * source.idleRate;
+        source.spellEnd = sampleExponential(rng, workload->burstLength);
+    }
+    
+    if (opts->logLevel >= LOG_DEBUG) {
+        printf("\n--- Event-Driven Simulation: %d Arrivals ---\n", numTasks);
+    }
+    
+    RebalancePlan* plan = NULL;
+    HopSearch* search = NULL;
+    if (opts->rebalanceMode == REBALANCE_MULTI_PAIR) {
+        plan = createRebalancePlan(servers->numServers);
+    } else if (opts->rebalanceMode == REBALANCE_TOPOLOGY && graph != NULL) {
+        search = createHopSearch(servers->numServers);
+    }
+    double hopCost = 0.0;
+    int useChoices = (opts->selectionPolicy == SELECT_D_CHOICES);
+    
+    TaskTable* running = createTaskTable(workload->maxInFlight,
+                                 servers->numServers);
+    EventQueue* queue = createEventQueue(workload->maxInFlight + 2);
+    AdmissionQueue* admission = (opts->admission != ADMIT_ALL && !useChoices)
+                                    ? createAdmissionQueue(opts->admissionQueue, 1) : NULL;
+    
+    // Pending arrival: generated one ahead so it can sit in the queue
+    double arrivalTime;
+    float arrivalLoad = 0.0f;
+    double arrivalService = 0.0;
+    int arrivalPin = -1;
+    int arrivals = 0;
+    int malformed = 0;
+    int more = (numTasks > 0) ? nextArrival(&source, rng, 0.0, &arrivalTime, &arrivalLoad,
+                                            &arrivalService, &arrivalPin) : 1;
+    if (more == 0) {
+        pushTimedEvent(queue, arrivalTime, TIMED_ARRIVAL, -1);
+    } else {
+        numTasks = 0;
+        malformed = (more < 0);
+    }
+    if (workload->rebalancePeriod > 0.0) {
+        pushTimedEvent(queue, workload->rebalancePeriod, TIMED_REBALANCE, -1);
+    }
+    
+    double now = 0.0;
+    long long processed = 0;
+    int placed = 0, completed = 0, dropped = 0, rebalances = 0;
+    double migratedLoad = 0.0;
+    
+    // Stop once every arrival has departed; a lone rebalance tick is not work
+    // Each event either pops itself or is replaced by its successor in place
+    while (queue->size > 0 && (arrivals < numTasks || running->numActive > 0)) {
+        TimedEvent event = peekTimedEvent(queue);
+        now = event.time;
+        processed++;
+        
+        if (event.type == TIMED_ARRIVAL) {
+            int task = ++arrivals;
+            if (opts->capture) {
+                appendTraceRecord(opts->capture, now, arrivalLoad, arrivalPin);
+            }
+            int serverId = -1;
+            if (running->numActive < running->capacity) {
+                if (admission) {
+                    // Arrivals wait behind queued tasks even if they would fit
+                    serverId = (admission->count == 0)
+                        ? admitTask(servers, heap, arrivalLoad, arrivalPin, opts) : -1;
+                } else {
+                    serverId = (arrivalPin >= 0)
+                        ? assignTaskTo(servers, heap, arrivalPin, arrivalLoad, opts)
+                        : useChoices
+                        ? dChoicesAssignTask(servers, arrivalLoad, opts->choices, rng)
+                        : assignTask(servers, heap, arrivalLoad, opts);
+                }
+            }
+            if (serverId >= 0) {
+                float newLoad = servers->currentLoad[serverId];
+                int id = trackTask(running, task, serverId, arrivalLoad);
+                replaceTimedEvent(queue, now + arrivalService, TIMED_DEPARTURE, id);
+                
+                if (opts->events) {
+                    recordAssignment(opts->events, task, serverId, arrivalLoad, newLoad);
+                }
+                if (opts->logLevel >= LOG_DEBUG) {
+                    printf("t=%.4f Task %2d → Server %d | Load: %6.2f/%6.2f (%.1f%%)\n",
+                           now, task, serverId, newLoad, servers->capacity[serverId],
+                           getServerLoadPercentage(servers, serverId));
+                }
+                placed++;
+            } else if (running->numActive < running->capacity) {
+                popTimedEvent(queue);
+                PendingTask pending = {now, arrivalService, arrivalLoad, task, arrivalPin};
+                int queued = offerPendingTask(admission, &pending, opts->admission);
+                if (opts->logLevel >= LOG_DEBUG) {
+                    printf("t=%.4f Task %2d %s | %d waiting\n", now, task,
+                           queued ? "queued  " : "rejected", admission->count);
+                }
+            } else {
+                popTimedEvent(queue);
+                dropped++;
+            }
+            
+            more = (arrivals < numTasks)
+                       ? nextArrival(&source, rng, now, &arrivalTime, &arrivalLoad,
+                                     &arrivalService, &arrivalPin) : 1;
+            if (more == 0) {
+                pushTimedEvent(queue, arrivalTime, TIMED_ARRIVAL, -1);
+            } else {
+                numTasks = arrivals;    // Trace exhausted: no more arrivals
+                malformed |= (more < 0);
+            }
+        } else if (event.type == TIMED_DEPARTURE) {
+            popTimedEvent(queue);
+            completeTask(servers, heap, running, event.id, opts);
+            completed++;
+            
+            // The departure made room: admit waiting tasks in arrival order
+            const PendingTask* next;
+            while (admission && running->numActive < running->capacity &&
+                   (next = peekPendingTask(admission)) != NULL) {
+                int serverId = admitTask(servers, heap, next->load, next->pin, opts);
+                if (serverId < 0) break;
+                float newLoad = servers->currentLoad[serverId];
+                int id = trackTask(running, next->task, serverId, next->load);
+                pushTimedEvent(queue, now + next->service, TIMED_DEPARTURE, id);
+                placed++;
+                
+                if (opts->events) {
+                    recordAssignment(opts->events, next->task, serverId, next->load, newLoad);
+                }
+                if (opts->logLevel >= LOG_DEBUG) {
+                    printf("t=%.4f Task %2d → Server %d | Load: %6.2f/%6.2f (%.1f%%) "
+                           "after %.4f s\n", now, next->task, serverId, newLoad,
+                           servers->capacity[serverId],
+                           getServerLoadPercentage(servers, serverId), now - next->arrival);
+                }
+                popPendingTask(admission, now);
+            }
+        } else {
+            float migrated = rebalancePass(servers, graph, heap, plan, search, opts,
+                                           &hopCost);
+            if (migrated > 0.0f) {
+                rebalances++;
+                migratedLoad += migrated;
+            }
+            
+            // Stop rebalancing once arrivals end: draining servers just empty
+            if (arrivals < numTasks) {
+                replaceTimedEvent(queue, now + workload->rebalancePeriod,
+                                  TIMED_REBALANCE, -1);
+            } else {
+                popTimedEvent(queue);
+            }
+        }
+    }
+    
+    if (stats) {
+        stats->tasksAssigned += placed;
+        stats->tasksCompleted += completed;
+        stats->tasksDropped += dropped;
+        stats->rebalances += rebalances;
+        stats->migratedLoad += migratedLoad;
+        stats->migrationHopCost += hopCost;
+        stats->eventsProcessed += processed;
+        stats->virtualTime = now;
+    }
+    
+    if (admission) {
+        addAdmissionStats(stats, admission);
+        freeAdmissionQueue(admission);
+    }
+    freeEventQueue(queue);
+    freeTaskTable(running);
+    if (plan) {
+        freeRebalancePlan(plan);
+    }
+    if (search) {
+        freeHopSearch(search);
+    }
+    if (source.trace) {
+        fclose(source.trace);
+    }
+    return malformed ? -1.0 : now;
+}
+
+/* ============================================================================
+ * BALANCER INSTANCE
+ * ============================================================================ */
+
+/* Build one balancer: server capacities and the random topology are drawn
+ * from the calling thread's Rng (seed it first), then every server enters
+ * a heap of the given arity keyed by mode.
+ * useArena places the table, graph and heap in one Arena sized for the
+ * fleet; trackImbalance attaches an ImbalanceTracker. resourceWeights
+ * (NULL = scalar loads) attaches a ResourceTable with those dimension
+ * weights and draws one capacity per dimension.
+ * Time Complexity: O(n log n)
+ */
+BalancerInstance* createBalancerInstance(int numServers, int arity, AssignmentMode mode,
+                                         int useArena, int trackImbalance,
+                                         const float* resourceWeights) {
+    BalancerInstance* instance = (BalancerInstance*)malloc(sizeof(BalancerInstance));
+    instance->arena = useArena ? createArena(instanceArenaBytes(numServers)) : NULL;
+    
+    ServerTable* servers = createServerTableIn(instance->arena, numServers);
+    instance->resources = NULL;
+    if (resourceWeights) {
+        instance->resources = createResourceTableIn(instance->arena, numServers,
+                                                    resourceWeights);
+        attachResourceTable(servers, instance->resources);
+    }
+    for (int i = 0; i < numServers; i++) {
+        if (instance->resources) {
+            float capacity[RESOURCE_DIMENSIONS];
+            for (int d = 0; d < RESOURCE_DIMENSIONS; d++) {
+                capacity[d] = rngRange(threadRng(), MIN_CAPACITY, MAX_CAPACITY);
+            }
+            setResourceCapacity(servers, i, capacity);
+        } else {
+            setServerCapacity(servers, i, rngRange(threadRng(), MIN_CAPACITY, MAX_CAPACITY));
+        }
+    }
+    instance->servers = servers;
+    instance->graph = generateRandomTopologyIn(instance->arena, numServers);
+    
+    instance->heap = createDaryHeapIn(instance->arena, numServers, arity);
+    for (int i = 0; i < numServers; i++) {
+        insertHeap(instance->heap, i, serverHeapKey(servers, i, mode));
+    }
+    
+    instance->tracker = NULL;
+    if (trackImbalance) {
+        instance->tracker = createImbalanceTracker(numServers);
+        attachImbalanceTracker(servers, instance->tracker);
+    }
+    return instance;
+}
+
+/* Free every part of an instance (the whole arena at once if it has one)
+ * Time Complexity: O(1) with an arena, O(n) otherwise
+ */
+void freeBalancerInstance(BalancerInstance* instance) {
+    freeMinHeap(instance->heap);
+    freeGraph(instance->graph);
+    freeServerTable(instance->servers);
+    if (instance->resources) {
+        freeResourceTable(instance->resources);
+    }
+    if (instance->arena) {
+        freeArena(instance->arena);
+    }
+    if (instance->tracker) {
+        freeImbalanceTracker(instance->tracker);
+    }
+    free(instance);
+}
+
 /* ============================================================================
- * GRAPH FUNCTIONS
+ * SNAPSHOT AND RESTORE
  * ============================================================================ */
 
-/* Create a graph with numServers nodes
- * Time Complexity: O(n)
+/* Byte offset and length of every snapshot section for the header's counts
+ * offsets[SNAPSHOT_SECTIONS] receives the file size.
+ * Time Complexity: O(1)
  */
-Graph* createGraph(int numServers) {
-    Graph* graph = (Graph*)malloc(sizeof(Graph));
-    graph->numServers = numServers;
-    
-    // Allocate adjacency list
-    graph->adjList = (Node**)malloc(numServers * sizeof(Node*));
-    
-    // Initialize all lists to NULL
-    for (int i = 0; i < numServers; i++) {
-        graph->adjList[i] = NULL;
+static void snapshotLayout(const SnapshotHeader* header,
+                           uint64_t offsets[SNAPSHOT_SECTIONS + 1],
+                           uint64_t sizes[SNAPSHOT_SECTIONS]) {
+    uint64_t n = header->numServers;
+    sizes[0] = n * sizeof(float);
+    sizes[1] = n * sizeof(float);
+    sizes[2] = (uint64_t)header->heapSize * sizeof(HeapNode);
+    sizes[3] = (n + 1) * sizeof(int32_t);
+    sizes[4] = (uint64_t)header->numEdges * sizeof(int32_t);
+    uint64_t at = sizeof(SnapshotHeader);
+    for (int k = 0; k < SNAPSHOT_SECTIONS; k++) {
+        offsets[k] = at;
+        at = (at + sizes[k] + CACHE_LINE_SIZE - 1) & ~(uint64_t)(CACHE_LINE_SIZE - 1);
     }
-    
-    return graph;
+    offsets[SNAPSHOT_SECTIONS] = at;
 }
 
-/* Add a directed edge from src to dest in the graph
- * Time Complexity: O(1)
+/* Write the server table, heap array and CSR graph to a snapshot file
+ * mode is the assignment mode the heap keys were computed for; a restore
+ * under the same mode and arity copies the heap as is. The graph must
+ * have no pending edges (buildGraphCSR). Resource vectors and running
+ * tasks are not saved.
+ * Returns 0 on success, -1 on error.
+ * Time Complexity: O(n + E)
  */
-void addEdge(Graph* graph, int src, int dest) {
-    // Create new node for adjacency list
-    Node* newNode = (Node*)malloc(sizeof(Node));
-    newNode->serverId = dest;
-    newNode->next = graph->adjList[src];
-    graph->adjList[src] = newNode;
+int saveSnapshot(const char* path, const ServerTable* servers, const MinHeap* heap,
+                 const Graph* graph, AssignmentMode mode) {
+    if (graph->numPending > 0 || graph->numServers != servers->numServers) {
+        printf("Snapshot needs a built graph of the same fleet\n");
+        return -1;
+    }
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        printf("Cannot open snapshot file '%s'\n", path);
+        return -1;
+    }
+    
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "LBSNAP01", 8);
+    header.headerBytes = sizeof(SnapshotHeader);
+    header.numServers = (uint32_t)servers->numServers;
+    header.numEdges = (uint32_t)graph->numEdges;
+    header.heapSize = (uint32_t)heap->size;
+    header.heapArity = (uint32_t)heap->arity;
+    header.assignmentMode = (uint32_t)mode;
+    uint64_t offsets[SNAPSHOT_SECTIONS + 1], sizes[SNAPSHOT_SECTIONS];
+    snapshotLayout(&header, offsets, sizes);
+    header.fileBytes = offsets[SNAPSHOT_SECTIONS];
+    
+    const void* sections[SNAPSHOT_SECTIONS] = {
+        servers->capacity, servers->currentLoad, heap->arr, graph->offsets, graph->neighbors
+    };
+    static const char padding[CACHE_LINE_SIZE];
+    fwrite(&header, sizeof(header), 1, file);
+    for (int k = 0; k < SNAPSHOT_SECTIONS; k++) {
+        if (sizes[k] > 0) {
+            fwrite(sections[k], 1, sizes[k], file);
+        }
+        fwrite(padding, 1, offsets[k + 1] - offsets[k] - sizes[k], file);
+    }
+    
+    int failed = ferror(file);
+    if (fclose(file) != 0 || failed) {
+        printf("Cannot write snapshot file '%s'\n", path);
+        return -1;
+    }
+    return 0;
 }
 
-/* Print the graph structure for debugging
- * Time Complexity: O(V + E)
+/* Check that a mapped heap array holds every server once, in heap order,
+ * with keys matching the restored loads, filling pos on the way
+ * pos and the loads are visited in heap order, i.e. at random; prefetching
+ * SNAPSHOT_PREFETCH nodes ahead roughly halves the time at 10^6 servers.
+ * Time Complexity: O(n)
  */
-void printGraph(Graph* graph) {
-    printf("\n--- Server Network Topology ---\n");
-    for (int i = 0; i < graph->numServers; i++) {
-        printf("Server %d → ", i);
-        Node* current = graph->adjList[i];
-        while (current != NULL) {
-            printf("%d ", current->serverId);
-            current = current->next;
+static int snapshotHeapValid(const HeapNode* nodes, int size, int arity,
+                             const ServerTable* servers, AssignmentMode mode,
+                             int* pos) {
+    int n = servers->numServers;
+    if (size != n) {
+        return 0;
+    }
+    memset(pos, 0xff, n * sizeof(int));
+    for (int i = 0; i < size; i++) {
+        if (i + SNAPSHOT_PREFETCH < size) {
+            unsigned int ahead = (unsigned int)nodes[i + SNAPSHOT_PREFETCH].serverId;
+            if (ahead < (unsigned int)n) {
+                __builtin_prefetch(&pos[ahead], 1);
+                __builtin_prefetch(&servers->currentLoad[ahead], 0);
+            }
+        }
+        int id = nodes[i].serverId;
+        if (id < 0 || id >= n || pos[id] >= 0) {
+            return 0;
+        }
+        pos[id] = i;
+        if (nodes[i].load != serverHeapKey(servers, id, mode)) {
+            return 0;
+        }
+        if (i > 0 && nodes[(i - 1) / arity].load > nodes[i].load) {
+            return 0;
         }
-        printf("\n");
     }
+    return 1;
 }
 
-/* Free graph memory
- * Time Complexity: O(V + E)
+/* Rebuild a balancer instance from a snapshot file
+ * The file is mapped read-only, validated and copied into a fresh
+ * instance (in its own Arena with useArena). The heap array is copied
+ * directly when the snapshot was taken with this arity and mode and is
+ * consistent with the loads; otherwise it is rebuilt with Floyd's buildHeap.
+ * *heapCopied (may be NULL) tells which happened.
+ * Returns NULL if the file cannot be read or is not a valid snapshot.
+ * Time Complexity: O(n + E)
  */
-void freeGraph(Graph* graph) {
-    for (int i = 0; i < graph->numServers; i++) {
-        Node* current = graph->adjList[i];
-        while (current != NULL) {
-            Node* temp = current;
-            current = current->next;
-            free(temp);
+BalancerInstance* restoreBalancerInstance(const char* path, int arity, AssignmentMode mode,
+                                          int useArena, int trackImbalance,
+                                          int* heapCopied) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        printf("Cannot open snapshot file '%s'\n", path);
+        return NULL;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(SnapshotHeader)) {
+        printf("'%s' is not a balancer snapshot\n", path);
+        close(fd);
+        return NULL;
+    }
+    size_t bytes = (size_t)info.st_size;
+    void* map = mmap(NULL, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        printf("Cannot map snapshot file '%s'\n", path);
+        return NULL;
+    }
+    posix_madvise(map, bytes, POSIX_MADV_SEQUENTIAL);
+    
+    // Header, layout and CSR structure must all check out before any copy
+    const SnapshotHeader* header = (const SnapshotHeader*)map;
+    const unsigned char* base = (const unsigned char*)map;
+    uint64_t offsets[SNAPSHOT_SECTIONS + 1], sizes[SNAPSHOT_SECTIONS];
+    snapshotLayout(header, offsets, sizes);
+    int n = (int)header->numServers;
+    int valid = memcmp(header->magic, "LBSNAP01", 8) == 0 &&
+                header->headerBytes == sizeof(SnapshotHeader) &&
+                header->numServers >= 1 && header->numServers <= 100000000u &&
+                header->heapSize <= header->numServers &&
+                header->fileBytes == bytes && offsets[SNAPSHOT_SECTIONS] == bytes;
+    const float* capacity = valid ? (const float*)(base + offsets[0]) : NULL;
+    const float* load = valid ? (const float*)(base + offsets[1]) : NULL;
+    const HeapNode* nodes = valid ? (const HeapNode*)(base + offsets[2]) : NULL;
+    const int32_t* rowOffsets = valid ? (const int32_t*)(base + offsets[3]) : NULL;
+    const int32_t* neighbors = valid ? (const int32_t*)(base + offsets[4]) : NULL;
+    if (valid) {
+        valid = rowOffsets[0] == 0 && rowOffsets[n] == (int32_t)header->numEdges;
+        for (int u = 0; valid && u < n; u++) {
+            valid = rowOffsets[u] <= rowOffsets[u + 1] &&
+                    capacity[u] > 0.0f && isfinite(capacity[u]) &&
+                    load[u] >= 0.0f && isfinite(load[u]);
+        }
+        for (uint32_t e = 0; valid && e < header->numEdges; e++) {
+            valid = neighbors[e] >= 0 && neighbors[e] < n;
         }
     }
-    free(graph->adjList);
-    free(graph);
+    if (!valid) {
+        printf("'%s' is not a valid balancer snapshot\n", path);
+        munmap(map, bytes);
+        return NULL;
+    }
+    
+    BalancerInstance* instance = (BalancerInstance*)malloc(sizeof(BalancerInstance));
+    instance->arena = useArena ? createArena(instanceArenaBytes(n)) : NULL;
+    instance->resources = NULL;
+    
+    ServerTable* servers = createServerTableIn(instance->arena, n);
+    for (int i = 0; i < n; i++) {
+        setServerCapacity(servers, i, capacity[i]);
+    }
+    memcpy(servers->currentLoad, load, n * sizeof(float));
+    instance->servers = servers;
+    
+    Graph* graph = createGraphIn(instance->arena, n);
+    memcpy(graph->offsets, rowOffsets, (n + 1) * sizeof(int));
+    graph->numEdges = (int)header->numEdges;
+    graph->neighbors = (int*)lbAlloc(instance->arena, (graph->numEdges + 1) * sizeof(int));
+    memcpy(graph->neighbors, neighbors, graph->numEdges * sizeof(int));
+    instance->graph = graph;
+    
+    // Heap: the saved array when it fits this run, else a Floyd rebuild
+    // (which rewrites the pos the validator filled)
+    MinHeap* heap = createDaryHeapIn(instance->arena, n, arity);
+    int copy = (int)header->heapArity == heap->arity && header->assignmentMode == (uint32_t)mode &&
+               snapshotHeapValid(nodes, (int)header->heapSize, heap->arity, servers, mode,
+                                 heap->pos);
+    if (copy) {
+        memcpy(heap->arr, nodes, n * sizeof(HeapNode));
+        heap->size = n;
+    } else {
+        float* keys = (float*)malloc(n * sizeof(float));
+        for (int i = 0; i < n; i++) {
+            keys[i] = serverHeapKey(servers, i, mode);
+        }
+        buildHeap(heap, keys, n);
+        free(keys);
+    }
+    instance->heap = heap;
+    munmap(map, bytes);
+    
+    instance->tracker = NULL;
+    if (trackImbalance) {
+        instance->tracker = createImbalanceTracker(n);
+        attachImbalanceTracker(servers, instance->tracker);
+    }
+    if (heapCopied) {
+        *heapCopied = copy;
+    }
+    return instance;
 }
 
 /* ============================================================================
- * MIN HEAP FUNCTIONS
+ * LIBRARY API
  * ============================================================================ */
 
-/* Create a min heap with given capacity
- * Time Complexity: O(n)
+/* Defaults of the demo: binary heap, absolute load, single-pair passes
+ * Time Complexity: O(1)
  */
-MinHeap* createMinHeap(int capacity) {
-    MinHeap* heap = (MinHeap*)malloc(sizeof(MinHeap));
-    heap->arr = (HeapNode*)malloc(capacity * sizeof(HeapNode));
-    heap->size = 0;
-    heap->capacity = capacity;
-    return heap;
+LB_API LoadBalancerConfig defaultLoadBalancerConfig(void) {
+    LoadBalancerConfig config;
+    config.numServers = DEFAULT_NUM_SERVERS;
+    config.heapArity = HEAP_ARITY;
+    config.assignmentMode = ASSIGNMENT_MODE;
+    config.rebalanceMode = REBALANCE_MODE;
+    config.rebalanceThreshold = REBALANCE_THRESHOLD;
+    config.rebalanceInterval = REBALANCE_INTERVAL;
+    config.maxMigrationHops = MAX_MIGRATION_HOPS;
+    config.maxTasks = MAX_IN_FLIGHT;
+    config.trackImbalance = 0;
+    config.logLevel = LOG_QUIET;
+    config.useArena = 0;
+    config.resourceWeights = NULL;
+    config.eventPath = NULL;
+    config.eventFormat = EVENT_FORMAT_CSV;
+    return config;
 }
 
-/* Swap two heap nodes
- * Time Complexity: O(1)
+/* Check the settings both constructors take from a config
+ * Returns 1 if usable, 0 (with a message) otherwise.
  */
-void swap(HeapNode* a, HeapNode* b) {
-    HeapNode temp = *a;
-    *a = *b;
-    *b = temp;
+static int validLoadBalancerConfig(const LoadBalancerConfig* config) {
+    const char* problem = NULL;
+    if (config->heapArity != 2 && config->heapArity != 4 && config->heapArity != 8) {
+        problem = "heap arity must be 2, 4 or 8";
+    } else if (config->assignmentMode < ASSIGN_BY_LOAD ||
+               config->assignmentMode > ASSIGN_BY_DOMINANT_SHARE) {
+        problem = "unknown assignment mode";
+    } else if (config->rebalanceMode < REBALANCE_SINGLE_PAIR ||
+               config->rebalanceMode > REBALANCE_TOPOLOGY) {
+        problem = "unknown rebalance mode";
+    } else if (!(config->rebalanceThreshold >= 0.0f)) {
+        problem = "rebalance threshold must not be negative";
+    } else if (config->rebalanceInterval < 0 || config->maxTasks < 0 ||
+               config->maxMigrationHops < 1) {
+        problem = "negative interval or task count, or hops below 1";
+    } else if (config->resourceWeights &&
+               (config->assignmentMode != ASSIGN_BY_DOMINANT_SHARE ||
+                config->rebalanceMode != REBALANCE_SINGLE_PAIR)) {
+        // Only assignVectorTask and rebalanceResources keep the resource
+        // columns and the dominant-share heap keys in step
+        problem = "vector loads need ASSIGN_BY_DOMINANT_SHARE and REBALANCE_SINGLE_PAIR";
+    }
+    if (problem) {
+        printf("Invalid load balancer config: %s\n", problem);
+        return 0;
+    }
+    return 1;
 }
 
-/* Move a node up the heap to maintain min-heap property
- * Time Complexity: O(log n)
+/* Wrap an instance in a handle with the config's options, scratch and
+ * event log; frees the instance and returns NULL if the log cannot be opened
+ * Time Complexity: O(n + maxTasks)
  */
-void heapifyUp(MinHeap* heap, int index) {
-    if (index == 0) return;
+static LoadBalancer* openLoadBalancer(BalancerInstance* instance,
+                                      const LoadBalancerConfig* config) {
+    EventSink* events = NULL;
+    if (config->eventPath) {
+        events = createEventSink(config->eventPath, config->eventFormat,
+                                 EVENT_RING_CAPACITY);
+        if (events == NULL) {
+            freeBalancerInstance(instance);
+            return NULL;
+        }
+    }
+    
+    int n = instance->servers->numServers;
+    LoadBalancer* balancer = (LoadBalancer*)calloc(1, sizeof(LoadBalancer));
+    balancer->instance = instance;
     
-    int parentIdx = (index - 1) / 2;
+    SimulationOptions opts = defaultSimulationOptions();
+    opts.assignmentMode = config->assignmentMode;
+    opts.rebalanceMode = config->rebalanceMode;
+    opts.rebalanceThreshold = config->rebalanceThreshold;
+    opts.rebalanceInterval = config->rebalanceInterval;
+    opts.maxMigrationHops = config->maxMigrationHops;
+    opts.batchSize = 1;
+    opts.taskLifetime = 0;
+    opts.logLevel = config->logLevel;
+    opts.events = events;
+    opts.admission = ADMIT_ALL;
+    balancer->opts = opts;
     
-    // If current node's load is less than parent, swap
-    if (heap->arr[index].load < heap->arr[parentIdx].load) {
-        swap(&heap->arr[index], &heap->arr[parentIdx]);
-        heapifyUp(heap, parentIdx);
+    balancer->tasks = (config->maxTasks > 0) ? createTaskTable(config->maxTasks, n) : NULL;
+    if (config->rebalanceMode == REBALANCE_MULTI_PAIR) {
+        balancer->plan = createRebalancePlan(n);
+    } else if (config->rebalanceMode == REBALANCE_TOPOLOGY) {
+        balancer->search = createHopSearch(n);
     }
+    return balancer;
 }
 
-/* Move a node down the heap to maintain min-heap property
- * Time Complexity: O(log n)
+/* Create a balancer over servers with the given capacities and no links
+ * The heap is built bottom-up (buildHeap) rather than by n inserts.
+ * Returns NULL (with a message) on invalid input.
+ * Time Complexity: O(n + maxTasks)
  */
-void heapifyDown(MinHeap* heap, int index) {
-    int smallest = index;
-    int leftChild = 2 * index + 1;
-    int rightChild = 2 * index + 2;
+LB_API LoadBalancer* createLoadBalancer(const LoadBalancerConfig* config,
+                                        const float* capacities) {
+    if (!validLoadBalancerConfig(config)) {
+        return NULL;
+    }
+    int n = config->numServers;
+    int valid = (n >= 1 && capacities != NULL);
+    for (int i = 0; valid && i < n; i++) {
+        valid = capacities[i] > 0.0f && isfinite(capacities[i]);
+    }
+    if (!valid) {
+        printf("Invalid load balancer config: need servers with positive capacities\n");
+        return NULL;
+    }
     
-    // Check if left child exists and is smaller
-    if (leftChild < heap->size && 
-        heap->arr[leftChild].load < heap->arr[smallest].load) {
-        smallest = leftChild;
+    BalancerInstance* instance = (BalancerInstance*)malloc(sizeof(BalancerInstance));
+    instance->arena = NULL;
+    instance->resources = NULL;
+    instance->servers = createServerTable(n);
+    for (int i = 0; i < n; i++) {
+        setServerCapacity(instance->servers, i, capacities[i]);
     }
+    instance->graph = createGraph(n);
     
-    // Check if right child exists and is smaller
-    if (rightChild < heap->size && 
-        heap->arr[rightChild].load < heap->arr[smallest].load) {
-        smallest = rightChild;
+    instance->heap = createDaryHeap(n, config->heapArity);
+    float* keys = (float*)malloc(n * sizeof(float));
+    for (int i = 0; i < n; i++) {
+        keys[i] = serverHeapKey(instance->servers, i, config->assignmentMode);
     }
+    buildHeap(instance->heap, keys, n);
+    free(keys);
     
-    // If smallest is not the current node, swap and continue
-    if (smallest != index) {
-        swap(&heap->arr[index], &heap->arr[smallest]);
-        heapifyDown(heap, smallest);
+    instance->tracker = NULL;
+    if (config->trackImbalance) {
+        instance->tracker = createImbalanceTracker(n);
+        attachImbalanceTracker(instance->servers, instance->tracker);
     }
+    return openLoadBalancer(instance, config);
 }
 
-/* Insert a server into the min heap
- * Time Complexity: O(log n)
+/* Create a balancer over a random fleet and topology (createBalancerInstance)
+ * Time Complexity: O(n log n + maxTasks)
  */
-void insertHeap(MinHeap* heap, int serverId, float load) {
-    if (heap->size >= heap->capacity) {
-        printf("Heap capacity exceeded!\n");
-        return;
+LB_API LoadBalancer* createRandomLoadBalancer(const LoadBalancerConfig* config) {
+    if (!validLoadBalancerConfig(config)) {
+        return NULL;
     }
-    
-    heap->arr[heap->size].serverId = serverId;
-    heap->arr[heap->size].load = load;
-    
-    heapifyUp(heap, heap->size);
-    heap->size++;
+    if (config->numServers < 1) {
+        printf("Invalid load balancer config: need at least one server\n");
+        return NULL;
+    }
+    BalancerInstance* instance = createBalancerInstance(config->numServers,
+                                                        config->heapArity,
+                                                        config->assignmentMode,
+                                                        config->useArena,
+                                                        config->trackImbalance,
+                                                        config->resourceWeights);
+    return openLoadBalancer(instance, config);
 }
 
-/* Extract and return the server with minimum load
- * Time Complexity: O(log n)
+/* Resume from a snapshot (restoreBalancerInstance); its fleet size wins
+ * Time Complexity: O(n + E + maxTasks)
  */
-HeapNode extractMin(MinHeap* heap) {
-    HeapNode min = heap->arr[0];
-    
-    heap->arr[0] = heap->arr[heap->size - 1];
-    heap->size--;
-    
-    if (heap->size > 0) {
-        heapifyDown(heap, 0);
+LB_API LoadBalancer* restoreLoadBalancer(const char* path, const LoadBalancerConfig* config) {
+    if (!validLoadBalancerConfig(config)) {
+        return NULL;
     }
-    
-    return min;
+    BalancerInstance* instance = restoreBalancerInstance(path, config->heapArity,
+                                                         config->assignmentMode,
+                                                         config->useArena,
+                                                         config->trackImbalance, NULL);
+    return instance ? openLoadBalancer(instance, config) : NULL;
 }
 
-/* Update a server's load in the heap
- * Time Complexity: O(n) in worst case
+/* Write a snapshot, folding pending links into the CSR graph first
+ * Running tasks are not saved.
+ * Time Complexity: O(n + E)
  */
-void updateHeap(MinHeap* heap, int serverId, float newLoad) {
-    // Find the server in the heap
-    int index = -1;
-    for (int i = 0; i < heap->size; i++) {
-        if (heap->arr[i].serverId == serverId) {
-            index = i;
-            break;
-        }
+LB_API int saveLoadBalancer(LoadBalancer* balancer, const char* path) {
+    BalancerInstance* instance = balancer->instance;
+    buildGraphCSR(instance->graph);
+    return saveSnapshot(path, instance->servers, instance->heap, instance->graph,
+                        balancer->opts.assignmentMode);
+}
+
+/* Free the handle, its instance and its scratch; stops a running monitor
+ * and flushes the event log
+ * Time Complexity: O(n)
+ */
+LB_API void freeLoadBalancer(LoadBalancer* balancer) {
+    if (balancer == NULL) return;
+    balancerStopMonitor(balancer);
+    if (balancer->counters) {
+        freeLoadCounters(balancer->counters);
     }
-    
-    if (index == -1) {
-        printf("Server %d not found in heap!\n", serverId);
-        return;
+    if (balancer->opts.events) {
+        closeEventSink(balancer->opts.events);
     }
-    
-    heap->arr[index].load = newLoad;
-    
-    // Reheapify from this position
-    int parentIdx = (index - 1) / 2;
-    if (index > 0 && heap->arr[index].load < heap->arr[parentIdx].load) {
-        heapifyUp(heap, index);
-    } else {
-        heapifyDown(heap, index);
+    if (balancer->opts.hierarchy) {
+        freeHierarchicalBalancer(balancer->opts.hierarchy);
     }
+    if (balancer->tasks) {
+        freeTaskTable(balancer->tasks);
+    }
+    if (balancer->plan) {
+        freeRebalancePlan(balancer->plan);
+    }
+    if (balancer->search) {
+        freeHopSearch(balancer->search);
+    }
+    freeBalancerInstance(balancer->instance);
+    free(balancer);
+}
+
+/* Add a directed link; it joins the CSR graph at the next topology pass
+ * (searchWithinHops builds it) or save
+ * Time Complexity: O(1) amortized
+ */
+LB_API int balancerAddLink(LoadBalancer* balancer, int src, int dest) {
+    int n = balancer->instance->servers->numServers;
+    if (src < 0 || src >= n || dest < 0 || dest >= n) {
+        printf("Link %d → %d out of range!\n", src, dest);
+        return -1;
+    }
+    addEdge(balancer->instance->graph, src, dest);
+    return 0;
 }
 
-/* Free heap memory
+/* Seed this thread's Rng (seedThreadRng)
  * Time Complexity: O(1)
  */
-void freeMinHeap(MinHeap* heap) {
-    free(heap->arr);
-    free(heap);
+LB_API void balancerSeed(unsigned int seed) {
+    seedThreadRng(seed);
 }
 
-/* ============================================================================
- * LOAD BALANCING FUNCTIONS
- * ============================================================================ */
+/* Next task load of this thread's Rng, as the simulation loops draw them
+ * Time Complexity: O(1)
+ */
+LB_API float balancerRandomLoad(void) {
+    return rngRange(threadRng(), MIN_TASK_LOAD, MAX_TASK_LOAD);
+}
 
-/* Calculate average load across all servers
- * Time Complexity: O(n)
+/* Neighbors of a server from the CSR graph, folding pending links first
+ * Time Complexity: O(1), or O(V + E) after balancerAddLink
  */
-float calculateAverageLoad(Server servers[], int numServers) {
-    float totalLoad = 0.0;
-    for (int i = 0; i < numServers; i++) {
-        totalLoad += servers[i].currentLoad;
+LB_API int balancerLinks(LoadBalancer* balancer, int serverId, const int** neighbors) {
+    Graph* graph = balancer->instance->graph;
+    if (serverId < 0 || serverId >= graph->numServers) {
+        return -1;
+    }
+    buildGraphCSR(graph);
+    if (neighbors) {
+        *neighbors = graphNeighbors(graph, serverId);
     }
-    return totalLoad / numServers;
+    return graphDegree(graph, serverId);
 }
 
-/* Calculate load percentage for a server
- * Time Complexity: O(1)
+/* Replace the flat heap's role with a HierarchicalBalancer over the fleet
+ * Time Complexity: O(n + E α(n))
  */
-float getLoadPercentage(Server server) {
-    return (server.currentLoad / server.capacity) * 100.0;
+LB_API int balancerSetHierarchy(LoadBalancer* balancer, HierarchyMode mode, int groupSize) {
+    if (mode != HIERARCHY_RACKS && mode != HIERARCHY_COMPONENTS) {
+        printf("Unknown hierarchy mode %d\n", (int)mode);
+        return -1;
+    }
+    if (balancer->instance->servers->resources) {
+        printf("The hierarchical balancer needs scalar loads\n");
+        return -1;
+    }
+    BalancerInstance* instance = balancer->instance;
+    buildGraphCSR(instance->graph);
+    if (balancer->opts.hierarchy) {
+        freeHierarchicalBalancer(balancer->opts.hierarchy);
+    }
+    balancer->opts.hierarchy = createHierarchicalBalancer(
+        instance->servers, (mode == HIERARCHY_COMPONENTS) ? instance->graph : NULL,
+        groupSize, balancer->opts.assignmentMode, instance->heap->arity);
+    return balancer->opts.hierarchy->numGroups;
 }
 
-/* Find the most loaded server
- * Time Complexity: O(n)
+/* Remember a placed task and run the periodic pass when one is due
+ * Time Complexity: O(1), plus a rebalancing pass every interval tasks
  */
-int findMostLoadedServer(Server servers[], int numServers) {
-    int mostLoaded = 0;
-    float maxLoad = servers[0].currentLoad;
+static void finishAssignment(LoadBalancer* balancer, int serverId, float load, int* taskId) {
+    int task = (int)(++balancer->arrivals & INT_MAX);
+    if (balancer->opts.events) {
+        recordAssignment(balancer->opts.events, task, serverId, load,
+                         balancer->instance->servers->currentLoad[serverId]);
+    }
     
-    for (int i = 1; i < numServers; i++) {
-        if (servers[i].currentLoad > maxLoad) {
-            maxLoad = servers[i].currentLoad;
-            mostLoaded = i;
-        }
+    int id = -1;
+    TaskTable* tasks = balancer->tasks;
+    if (tasks && tasks->freeHead != -1) {
+        id = trackTask(tasks, task, serverId, load);
+    }
+    if (taskId) {
+        *taskId = id;
     }
+    balancer->stats.tasksAssigned++;
     
-    return mostLoaded;
+    int interval = balancer->opts.rebalanceInterval;
+    if (interval > 0 && ++balancer->sinceRebalance >= interval) {
+        balancerRebalance(balancer);
+    }
 }
 
-/* Find the least loaded server
- * Time Complexity: O(n)
+/* Place a task with assignTask (heap root, or projected utilization)
+ * Time Complexity: O(log n)
  */
-int findLeastLoadedServer(Server servers[], int numServers) {
-    int leastLoaded = 0;
-    float minLoad = servers[0].currentLoad;
-    
-    for (int i = 1; i < numServers; i++) {
-        if (servers[i].currentLoad < minLoad) {
-            minLoad = servers[i].currentLoad;
-            leastLoaded = i;
-        }
+LB_API int balancerAssignTask(LoadBalancer* balancer, float load, int* taskId) {
+    BalancerInstance* instance = balancer->instance;
+    if (!(load >= 0.0f) || !isfinite(load) || instance->resources) {
+        return -1;
     }
-    
-    return leastLoaded;
+    int serverId = assignTask(instance->servers, instance->heap, load, &balancer->opts);
+    finishAssignment(balancer, serverId, load, taskId);
+    return serverId;
 }
 
-/* Rebalance loads across servers if imbalance exceeds threshold
- * Time Complexity: O(n log n)
+/* Place a task on serverId with assignTaskTo
+ * Time Complexity: O(log n)
  */
-void rebalanceLoads(Server servers[], int numServers, float threshold, 
-                    MinHeap* heap) {
-    float avgLoad = calculateAverageLoad(servers, numServers);
-    
-    int mostLoadedIdx = findMostLoadedServer(servers, numServers);
-    int leastLoadedIdx = findLeastLoadedServer(servers, numServers);
-    
-    float mostLoadedPercent = getLoadPercentage(servers[mostLoadedIdx]);
-    float leastLoadedPercent = getLoadPercentage(servers[leastLoadedIdx]);
-    
-    float imbalance = mostLoadedPercent - leastLoadedPercent;
-    
-    // Check if rebalancing is needed
-    if (imbalance > threshold) {
-        float migrationAmount = (servers[mostLoadedIdx].currentLoad - avgLoad) * 0.5;
-        
-        printf("\n⚠️  REBALANCING TRIGGERED ⚠️\n");
-        printf("   Imbalance: %.2f%% (threshold: %.2f%%)\n", imbalance, threshold);
-        printf("   Server %d (%.2f%%) → Server %d (%.2f%%)\n",
-               mostLoadedIdx, mostLoadedPercent,
-               leastLoadedIdx, leastLoadedPercent);
-        printf("   Migrating %.2f load units\n", migrationAmount);
-        
-        // Perform load migration
-        servers[mostLoadedIdx].currentLoad -= migrationAmount;
-        servers[leastLoadedIdx].currentLoad += migrationAmount;
-        
-        // Update heap with new loads
-        updateHeap(heap, mostLoadedIdx, servers[mostLoadedIdx].currentLoad);
-        updateHeap(heap, leastLoadedIdx, servers[leastLoadedIdx].currentLoad);
-        
-        printf("   ✓ Rebalancing complete\n");
+LB_API int balancerAssignTaskTo(LoadBalancer* balancer, int serverId, float load,
+                                int* taskId) {
+    BalancerInstance* instance = balancer->instance;
+    if (serverId < 0 || serverId >= instance->servers->numServers ||
+        !(load >= 0.0f) || !isfinite(load) || instance->resources) {
+        return -1;
     }
+    assignTaskTo(instance->servers, instance->heap, serverId, load, &balancer->opts);
+    finishAssignment(balancer, serverId, load, taskId);
+    return serverId;
 }
 
-/* Print current state of all servers
- * Time Complexity: O(n)
+/* Finish a tracked task with completeTask
+ * Time Complexity: O(log n)
  */
-void printServerStates(Server servers[], int numServers) {
-    printf("\n--- Current Server States ---\n");
-    for (int i = 0; i < numServers; i++) {
-        float percentage = getLoadPercentage(servers[i]);
-        printf("Server %d: Load = %6.2f/%6.2f (%.1f%%)\n",
-               servers[i].id, servers[i].currentLoad, 
-               servers[i].capacity, percentage);
+LB_API int balancerCompleteTask(LoadBalancer* balancer, int taskId) {
+    if (balancer->tasks == NULL) {
+        return -1;
     }
-    
-    float avgLoad = calculateAverageLoad(servers, numServers);
-    printf("\nAverage Load: %.2f\n", avgLoad);
+    BalancerInstance* instance = balancer->instance;
+    int serverId = completeTask(instance->servers, instance->heap, balancer->tasks,
+                                taskId, &balancer->opts);
+    if (serverId >= 0) {
+        balancer->stats.tasksCompleted++;
+    }
+    return serverId;
 }
 
-/* Simulate task assignment to servers
- * Time Complexity: O(n log n) for n tasks
+/* Run one pass of the configured rebalancing engine (rebalancePass)
+ * Time Complexity: as rebalancePass; O(1) to decide with trackImbalance
  */
-void simulateTaskAssignment(Server servers[], Graph* graph, MinHeap* heap, 
-                           int numTasks) {
-    printf("\n--- Assigning %d Tasks Dynamically ---\n", numTasks);
-    
-    for (int task = 1; task <= numTasks; task++) {
-        // Generate random task load
-        float taskLoad = MIN_TASK_LOAD + 
-                        (float)rand() / RAND_MAX * 
-                        (MAX_TASK_LOAD - MIN_TASK_LOAD);
-        
-        // Find least-loaded server using heap
-        HeapNode minServer = extractMin(heap);
-        
-        // Assign task to this server
-        servers[minServer.serverId].currentLoad += taskLoad;
-        float newLoad = servers[minServer.serverId].currentLoad;
-        
-        // Reinsert server into heap with updated load
-        insertHeap(heap, minServer.serverId, newLoad);
-        
-        float percentage = getLoadPercentage(servers[minServer.serverId]);
-        
-        printf("Task %2d → Server %d | Load: %6.2f/%6.2f (%.1f%%)\n",
-               task, minServer.serverId, newLoad,
-               servers[minServer.serverId].capacity, percentage);
-        
-        // Rebalance periodically
-        if (task % REBALANCE_INTERVAL == 0) {
-            rebalanceLoads(servers, NUM_SERVERS, REBALANCE_THRESHOLD, heap);
-        }
+LB_API float balancerRebalance(LoadBalancer* balancer) {
+    BalancerInstance* instance = balancer->instance;
+    double hopCost = 0.0;
+    float migrated = rebalancePass(instance->servers, instance->graph, instance->heap,
+                                   balancer->plan, balancer->search, &balancer->opts,
+                                   &hopCost);
+    balancer->sinceRebalance = 0;
+    if (migrated > 0.0f) {
+        balancer->stats.rebalances++;
+        balancer->stats.migratedLoad += migrated;
+        balancer->stats.migrationHopCost += hopCost;
     }
+    return migrated;
 }
 
-/* ============================================================================
- * MAIN SIMULATION
- * ============================================================================ */
+/* Run settings from the #define defaults (defaultSimulationOptions and
+ * defaultWorkloadModel)
+ * Time Complexity: O(1)
+ */
+LB_API LoadBalancerRun defaultLoadBalancerRun(void) {
+    SimulationOptions opts = defaultSimulationOptions();
+    LoadBalancerRun run;
+    run.numTasks = 0;
+    run.engine = ENGINE_LOOP;
+    run.rebalanceInterval = opts.rebalanceInterval;
+    run.numThreads = 0;
+    run.numShards = 0;
+    run.selectionPolicy = opts.selectionPolicy;
+    run.choices = opts.choices;
+    run.batchSize = opts.batchSize;
+    run.taskLifetime = opts.taskLifetime;
+    run.admission = opts.admission;
+    run.admissionQueue = opts.admissionQueue;
+    run.admissionLimit = opts.admissionLimit;
+    run.workload = defaultWorkloadModel();
+    run.capturePath = NULL;
+    run.replayPath = NULL;
+    return run;
+}
 
-int main() {
-    printf("╔════════════════════════════════════════════════════════════╗\n");
-    printf("║   DYNAMIC LOAD BALANCING SIMULATION - Distributed System   ║\n");
-    printf("╚════════════════════════════════════════════════════════════╝\n");
-    
-    // Seed random number generator
-    srand((unsigned int)time(NULL));
-    
-    // ========== INITIALIZATION ==========
-    printf("\n✓ Initializing %d servers...\n", NUM_SERVERS);
-    
-    // Create and initialize servers
-    Server servers[NUM_SERVERS];
-    for (int i = 0; i < NUM_SERVERS; i++) {
-        servers[i].id = i;
-        servers[i].capacity = MIN_CAPACITY + 
-                             (float)rand() / RAND_MAX * 
-                             (MAX_CAPACITY - MIN_CAPACITY);
-        servers[i].currentLoad = 0.0;
-        printf("  Server %d: Capacity = %.2f\n", i, servers[i].capacity);
+/* Record count of a binary trace (openTraceReader checks the header)
+ * Time Complexity: O(1)
+ */
+LB_API long long balancerTraceLength(const char* path) {
+    TraceReader* reader = openTraceReader(path);
+    if (reader == NULL) {
+        return -1;
+    }
+    long long records = traceRecordCount(reader);
+    closeTraceReader(reader);
+    return records;
+}
+
+/* Dispatch a run to simulateEventDriven, simulateDChoices, simulateSharded
+ * or simulateTaskAssignment with the handle's options plus the run's
+ * Concurrent producers bypass the heap, so they refuse handles with an
+ * event log, an ImbalanceTracker or a hierarchy, which assume one writer.
+ * Time Complexity: as the engine run
+ */
+LB_API int balancerSimulate(LoadBalancer* balancer, const LoadBalancerRun* run,
+                            SimulationStats* stats) {
+    BalancerInstance* instance = balancer->instance;
+    ServerTable* servers = instance->servers;
+    int concurrent = (run->engine == ENGINE_LOOP && run->numThreads > 0);
+    if (concurrent && (balancer->opts.events || instance->tracker ||
+                       balancer->opts.hierarchy)) {
+        printf("Concurrent producers need a handle without event log, imbalance "
+               "tracking or hierarchy\n");
+        return -1;
+    }
+    // Only heap selection refreshes the group heaps
+    if (balancer->opts.hierarchy && run->selectionPolicy != SELECT_HEAP) {
+        printf("The hierarchical balancer needs heap selection\n");
+        return -1;
+    }
+    // Vector loads are placed and rebalanced by the heap loop alone
+    if (servers->resources &&
+        (run->engine != ENGINE_LOOP || run->numThreads > 0 ||
+         run->selectionPolicy != SELECT_HEAP || run->admission != ADMIT_ALL ||
+         balancer->opts.rebalanceMode != REBALANCE_SINGLE_PAIR ||
+         run->capturePath || run->replayPath)) {
+        printf("Vector loads need the single-threaded heap loop with single-pair "
+               "rebalancing, no admission control and no traces\n");
+        return -1;
     }
     
-    // Create network graph
-    Graph* networkGraph = createGraph(NUM_SERVERS);
+    SimulationOptions opts = balancer->opts;
+    opts.rebalanceInterval = (run->rebalanceInterval > 0) ? run->rebalanceInterval : INT_MAX;
+    opts.selectionPolicy = run->selectionPolicy;
+    opts.choices = run->choices;
+    opts.batchSize = run->batchSize;
+    opts.taskLifetime = run->taskLifetime;
+    opts.admission = run->admission;
+    opts.admissionQueue = run->admissionQueue;
+    opts.admissionLimit = run->admissionLimit;
+    memset(stats, 0, sizeof(SimulationStats));
     
-    // Add random edges to create network topology
-    // Each server is connected to at least one other
-    for (int i = 0; i < NUM_SERVERS; i++) {
-        int neighbors = 1 + (rand() % 3);  // 1-3 connections per server
-        for (int j = 0; j < neighbors; j++) {
-            int dest = rand() % NUM_SERVERS;
-            if (dest != i) {
-                addEdge(networkGraph, i, dest);
-            }
+    // Replay streams the whole trace: its length replaces numTasks
+    int numTasks = run->numTasks;
+    if (run->replayPath) {
+        opts.replay = openTraceReader(run->replayPath);
+        if (opts.replay == NULL) {
+            return -1;
         }
+        long long records = traceRecordCount(opts.replay);
+        numTasks = (records < INT_MAX) ? (int)records : INT_MAX;
     }
-    
-    printGraph(networkGraph);
-    
-    // Create and initialize min heap
-    MinHeap* loadHeap = createMinHeap(NUM_SERVERS);
-    for (int i = 0; i < NUM_SERVERS; i++) {
-        insertHeap(loadHeap, i, 0.0);
+    if (run->capturePath) {
+        opts.capture = createTraceWriter(run->capturePath);
+        if (opts.capture == NULL) {
+            if (opts.replay) {
+                closeTraceReader(opts.replay);
+            }
+            return -1;
+        }
     }
     
-    printf("✓ Min-heap initialized with all servers\n");
-    
-    // ========== TASK ASSIGNMENT PHASE ==========
-    simulateTaskAssignment(servers, networkGraph, loadHeap, NUM_TASKS);
-    
-    // ========== FINAL STATE ==========
-    printf("\n╔════════════════════════════════════════════════════════════╗\n");
-    printf("║                    FINAL LOAD DISTRIBUTION                 ║\n");
-    printf("╚════════════════════════════════════════════════════════════╝\n");
-    
-    printServerStates(servers, NUM_SERVERS);
-    
-    // Calculate final statistics
-    float avgLoad = calculateAverageLoad(servers, NUM_SERVERS);
-    float maxLoad = servers[findMostLoadedServer(servers, NUM_SERVERS)].currentLoad;
-    float minLoad = servers[findLeastLoadedServer(servers, NUM_SERVERS)].currentLoad;
-    float imbalance = maxLoad - minLoad;
-    
-    printf("\n--- Final Statistics ---\n");
-    printf("Average Load:    %.2f\n", avgLoad);
-    printf("Max Load:        %.2f\n", maxLoad);
-    printf("Min Load:        %.2f\n", minLoad);
-    printf("Load Difference: %.2f\n", imbalance);
-    
-    if (imbalance < REBALANCE_THRESHOLD) {
-        printf("\n✓✓✓ System is WELL-BALANCED ✓✓✓\n");
+    int failed = 0;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (run->engine == ENGINE_EVENTS) {
+        failed = simulateEventDriven(servers, instance->graph, instance->heap, numTasks,
+                                     &run->workload, &opts, stats) < 0.0;
+        stats->wallSeconds = secondsSince(&start);
+    } else if (concurrent && opts.selectionPolicy == SELECT_D_CHOICES) {
+        stats->wallSeconds = simulateDChoices(servers, numTasks, run->numThreads,
+                                              &opts, stats);
+    } else if (concurrent) {
+        stats->wallSeconds = simulateSharded(servers, numTasks, run->numThreads,
+                                             run->numShards, &opts, stats);
     } else {
-        printf("\n⚠ System could benefit from further rebalancing\n");
+        simulateTaskAssignment(servers, instance->graph, instance->heap, numTasks,
+                               &opts, stats);
+        stats->wallSeconds = secondsSince(&start);
     }
     
-    // ========== CLEANUP ==========
-    freeMinHeap(loadHeap);
-    freeGraph(networkGraph);
+    int status = 0;
+    if (opts.capture) {
+        stats->arrivalsCaptured = closeTraceWriter(opts.capture);
+        if (stats->arrivalsCaptured < 0) {
+            printf("Cannot write trace file '%s'\n", run->capturePath);
+            status = 1;
+        }
+    }
+    if (opts.replay) {
+        closeTraceReader(opts.replay);
+    }
+    if (failed) {
+        return -1;
+    }
     
-    printf("\n✓ Simulation complete. Resources freed.\n\n");
+    balancer->stats.tasksAssigned += stats->tasksAssigned;
+    balancer->stats.tasksCompleted += stats->tasksCompleted;
+    balancer->stats.rebalances += stats->rebalances;
+    balancer->stats.migratedLoad += stats->migratedLoad;
+    balancer->stats.migrationHopCost += stats->migrationHopCost;
+    return status;
+}
+
+/* Attach LoadCounters (once) and start a LoadMonitor over them
+ * Time Complexity: O(n), then O(n) per period in the monitor thread
+ */
+LB_API int balancerStartMonitor(LoadBalancer* balancer, int periodMs) {
+    if (periodMs < 1 || balancer->monitor) {
+        printf("Invalid monitor period, or a monitor is already running\n");
+        return -1;
+    }
+    ServerTable* servers = balancer->instance->servers;
+    if (balancer->counters == NULL) {
+        balancer->counters = createLoadCounters(servers->numServers);
+        attachLoadCounters(servers, balancer->counters);
+    }
+    balancer->monitor = startLoadMonitor(servers, periodMs);
+    return balancer->monitor ? 0 : -1;
+}
+
+/* Stop the monitor thread; the counters stay attached for the next one
+ * Time Complexity: O(1) plus up to one period waiting for the thread
+ */
+LB_API long balancerStopMonitor(LoadBalancer* balancer) {
+    if (balancer->monitor == NULL) {
+        return 0;
+    }
+    long snapshots = stopLoadMonitor(balancer->monitor);
+    balancer->monitor = NULL;
+    return snapshots;
+}
+
+/* The process's exporter (metrics are per process, not per handle) */
+static MetricsExporter* apiExporter = NULL;
+
+/* Start the process's MetricsExporter
+ * Time Complexity: O(1); each export is O(threads x buckets)
+ */
+LB_API int balancerStartMetrics(const char* path, MetricsFormat format, int periodMs) {
+    if (!LOAD_BALANCER_METRICS) {
+        return 1;
+    }
+    if (apiExporter || periodMs < 1) {
+        printf("Invalid metrics period, or an exporter is already running\n");
+        return -1;
+    }
+    apiExporter = startMetricsExporter(path, format, periodMs);
+    return apiExporter ? 0 : -1;
+}
+
+/* Stop the exporter and summarize the heap sift counters
+ * Time Complexity: O(threads x buckets)
+ */
+LB_API long balancerStopMetrics(unsigned long long* sifts, double* siftLevels) {
+    if (apiExporter == NULL) {
+        return 0;
+    }
+    long exports = stopMetricsExporter(apiExporter);
+    apiExporter = NULL;
     
-    return 0;
+    MetricsSnapshot metrics;
+    takeMetricsSnapshot(&metrics);
+    if (sifts) {
+        *sifts = metrics.counters[METRIC_HEAP_SIFT_UPS] + metrics.counters[METRIC_HEAP_SIFT_DOWNS];
+    }
+    if (siftLevels) {
+        *siftLevels = metrics.counts[HISTOGRAM_SIFT_LEVELS]
+                          ? (double)metrics.sums[HISTOGRAM_SIFT_LEVELS] /
+                            metrics.counts[HISTOGRAM_SIFT_LEVELS]
+                          : 0.0;
+    }
+    return exports;
+}
+
+LB_API int balancerNumServers(const LoadBalancer* balancer) {
+    return balancer->instance->servers->numServers;
+}
+
+/* Current load of a server, 0 for an ID out of range */
+LB_API float balancerServerLoad(const LoadBalancer* balancer, int serverId) {
+    const ServerTable* servers = balancer->instance->servers;
+    return (serverId >= 0 && serverId < servers->numServers)
+               ? servers->currentLoad[serverId] : 0.0f;
+}
+
+/* Capacity of a server, 0 for an ID out of range */
+LB_API float balancerServerCapacity(const LoadBalancer* balancer, int serverId) {
+    const ServerTable* servers = balancer->instance->servers;
+    return (serverId >= 0 && serverId < servers->numServers)
+               ? servers->capacity[serverId] : 0.0f;
+}
+
+LB_API void balancerStats(const LoadBalancer* balancer, LoadBalancerStats* stats) {
+    *stats = balancer->stats;
+    stats->tasksRunning = balancer->tasks ? balancer->tasks->numActive : 0;
+    const EventSink* events = balancer->opts.events;
+    stats->eventsWritten = events ? eventSinkCount(events) : 0;
+    stats->eventStalls = events ? events->stalls : 0;
+    const Arena* arena = balancer->instance->arena;
+    stats->arenaBytes = arena ? (long long)arena->bytesUsed : 0;
+    stats->arenaBlocks = arena ? arena->numBlocks : 0;
+}
+
+/* Weighted utilization of one dimension (scanDominantShares on one column)
+ * Time Complexity: O(n)
+ */
+LB_API const char* balancerResourceUtilization(const LoadBalancer* balancer, int resource,
+                                               float* avg, float* max, float* min) {
+    const ResourceTable* resources = balancer->instance->resources;
+    if (resources == NULL || resource < 0 || resource >= RESOURCE_DIMENSIONS) {
+        return NULL;
+    }
+    int n = balancer->instance->servers->numServers;
+    float* const* load = &resources->load[resource];
+    float* const* invCapacity = &resources->invCapacity[resource];
+    LoadScan util = scanDominantShares(load, invCapacity, 1, n);
+    *avg = util.totalLoad * 100.0f / n;
+    *max = load[0][util.mostLoaded] * invCapacity[0][util.mostLoaded] * 100.0f;
+    *min = load[0][util.leastLoaded] * invCapacity[0][util.leastLoaded] * 100.0f;
+    return resourceNames[resource];
 }
@@ -0,0 +1,311 @@
+/* ============================================================================
+ * LOAD BALANCER LIBRARY API
+ * Embeds the balancer in another process through an opaque handle. The
+ * handle owns a server table, a topology, a min heap keyed by the chosen
+ * AssignmentMode and a pool of running tasks; all calls on one handle must
+ * come from one thread at a time.
+ *
+ * Shared library (exports only the LB_API functions below):
+ *   gcc -O2 -fPIC -shared -fvisibility=hidden -pthread \
+ *       -o libloadbalancer.so load_balancer.c -lm
+ * Client:
+ *   gcc -O2 -o dispatcher dispatcher.c -L. -lloadbalancer
+ * The demo CLI (main.c) is such a client: it uses nothing but this header.
+ * ============================================================================ */
+#ifndef LOAD_BALANCER_H
+#define LOAD_BALANCER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define LB_API __attribute__((visibility("default")))
+#else
+#define LB_API
+#endif
+
+/* Assignment Mode: What the heap key means and how a task picks a server */
+typedef enum {
+    ASSIGN_BY_LOAD,         // Key = currentLoad; lowest absolute load wins
+    ASSIGN_BY_UTILIZATION,  // Key = projected utilization (load + task) / capacity
+    ASSIGN_BY_DOMINANT_SHARE  // Key = highest weighted utilization of any resource
+} AssignmentMode;
+
+/* Rebalance Mode: How much of the fleet one rebalancing pass fixes */
+typedef enum {
+    REBALANCE_SINGLE_PAIR,  // Most -> least loaded server, half the excess
+    REBALANCE_MULTI_PAIR,   // Planned donor/receiver matching over the fleet
+    REBALANCE_TOPOLOGY      // Hot server -> least loaded server within N hops
+} RebalanceMode;
+
+/* Log Level: How much the balancer prints to stdout */
+typedef enum {
+    LOG_QUIET,              // Summary only
+    LOG_INFO,               // + rebalancing passes
+    LOG_DEBUG               // + one line per task
+} LogLevel;
+
+/* Selection Policy: How a task's server is chosen */
+typedef enum {
+    SELECT_HEAP,            // Exact minimum from the global heap
+    SELECT_D_CHOICES        // Lowest utilization of d random servers, lock-free
+} SelectionPolicy;
+
+/* Admission Policy: What happens to a task that no server has room for */
+typedef enum {
+    ADMIT_ALL,              // Place it anyway, past capacity (original behavior)
+    ADMIT_REJECT,           // Queue it; arrivals that find the queue full are rejected
+    ADMIT_SHED_OLDEST       // Queue it; a full queue sheds its oldest task instead
+} AdmissionPolicy;
+
+/* Hierarchy Mode: How a two-level balancer groups the fleet */
+typedef enum {
+    HIERARCHY_OFF,          // One flat heap over every server
+    HIERARCHY_RACKS,        // Contiguous server IDs, groupSize per rack
+    HIERARCHY_COMPONENTS    // Connected components of the topology, split at groupSize
+} HierarchyMode;
+
+/* Event Format: Encoding of the event log */
+typedef enum {
+    EVENT_FORMAT_CSV,       // One text line per event
+    EVENT_FORMAT_BINARY     // Header + packed SimEvent records
+} EventFormat;
+
+/* Metrics Format: Export encoding */
+typedef enum {
+    METRICS_FORMAT_JSON,        // One JSON object per line, appended
+    METRICS_FORMAT_PROMETHEUS   // Text exposition format, file replaced
+} MetricsFormat;
+
+/* Simulation Engine: How time advances in a run */
+typedef enum {
+    ENGINE_LOOP,            // Fixed task count, rebalance every N tasks
+    ENGINE_EVENTS           // Discrete-event engine on virtual time
+} SimulationEngine;
+
+/* Arrival Process: How the event engine generates task arrivals */
+typedef enum {
+    ARRIVAL_POISSON,        // Exponential inter-arrival times
+    ARRIVAL_BURSTY,         // Two-state Markov-modulated Poisson process
+    ARRIVAL_TRACE           // "time load service" lines from a file
+} ArrivalProcess;
+
+/* Service Model: Distribution of task service times */
+typedef enum {
+    SERVICE_EXPONENTIAL,
+    SERVICE_FIXED
+} ServiceModel;
+
+/* Workload Model: Arrival and service parameters of the event engine */
+typedef struct {
+    ArrivalProcess arrivals;
+    double arrivalRate;         // Mean arrivals per virtual second
+    double burstFactor;         // Bursty: burst rate / idle rate
+    double burstLength;         // Bursty: mean seconds per burst and idle spell
+    ServiceModel service;
+    double serviceMean;         // Mean service time in virtual seconds
+    double rebalancePeriod;     // Virtual seconds between rebalance passes
+    int maxInFlight;            // Task pool size; arrivals beyond it are dropped
+    char tracePath[256];        // ARRIVAL_TRACE input
+} WorkloadModel;
+
+/* Simulation Stats: Counters accumulated over a simulation run */
+typedef struct {
+    int tasksAssigned;
+    int tasksCompleted;
+    int tasksDropped;           // Event engine: arrivals with the pool full
+    int rebalances;
+    double migratedLoad;        // Double: long runs sum ~10^8 migrations
+    double migrationHopCost;    // Sum of migrated load x hops travelled
+    long long eventsProcessed;  // Event engine: events popped from the queue
+    double virtualTime;         // Event engine: time of the last event
+    int tasksQueued;            // Admission: arrivals that waited for room
+    int tasksRejected;          // Admission: arrivals turned away, queue full
+    int tasksShed;              // Admission: queued tasks dropped for newer ones
+    int tasksWaiting;           // Admission: still queued at the end
+    int maxQueueDepth;
+    double queueWait;           // Admission: total wait (arrivals or virtual seconds)
+    double wallSeconds;         // balancerSimulate: wall clock spent assigning
+    long long arrivalsCaptured; // balancerSimulate: records written to capturePath
+} SimulationStats;
+
+/* Opaque balancer handle */
+typedef struct LoadBalancer LoadBalancer;
+
+/* Load Balancer Config: Fixed for the lifetime of a handle */
+typedef struct {
+    int numServers;
+    int heapArity;              // Children per heap node: 2, 4 or 8
+    AssignmentMode assignmentMode;
+    RebalanceMode rebalanceMode;
+    float rebalanceThreshold;   // Percentage imbalance threshold
+    int rebalanceInterval;      // Pass after every N assignments, 0 = on request only
+    int maxMigrationHops;       // Topology mode reach
+    int maxTasks;               // Running tasks the handle can track
+    int trackImbalance;         // O(1) balanced-fleet check (ImbalanceTracker)
+    LogLevel logLevel;          // LOG_INFO prints every rebalancing pass
+    int useArena;               // Random and restored fleets: one arena per handle
+    const float* resourceWeights;  // Random fleets: cpu, memory and network weights
+                                   // of vector loads, NULL = scalar loads; needs
+                                   // ASSIGN_BY_DOMINANT_SHARE, REBALANCE_SINGLE_PAIR
+    const char* eventPath;      // Log assignments, completions and migrations, NULL = off
+    EventFormat eventFormat;
+} LoadBalancerConfig;
+
+/* Load Balancer Stats: Counters since the handle was created */
+typedef struct {
+    long long tasksAssigned;
+    long long tasksCompleted;
+    long long rebalances;       // Passes that migrated load
+    double migratedLoad;
+    int tasksRunning;
+    double migrationHopCost;    // Topology mode: migrated load x hops travelled
+    long long eventsWritten;    // Event log records, 0 without eventPath
+    long eventStalls;           // Event log: waits for the writer thread
+    long long arenaBytes;       // Arena in use, 0 without useArena
+    int arenaBlocks;
+} LoadBalancerStats;
+
+/* Load Balancer Run: One batch of simulated arrivals (balancerSimulate) */
+typedef struct {
+    int numTasks;               // Arrivals; a replayed trace runs to its end instead
+    SimulationEngine engine;
+    int rebalanceInterval;      // Loop engine: pass after every N tasks, 0 = none
+    int numThreads;             // Loop engine: concurrent producers, 0 = calling thread
+    int numShards;              // Sharded producers, 0 = a few per thread
+    SelectionPolicy selectionPolicy;
+    int choices;                // d for SELECT_D_CHOICES
+    int batchSize;              // Tasks placed per batch, largest first
+    int taskLifetime;           // Loop engine: arrivals until a task completes, 0 = never
+    AdmissionPolicy admission;  // Tasks that do not fit; ADMIT_ALL = no check
+    int admissionQueue;         // Pending task slots (0 = reject at once)
+    float admissionLimit;       // Admit while the server stays within this % of capacity
+    WorkloadModel workload;     // ENGINE_EVENTS arrivals and service times
+    const char* capturePath;    // Binary trace of the run's arrivals, NULL = off
+    const char* replayPath;     // Binary trace to replay, NULL = random loads
+} LoadBalancerRun;
+
+/* Defaults of the demo: binary heap, absolute load, single-pair passes */
+LB_API LoadBalancerConfig defaultLoadBalancerConfig(void);
+
+/* Create a balancer for config->numServers servers with the given
+ * capacities (all > 0) and no links. Returns NULL on invalid input.
+ */
+LB_API LoadBalancer* createLoadBalancer(const LoadBalancerConfig* config,
+                                        const float* capacities);
+
+/* Create a balancer over a random fleet drawn from the calling thread's
+ * generator (balancerSeed): capacities in [80, 120], one per resource with
+ * config->resourceWeights, and 1-3 links per server. Returns NULL on
+ * invalid input.
+ */
+LB_API LoadBalancer* createRandomLoadBalancer(const LoadBalancerConfig* config);
+
+/* Resume from a file written by saveLoadBalancer; the snapshot's fleet
+ * replaces config->numServers. Returns NULL if the file is not a snapshot.
+ */
+LB_API LoadBalancer* restoreLoadBalancer(const char* path, const LoadBalancerConfig* config);
+
+/* Write loads, heap and topology for restoreLoadBalancer. Returns 0 or -1. */
+LB_API int saveLoadBalancer(LoadBalancer* balancer, const char* path);
+
+LB_API void freeLoadBalancer(LoadBalancer* balancer);
+
+/* Seed the calling thread's generator: random fleets, balancerRandomLoad
+ * and the tasks of balancerSimulate all draw from it
+ */
+LB_API void balancerSeed(unsigned int seed);
+
+/* Random task load in [5, 15] from the calling thread's generator */
+LB_API float balancerRandomLoad(void);
+
+/* Add a directed link for REBALANCE_TOPOLOGY; it joins the graph at the
+ * next topology pass or save. Returns 0 or -1.
+ */
+LB_API int balancerAddLink(LoadBalancer* balancer, int src, int dest);
+
+/* Links of a server; *neighbors (may be NULL) stays valid until the next
+ * balancerAddLink. Returns the count, -1 for an ID out of range.
+ */
+LB_API int balancerLinks(LoadBalancer* balancer, int serverId, const int** neighbors);
+
+/* Put the servers under two-level heaps, by ID (HIERARCHY_RACKS) or by the
+ * current links (HIERARCHY_COMPONENTS), for every later assignment and pass;
+ * groupSize 0 = sqrt(servers). Returns the number of groups, or -1.
+ */
+LB_API int balancerSetHierarchy(LoadBalancer* balancer, HierarchyMode mode, int groupSize);
+
+/* Place a task on the least loaded (or least utilized) server
+ * *taskId (may be NULL) receives the id for balancerCompleteTask, or -1
+ * when maxTasks tasks are already running; the task is placed either way.
+ * Returns the chosen server, -1 for a negative or non-finite load or a
+ * vector-load fleet.
+ */
+LB_API int balancerAssignTask(LoadBalancer* balancer, float load, int* taskId);
+
+/* Place a task on a given server (affinity); same contract otherwise */
+LB_API int balancerAssignTaskTo(LoadBalancer* balancer, int serverId, float load,
+                                int* taskId);
+
+/* Finish a task. Returns the server it ran on, -1 for an unknown id. */
+LB_API int balancerCompleteTask(LoadBalancer* balancer, int taskId);
+
+/* Run one rebalancing pass now. Returns the load migrated. */
+LB_API float balancerRebalance(LoadBalancer* balancer);
+
+/* Loop and event-engine settings of the demo */
+LB_API LoadBalancerRun defaultLoadBalancerRun(void);
+
+/* Task records in a binary trace written through capturePath, or -1 */
+LB_API long long balancerTraceLength(const char* path);
+
+/* Run run->numTasks simulated arrivals on the handle: the event engine,
+ * concurrent producers, d-choices, batches, admission control, vector
+ * loads and trace capture or replay. *stats receives the run's counters,
+ * which are also added to balancerStats. Vector-load handles run only the
+ * single-threaded heap loop (ENGINE_LOOP, no threads, SELECT_HEAP, no
+ * admission, no traces); a handle with a hierarchy needs SELECT_HEAP.
+ * Returns 0; 1 if the run finished but its trace could not be written; -1
+ * if it could not start or the arrival trace is unreadable (no run to
+ * report).
+ */
+LB_API int balancerSimulate(LoadBalancer* balancer, const LoadBalancerRun* run,
+                            SimulationStats* stats);
+
+/* Print a lock-free load summary every periodMs from a background thread
+ * until balancerStopMonitor. Returns 0 or -1.
+ */
+LB_API int balancerStartMonitor(LoadBalancer* balancer, int periodMs);
+
+/* Stop the monitor. Returns the summaries it printed. */
+LB_API long balancerStopMonitor(LoadBalancer* balancer);
+
+/* Export the process's hot-path counters and histograms to path every
+ * periodMs until balancerStopMetrics. Returns 0, -1 if the file or thread
+ * cannot be created, 1 if metrics are compiled out.
+ */
+LB_API int balancerStartMetrics(const char* path, MetricsFormat format, int periodMs);
+
+/* Stop the exporter after one final export; *sifts and *siftLevels (may
+ * be NULL) receive the heap sifts and their mean levels. Returns the
+ * exports written.
+ */
+LB_API long balancerStopMetrics(unsigned long long* sifts, double* siftLevels);
+
+LB_API int balancerNumServers(const LoadBalancer* balancer);
+LB_API float balancerServerLoad(const LoadBalancer* balancer, int serverId);
+LB_API float balancerServerCapacity(const LoadBalancer* balancer, int serverId);
+LB_API void balancerStats(const LoadBalancer* balancer, LoadBalancerStats* stats);
+
+/* Weighted utilization of one resource of a vector-load fleet in percent
+ * Returns the resource name, NULL past the last resource or for scalar loads.
+ */
+LB_API const char* balancerResourceUtilization(const LoadBalancer* balancer, int resource,
+                                               float* avg, float* max, float* min);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LOAD_BALANCER_H */
@@ -0,0 +1,1256 @@
+/* ============================================================================
+ * DYNAMIC LOAD BALANCING SIMULATION - DEMO
+ * A client of the load balancer library (load_balancer.h only): parses the
+ * command line and config files, builds a fleet through the handle API,
+ * assigns tasks with balancerAssignTask / balancerCompleteTask /
+ * balancerRebalance (or balancerSimulate for the library's engines),
+ * runs parameter sweeps and prints the results.
+ *
+ * Build: gcc -pthread -o load_balancer main.c load_balancer.c -lm
+ * ============================================================================ */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200112L  // pthreads with -std=c99
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <math.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+#include "load_balancer.h"
+
+/* ============================================================================
+ * CONSTANTS AND CONFIGURATION
+ * ============================================================================ */
+#define DEFAULT_NUM_TASKS 30     // Task count unless set by --tasks
+#define MAX_PRINTED_SERVERS 20   // Per-server listings are skipped above this
+#define LOG_LEVEL LOG_DEBUG      // Console output unless set by --log-level
+#define RESOURCE_DIMENSIONS 3    // --resource-weights: cpu, memory, network
+#define METRICS_PERIOD_MS 1000   // Default --metrics export period
+#define SWEEP_MAX_VALUES 16      // Most thresholds / intervals in one sweep
+#define SWEEP_RUNS 8             // Default seeds per sweep cell
+
+/* ============================================================================
+ * DATA STRUCTURES
+ * ============================================================================ */
+
+/* Simulation Config: Run parameters from the command line or a config file
+ * balancer and run go to the library as they are, once the paths below
+ * are filled in.
+ */
+typedef struct {
+    LoadBalancerConfig balancer;  // Fleet, heap, rebalancing engine, log level
+    LoadBalancerRun run;        // Task count, engine, selection, interval, workload
+    unsigned int seed;
+    int hasSeed;                // 0 = seed from the current time
+    char eventPath[256];        // Event log file, "" = no event recording
+    int monitorMs;              // Load snapshot period, 0 = no monitor thread
+    char metricsPath[256];      // Metrics export file, "" = no export
+    MetricsFormat metricsFormat;
+    int metricsMs;              // Metrics export period
+    char capturePath[256];      // Binary trace of this run's arrivals, "" = off
+    char replayPath[256];       // Binary trace to replay, "" = random loads
+    char snapshotPath[256];     // Snapshot written after the run, "" = none
+    char restorePath[256];      // Snapshot to start from, "" = fresh fleet
+    HierarchyMode hierarchy;    // Two-level balancer grouping, HIERARCHY_OFF = flat
+    int groupSize;              // Servers per group, 0 = ceil(sqrt(numServers))
+    float sweepThresholds[SWEEP_MAX_VALUES];
+    int numSweepThresholds;     // 0 = sweep only balancer.rebalanceThreshold
+    int sweepIntervals[SWEEP_MAX_VALUES];
+    int numSweepIntervals;      // 0 = sweep only run.rebalanceInterval
+    int sweepRuns;              // Seeds per (threshold, interval) cell
+    int sweepThreads;           // Sweep worker threads, 0 = one per online core
+    int vectorLoads;            // CPU/memory/network vectors instead of one load
+    float resourceWeights[RESOURCE_DIMENSIONS];
+} SimulationConfig;
+
+/* Sweep Result: Outcome of one run in a parameter sweep */
+typedef struct {
+    float threshold;
+    int interval;
+    unsigned int seed;
+    float imbalance;            // Final max - min load
+    float maxAvgLoad;           // Final max / average load
+    long long rebalances;
+    double migratedLoad;
+    double tasksPerSec;         // Wall clock of this run on its worker
+} SweepResult;
+
+/* Sweep Runner: Job queue shared by the sweep worker threads */
+typedef struct {
+    const SimulationConfig* config;
+    SweepResult* results;       // One per job; threshold, interval, seed preset
+    int numJobs;
+    _Atomic int nextJob;
+} SweepRunner;
+
+/* Load Summary: Fleet-wide figures from the per-server getters */
+typedef struct {
+    float avgLoad;
+    float maxLoad;
+    float minLoad;
+} LoadSummary;
+
+/* ============================================================================
+ * CONFIGURATION
+ * ============================================================================ */
+
+/* Default run configuration from the library defaults
+ * Time Complexity: O(1)
+ */
+SimulationConfig defaultSimulationConfig(void) {
+    SimulationConfig config;
+    config.balancer = defaultLoadBalancerConfig();
+    config.balancer.rebalanceInterval = 0;   // Passes follow run.rebalanceInterval
+    config.balancer.logLevel = LOG_LEVEL;
+    config.run = defaultLoadBalancerRun();
+    config.run.numTasks = DEFAULT_NUM_TASKS;
+    config.seed = 0;
+    config.hasSeed = 0;
+    config.eventPath[0] = '\0';
+    config.monitorMs = 0;
+    config.metricsPath[0] = '\0';
+    config.metricsFormat = METRICS_FORMAT_JSON;
+    config.metricsMs = METRICS_PERIOD_MS;
+    config.capturePath[0] = '\0';
+    config.replayPath[0] = '\0';
+    config.snapshotPath[0] = '\0';
+    config.restorePath[0] = '\0';
+    config.hierarchy = HIERARCHY_OFF;
+    config.groupSize = 0;
+    config.numSweepThresholds = 0;
+    config.numSweepIntervals = 0;
+    config.sweepRuns = SWEEP_RUNS;
+    config.sweepThreads = 0;
+    config.vectorLoads = 0;
+    for (int d = 0; d < RESOURCE_DIMENSIONS; d++) {
+        config.resourceWeights[d] = 1.0f;
+    }
+    return config;
+}
+
+/* Parse a base-10 integer in [minValue, maxValue]
+ * Returns 0 on success, -1 if text is not a whole number in range.
+ */
+static int parseIntValue(const char* text, long minValue, long maxValue, long* out) {
+    char* end;
+    long value = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || value < minValue || value > maxValue) {
+        return -1;
+    }
+    *out = value;
+    return 0;
+}
+
+/* Parse a comma-separated list of at most SWEEP_MAX_VALUES numbers, each
+ * > 0 (and whole when integers is set), for sweeps and resource weights
+ * Returns the number of values, or -1 if text is not such a list.
+ */
+static int parseNumberList(const char* text, int integers, double* out) {
+    int count = 0;
+    const char* cursor = text;
+    for (;;) {
+        char* end;
+        double value = strtod(cursor, &end);
+        if (end == cursor || !(value > 0.0) || count == SWEEP_MAX_VALUES ||
+            (integers && (value != floor(value) || value > INT_MAX))) {
+            return -1;
+        }
+        out[count++] = value;
+        if (*end == '\0') {
+            return count;
+        }
+        if (*end != ',') {
+            return -1;
+        }
+        cursor = end + 1;
+    }
+}
+
+/* Set one configuration key (command-line option name without "--")
+ * Returns 0 on success, -1 (with a message) on an unknown key or bad value.
+ * Time Complexity: O(1)
+ */
+int setConfigValue(SimulationConfig* config, const char* key, const char* value) {
+    long number = 0;
+    int valid = 1;
+
+    if (strcmp(key, "servers") == 0) {
+        valid = parseIntValue(value, 1, 100000000L, &number) == 0;
+        if (valid) config->balancer.numServers = (int)number;
+    } else if (strcmp(key, "tasks") == 0) {
+        valid = parseIntValue(value, 0, 2147483647L, &number) == 0;
+        if (valid) config->run.numTasks = (int)number;
+    } else if (strcmp(key, "interval") == 0) {
+        valid = parseIntValue(value, 1, 2147483647L, &number) == 0;
+        if (valid) config->run.rebalanceInterval = (int)number;
+    } else if (strcmp(key, "hops") == 0) {
+        valid = parseIntValue(value, 1, 2147483647L, &number) == 0;
+        if (valid) config->balancer.maxMigrationHops = (int)number;
+    } else if (strcmp(key, "arity") == 0) {
+        valid = parseIntValue(value, 2, 8, &number) == 0 &&
+                (number == 2 || number == 4 || number == 8);
+        if (valid) config->balancer.heapArity = (int)number;
+    } else if (strcmp(key, "seed") == 0) {
+        valid = parseIntValue(value, 0, 4294967295L, &number) == 0;
+        if (valid) {
+            config->seed = (unsigned int)number;
+            config->hasSeed = 1;
+        }
+    } else if (strcmp(key, "threshold") == 0) {
+        char* end;
+        double threshold = strtod(value, &end);
+        valid = end != value && *end == '\0' && threshold >= 0.0;
+        if (valid) config->balancer.rebalanceThreshold = (float)threshold;
+    } else if (strcmp(key, "assign") == 0) {
+        if (strcmp(value, "load") == 0) {
+            config->balancer.assignmentMode = ASSIGN_BY_LOAD;
+        } else if (strcmp(value, "utilization") == 0) {
+            config->balancer.assignmentMode = ASSIGN_BY_UTILIZATION;
+        } else if (strcmp(value, "dominant") == 0) {
+            config->balancer.assignmentMode = ASSIGN_BY_DOMINANT_SHARE;
+        } else {
+            valid = 0;
+        }
+    } else if (strcmp(key, "rebalance") == 0) {
+        if (strcmp(value, "single") == 0) {
+            config->balancer.rebalanceMode = REBALANCE_SINGLE_PAIR;
+        } else if (strcmp(value, "multi") == 0) {
+            config->balancer.rebalanceMode = REBALANCE_MULTI_PAIR;
+        } else if (strcmp(value, "topology") == 0) {
+            config->balancer.rebalanceMode = REBALANCE_TOPOLOGY;
+        } else {
+            valid = 0;
+        }
+    } else if (strcmp(key, "policy") == 0) {
+        if (strcmp(value, "heap") == 0) {
+            config->run.selectionPolicy = SELECT_HEAP;
+        } else if (strcmp(value, "dchoices") == 0) {
+            config->run.selectionPolicy = SELECT_D_CHOICES;
+        } else {
+            valid = 0;
+        }
+    } else if (strcmp(key, "choices") == 0) {
+        valid = parseIntValue(value, 1, 64, &number) == 0;
+        if (valid) config->run.choices = (int)number;
+    } else if (strcmp(key, "batch") == 0) {
+        valid = parseIntValue(value, 1, 1000000L, &number) == 0;
+        if (valid) config->run.batchSize = (int)number;
+    } else if (strcmp(key, "lifetime") == 0) {
+        valid = parseIntValue(value, 0, 100000000L, &number) == 0;
+        if (valid) config->run.taskLifetime = (int)number;
+    } else if (strcmp(key, "threads") == 0) {
+        valid = parseIntValue(value, 0, 1024, &number) == 0;
+        if (valid) config->run.numThreads = (int)number;
+    } else if (strcmp(key, "shards") == 0) {
+        valid = parseIntValue(value, 0, 1000000L, &number) == 0;
+        if (valid) config->run.numShards = (int)number;
+    } else if (strcmp(key, "log-level") == 0) {
+        if (strcmp(value, "quiet") == 0) {
+            config->balancer.logLevel = LOG_QUIET;
+        } else if (strcmp(value, "info") == 0) {
+            config->balancer.logLevel = LOG_INFO;
+        } else if (strcmp(value, "debug") == 0) {
+            config->balancer.logLevel = LOG_DEBUG;
+        } else {
+            valid = 0;
+        }
+    } else if (strcmp(key, "events") == 0) {
+        valid = strlen(value) < sizeof(config->eventPath);
+        if (valid) strcpy(config->eventPath, value);
+    } else if (strcmp(key, "allocator") == 0) {
+        if (strcmp(value, "malloc") == 0) {
+            config->balancer.useArena = 0;
+        } else if (strcmp(value, "arena") == 0) {
+            config->balancer.useArena = 1;
+        } else {
+            valid = 0;
+        }
+    } else if (strcmp(key, "tracking") == 0) {
+        if (strcmp(value, "scan") == 0) {
+            config->balancer.trackImbalance = 0;
+        } else if (strcmp(value, "incremental") == 0) {
+            config->balancer.trackImbalance = 1;
+        } else {
+            valid = 0;
+        }
+    } else if (strcmp(key, "engine") == 0) {
+        if (strcmp(value, "loop") == 0) {
+            config->run.engine = ENGINE_LOOP;
+        } else if (strcmp(value, "events") == 0) {
+            config->run.engine = ENGINE_EVENTS;
+        } else {
+            valid = 0;
+        }
+    } else if (strcmp(key, "arrivals") == 0) {
+        if (strcmp(value, "poisson") == 0) {
+            config->run.workload.arrivals = ARRIVAL_POISSON;
+        } else if (strcmp(value, "bursty") == 0) {
+            config->run.workload.arrivals = ARRIVAL_BURSTY;
+        } else if (strcmp(value, "trace") == 0) {
+            config->run.workload.arrivals = ARRIVAL_TRACE;
+        } else {
+            valid = 0;
+        }
+    } else if (strcmp(key, "service") == 0) {
+        if (strcmp(value, "exp") == 0) {
+            config->run.workload.service = SERVICE_EXPONENTIAL;
+        } else if (strcmp(value, "fixed") == 0) {
+            config->run.workload.service = SERVICE_FIXED;
+        } else {
+            valid = 0;
+        }
+    } else if (strcmp(key, "rate") == 0 || strcmp(key, "service-mean") == 0 ||
+               strcmp(key, "period") == 0 || strcmp(key, "burst-factor") == 0 ||
+               strcmp(key, "burst-length") == 0) {
+        char* end;
+        double number = strtod(value, &end);
+        valid = end != value && *end == '\0' && number > 0.0;
+        if (valid) {
+            WorkloadModel* workload = &config->run.workload;
+            if (key[0] == 'r') workload->arrivalRate = number;
+            else if (key[0] == 's') workload->serviceMean = number;
+            else if (key[0] == 'p') workload->rebalancePeriod = number;
+            else if (key[6] == 'f') workload->burstFactor = number;
+            else workload->burstLength = number;
+        }
+    } else if (strcmp(key, "max-in-flight") == 0) {
+        valid = parseIntValue(value, 1, 100000000L, &number) == 0;
+        if (valid) config->run.workload.maxInFlight = (int)number;
+    } else if (strcmp(key, "trace") == 0) {
+        valid = strlen(value) < sizeof(config->run.workload.tracePath);
+        if (valid) {
+            strcpy(config->run.workload.tracePath, value);
+            config->run.workload.arrivals = ARRIVAL_TRACE;
+        }
+    } else if (strcmp(key, "record-trace") == 0) {
+        valid = strlen(value) < sizeof(config->capturePath);
+        if (valid) strcpy(config->capturePath, value);
+    } else if (strcmp(key, "replay") == 0) {
+        valid = strlen(value) < sizeof(config->replayPath);
+        if (valid) strcpy(config->replayPath, value);
+    } else if (strcmp(key, "save-snapshot") == 0) {
+        valid = strlen(value) < sizeof(config->snapshotPath);
+        if (valid) strcpy(config->snapshotPath, value);
+    } else if (strcmp(key, "restore") == 0) {
+        valid = strlen(value) < sizeof(config->restorePath);
+        if (valid) strcpy(config->restorePath, value);
+    } else if (strcmp(key, "admission") == 0) {
+        if (strcmp(value, "off") == 0) {
+            config->run.admission = ADMIT_ALL;
+        } else if (strcmp(value, "reject") == 0) {
+            config->run.admission = ADMIT_REJECT;
+        } else if (strcmp(value, "shed") == 0) {
+            config->run.admission = ADMIT_SHED_OLDEST;
+        } else {
+            valid = 0;
+        }
+    } else if (strcmp(key, "admission-queue") == 0) {
+        valid = parseIntValue(value, 0, 100000000L, &number) == 0;
+        if (valid) config->run.admissionQueue = (int)number;
+    } else if (strcmp(key, "admission-limit") == 0) {
+        char* end;
+        double limit = strtod(value, &end);
+        valid = end != value && *end == '\0' && limit > 0.0;
+        if (valid) config->run.admissionLimit = (float)limit;
+    } else if (strcmp(key, "hierarchy") == 0) {
+        if (strcmp(value, "off") == 0) {
+            config->hierarchy = HIERARCHY_OFF;
+        } else if (strcmp(value, "racks") == 0) {
+            config->hierarchy = HIERARCHY_RACKS;
+        } else if (strcmp(value, "components") == 0) {
+            config->hierarchy = HIERARCHY_COMPONENTS;
+        } else {
+            valid = 0;
+        }
+    } else if (strcmp(key, "group-size") == 0) {
+        valid = parseIntValue(value, 0, 100000000L, &number) == 0;
+        if (valid) config->groupSize = (int)number;
+    } else if (strcmp(key, "sweep-thresholds") == 0 ||
+               strcmp(key, "sweep-intervals") == 0) {
+        double values[SWEEP_MAX_VALUES];
+        int integers = (key[6] == 'i');
+        int count = parseNumberList(value, integers, values);
+        valid = count > 0;
+        for (int k = 0; k < count; k++) {
+            if (integers) config->sweepIntervals[k] = (int)values[k];
+            else config->sweepThresholds[k] = (float)values[k];
+        }
+        if (valid && integers) config->numSweepIntervals = count;
+        else if (valid) config->numSweepThresholds = count;
+    } else if (strcmp(key, "resources") == 0) {
+        if (strcmp(value, "scalar") == 0) {
+            config->vectorLoads = 0;
+        } else if (strcmp(value, "vector") == 0) {
+            config->vectorLoads = 1;
+        } else {
+            valid = 0;
+        }
+    } else if (strcmp(key, "resource-weights") == 0) {
+        double values[SWEEP_MAX_VALUES];
+        valid = parseNumberList(value, 0, values) == RESOURCE_DIMENSIONS;
+        for (int d = 0; valid && d < RESOURCE_DIMENSIONS; d++) {
+            config->resourceWeights[d] = (float)values[d];
+        }
+    } else if (strcmp(key, "sweep-runs") == 0) {
+        valid = parseIntValue(value, 1, 1000000L, &number) == 0;
+        if (valid) config->sweepRuns = (int)number;
+    } else if (strcmp(key, "sweep-threads") == 0) {
+        valid = parseIntValue(value, 0, 4096L, &number) == 0;
+        if (valid) config->sweepThreads = (int)number;
+    } else if (strcmp(key, "monitor") == 0) {
+        valid = parseIntValue(value, 0, 3600000L, &number) == 0;
+        if (valid) config->monitorMs = (int)number;
+    } else if (strcmp(key, "metrics") == 0) {
+        valid = strlen(value) < sizeof(config->metricsPath);
+        if (valid) strcpy(config->metricsPath, value);
+    } else if (strcmp(key, "metrics-format") == 0) {
+        if (strcmp(value, "json") == 0) {
+            config->metricsFormat = METRICS_FORMAT_JSON;
+        } else if (strcmp(value, "prometheus") == 0) {
+            config->metricsFormat = METRICS_FORMAT_PROMETHEUS;
+        } else {
+            valid = 0;
+        }
+    } else if (strcmp(key, "metrics-ms") == 0) {
+        valid = parseIntValue(value, 1, 3600000L, &number) == 0;
+        if (valid) config->metricsMs = (int)number;
+    } else if (strcmp(key, "event-format") == 0) {
+        if (strcmp(value, "csv") == 0) {
+            config->balancer.eventFormat = EVENT_FORMAT_CSV;
+        } else if (strcmp(value, "binary") == 0) {
+            config->balancer.eventFormat = EVENT_FORMAT_BINARY;
+        } else {
+            valid = 0;
+        }
+    } else {
+        printf("Unknown option '%s'\n", key);
+        return -1;
+    }
+
+    if (!valid) {
+        printf("Invalid value '%s' for option '%s'\n", value, key);
+        return -1;
+    }
+    return 0;
+}
+
+/* Load "key = value" lines from a config file
+ * Blank lines and lines starting with '#' are ignored; keys are the
+ * command-line option names without "--".
+ * Returns 0 on success, -1 if the file cannot be read or a line is invalid.
+ * Time Complexity: O(file size)
+ */
+int loadConfigFile(SimulationConfig* config, const char* path) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        printf("Cannot open config file '%s'\n", path);
+        return -1;
+    }
+
+    char line[256];
+    int lineNumber = 0;
+    int status = 0;
+    while (status == 0 && fgets(line, sizeof(line), file) != NULL) {
+        lineNumber++;
+
+        // Split at '=' and trim whitespace around key and value
+        char* key = line;
+        while (*key == ' ' || *key == '\t') key++;
+        if (*key == '#' || *key == '\n' || *key == '\r' || *key == '\0') continue;
+
+        char* value = strchr(key, '=');
+        if (value == NULL) {
+            printf("%s:%d: expected key = value\n", path, lineNumber);
+            status = -1;
+            break;
+        }
+        char* keyEnd = value;
+        *value++ = '\0';
+        while (keyEnd > key && (keyEnd[-1] == ' ' || keyEnd[-1] == '\t')) *--keyEnd = '\0';
+        while (*value == ' ' || *value == '\t') value++;
+        char* valueEnd = value + strlen(value);
+        while (valueEnd > value && (valueEnd[-1] == ' ' || valueEnd[-1] == '\t' ||
+                                    valueEnd[-1] == '\n' || valueEnd[-1] == '\r')) {
+            *--valueEnd = '\0';
+        }
+
+        if (setConfigValue(config, key, value) != 0) {
+            printf("%s:%d: in config file\n", path, lineNumber);
+            status = -1;
+        }
+    }
+
+    fclose(file);
+    return status;
+}
+
+/* Print command-line usage with the library's defaults */
+void printUsage(const char* program) {
+    LoadBalancerConfig balancer = defaultLoadBalancerConfig();
+    LoadBalancerRun run = defaultLoadBalancerRun();
+
+    printf("Usage: %s [options]\n", program);
+    printf("  --servers N         Fleet size (default %d)\n", balancer.numServers);
+    printf("  --tasks N           Tasks to assign (default %d)\n", DEFAULT_NUM_TASKS);
+    printf("  --threshold P       Rebalance imbalance threshold in %% (default %.1f)\n",
+           balancer.rebalanceThreshold);
+    printf("  --interval N        Rebalance after every N tasks (default %d)\n",
+           run.rebalanceInterval);
+    printf("  --arity D           Heap arity: 2, 4 or 8 (default %d)\n", balancer.heapArity);
+    printf("  --assign MODE       load | utilization | dominant (dominant resource share)\n");
+    printf("  --rebalance MODE    single | multi | topology\n");
+    printf("  --hops N            Topology mode: farthest migration target (default %d)\n",
+           balancer.maxMigrationHops);
+    printf("  --seed S            Random seed (default: current time)\n");
+    printf("  --policy P          heap (exact minimum) | dchoices (d random samples)\n");
+    printf("  --choices D         d for --policy dchoices (default %d)\n", run.choices);
+    printf("  --batch N           Place tasks N at a time, largest first (default %d)\n",
+           run.batchSize);
+    printf("  --lifetime N        Tasks complete N arrivals after starting (0 = never)\n");
+    printf("  --threads N         Concurrent producers (sharded heaps or d-choices)\n");
+    printf("  --shards N          Shard count (default 4 per thread)\n");
+    printf("  --log-level LEVEL   quiet | info (rebalancing) | debug (per task, default)\n");
+    printf("  --quiet             Same as --log-level quiet\n");
+    printf("  --events FILE       Record assignments and migrations to FILE\n");
+    printf("  --event-format FMT  csv (default) | binary\n");
+    printf("  --allocator A       malloc (default) | arena (one region per instance)\n");
+    printf("  --tracking T        scan (default) | incremental (O(1) imbalance check)\n");
+    printf("  --engine E          loop (fixed task count) | events (virtual time)\n");
+    printf("  --arrivals A        Events: poisson (default) | bursty | trace\n");
+    printf("  --rate R            Events: mean arrivals per second (default %.0f)\n",
+           run.workload.arrivalRate);
+    printf("  --burst-factor B    Bursty: burst/idle rate ratio (default %.0f)\n",
+           run.workload.burstFactor);
+    printf("  --burst-length S    Bursty: mean burst and idle seconds (default %.2f)\n",
+           run.workload.burstLength);
+    printf("  --service M         Events: exp (default) | fixed service times\n");
+    printf("  --service-mean S    Events: mean service seconds (default %.3f)\n",
+           run.workload.serviceMean);
+    printf("  --period S          Events: rebalance every S virtual seconds (default %.3f)\n",
+           run.workload.rebalancePeriod);
+    printf("  --trace FILE        Events: replay \"time load service\" lines\n");
+    printf("  --max-in-flight N   Events: task pool size (default %d)\n",
+           run.workload.maxInFlight);
+    printf("  --record-trace FILE Capture every arrival to a binary trace\n");
+    printf("  --replay FILE       Replay a binary trace (whole trace, ignores --tasks)\n");
+    printf("  --save-snapshot FILE Write loads, heap and topology at the end of the run\n");
+    printf("  --restore FILE      Start from a snapshot (its fleet replaces --servers)\n");
+    printf("  --admission P       off (default) | reject | shed (queue full: drop oldest)\n");
+    printf("  --admission-queue N Admission: pending task slots (default %d)\n",
+           run.admissionQueue);
+    printf("  --admission-limit P Admission: max %% of capacity per server (default %.0f)\n",
+           run.admissionLimit);
+    printf("  --hierarchy H       off (default) | racks | components (two-level heaps)\n");
+    printf("  --group-size N      Hierarchy: servers per group (default: sqrt of servers)\n");
+    printf("  --resources R       scalar (default) | vector (cpu, memory, network loads)\n");
+    printf("  --resource-weights W Vector: cpu,memory,network weights (default 1,1,1)\n");
+    printf("  --sweep-thresholds L Sweep: comma-separated thresholds to compare\n");
+    printf("  --sweep-intervals L Sweep: comma-separated rebalance intervals\n");
+    printf("  --sweep-runs N      Sweep: seeds per combination (default %d)\n", SWEEP_RUNS);
+    printf("  --sweep-threads N   Sweep: worker threads (default: one per core)\n");
+    printf("  --monitor MS        Print a lock-free load snapshot every MS milliseconds\n");
+    printf("  --metrics FILE      Export hot-path counters and histograms to FILE\n");
+    printf("  --metrics-format F  json (default, one line per snapshot) | prometheus\n");
+    printf("  --metrics-ms MS     Metrics export period (default %d)\n", METRICS_PERIOD_MS);
+    printf("  --config FILE       Read key = value options from FILE\n");
+    printf("  --help              Show this message\n");
+}
+
+/* Parse command-line arguments into config
+ * Options are applied left to right, so flags after --config FILE override
+ * values from the file.
+ * Returns 0 to run, 1 if --help was given, -1 on an invalid argument.
+ * Time Complexity: O(argc)
+ */
+int parseCommandLine(SimulationConfig* config, int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+
+        if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        if (strcmp(arg, "--quiet") == 0) {
+            config->balancer.logLevel = LOG_QUIET;
+            continue;
+        }
+        if (strncmp(arg, "--", 2) != 0 || i + 1 >= argc) {
+            printf("Invalid argument '%s' (see --help)\n", arg);
+            return -1;
+        }
+
+        const char* value = argv[++i];
+        int status = (strcmp(arg, "--config") == 0)
+                         ? loadConfigFile(config, value)
+                         : setConfigValue(config, arg + 2, value);
+        if (status != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * TASK ASSIGNMENT
+ * ============================================================================ */
+
+/* Seconds elapsed since start on the monotonic clock */
+static double secondsSince(const struct timespec* start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (double)(end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+/* Load percentage of one server */
+static float serverLoadPercentage(const LoadBalancer* balancer, int serverId) {
+    return balancerServerLoad(balancer, serverId) * 100.0f /
+           balancerServerCapacity(balancer, serverId);
+}
+
+/* Average, max and min load over the fleet
+ * Time Complexity: O(n)
+ */
+static LoadSummary summarizeLoads(const LoadBalancer* balancer) {
+    int numServers = balancerNumServers(balancer);
+    double totalLoad = 0.0;
+    LoadSummary summary = {0.0f, balancerServerLoad(balancer, 0),
+                           balancerServerLoad(balancer, 0)};
+    for (int i = 0; i < numServers; i++) {
+        float load = balancerServerLoad(balancer, i);
+        totalLoad += load;
+        if (load > summary.maxLoad) summary.maxLoad = load;
+        if (load < summary.minLoad) summary.minLoad = load;
+    }
+    summary.avgLoad = (float)(totalLoad / numServers);
+    return summary;
+}
+
+/* Whether a run needs one of the library's engines (balancerSimulate)
+ * rather than the per-task loop below
+ */
+static int needsSimulationEngine(const LoadBalancerRun* run, int vectorLoads) {
+    return run->engine != ENGINE_LOOP || run->numThreads > 0 ||
+           run->selectionPolicy != SELECT_HEAP || run->batchSize > 1 ||
+           run->admission != ADMIT_ALL || run->capturePath || run->replayPath ||
+           vectorLoads;
+}
+
+/* Assign run->numTasks random tasks one at a time through the handle
+ * Each task completes run->taskLifetime arrivals after it started; running
+ * task ids wait in a FIFO ring in start order. A pass runs after every
+ * run->rebalanceInterval tasks, once that task's departures are done.
+ * Time Complexity: O(m log n) for m tasks, plus the rebalancing passes
+ */
+static void assignTasks(LoadBalancer* balancer, const LoadBalancerRun* run, LogLevel logLevel) {
+    if (logLevel >= LOG_DEBUG) {
+        printf("\n--- Assigning %d Tasks Dynamically ---\n", run->numTasks);
+    }
+
+    int lifetime = run->taskLifetime;
+    int ringSize = lifetime + 1;
+    int* departures = (lifetime > 0) ? (int*)malloc(ringSize * sizeof(int)) : NULL;
+    int ringHead = 0, ringCount = 0;
+
+    for (int task = 1; task <= run->numTasks; task++) {
+        int taskId;
+        int serverId = balancerAssignTask(balancer, balancerRandomLoad(),
+                                          departures ? &taskId : NULL);
+
+        if (logLevel >= LOG_DEBUG) {
+            printf("Task %2d → Server %d | Load: %6.2f/%6.2f (%.1f%%)\n",
+                   task, serverId, balancerServerLoad(balancer, serverId),
+                   balancerServerCapacity(balancer, serverId),
+                   serverLoadPercentage(balancer, serverId));
+        }
+
+        // Complete every task that has run for lifetime arrivals
+        if (departures) {
+            departures[(ringHead + ringCount++) % ringSize] = taskId;
+            while (ringCount > lifetime) {
+                balancerCompleteTask(balancer, departures[ringHead]);
+                ringHead = (ringHead + 1) % ringSize;
+                ringCount--;
+            }
+        }
+
+        if (run->rebalanceInterval > 0 && task % run->rebalanceInterval == 0) {
+            balancerRebalance(balancer);
+        }
+    }
+    free(departures);
+}
+
+/* Run the tasks of one simulation: the per-task loop, or balancerSimulate
+ * for the engines and options only the library implements
+ * Returns balancerSimulate's status (0 for the per-task loop).
+ */
+static int runTasks(LoadBalancer* balancer, const LoadBalancerRun* run, int vectorLoads,
+                    LogLevel logLevel, SimulationStats* stats) {
+    if (needsSimulationEngine(run, vectorLoads)) {
+        return balancerSimulate(balancer, run, stats);
+    }
+    memset(stats, 0, sizeof(SimulationStats));
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    assignTasks(balancer, run, logLevel);
+    stats->wallSeconds = secondsSince(&start);
+    return 0;
+}
+
+/* Print the server network topology
+ * Time Complexity: O(V + E)
+ */
+static void printGraph(LoadBalancer* balancer) {
+    printf("\n--- Server Network Topology ---\n");
+    for (int i = 0; i < balancerNumServers(balancer); i++) {
+        const int* row;
+        int degree = balancerLinks(balancer, i, &row);
+        printf("Server %d → ", i);
+        for (int k = 0; k < degree; k++) {
+            printf("%d ", row[k]);
+        }
+        printf("\n");
+    }
+}
+
+/* Total links of the topology
+ * Time Complexity: O(V), plus O(V + E) after balancerAddLink
+ */
+static int countLinks(LoadBalancer* balancer) {
+    int links = 0;
+    for (int i = 0; i < balancerNumServers(balancer); i++) {
+        links += balancerLinks(balancer, i, NULL);
+    }
+    return links;
+}
+
+/* Print current state of all servers
+ * Time Complexity: O(n)
+ */
+static void printServerStates(const LoadBalancer* balancer) {
+    printf("\n--- Current Server States ---\n");
+    for (int i = 0; i < balancerNumServers(balancer); i++) {
+        printf("Server %d: Load = %6.2f/%6.2f (%.1f%%)\n",
+               i, balancerServerLoad(balancer, i), balancerServerCapacity(balancer, i),
+               serverLoadPercentage(balancer, i));
+    }
+    printf("\nAverage Load: %.2f\n", summarizeLoads(balancer).avgLoad);
+}
+
+/* ============================================================================
+ * PARAMETER SWEEP
+ * ============================================================================ */
+
+/* Run one sweep job on a fresh random fleet seeded with result->seed
+ * Time Complexity: O(m log n) for m tasks
+ */
+static void runSweepJob(const SimulationConfig* config, SweepResult* result) {
+    LoadBalancerConfig balancerConfig = config->balancer;
+    balancerConfig.rebalanceThreshold = result->threshold;
+    balancerConfig.logLevel = LOG_QUIET;
+    balancerConfig.maxTasks = config->run.taskLifetime + 1;
+    balancerConfig.resourceWeights = config->vectorLoads ? config->resourceWeights : NULL;
+    LoadBalancerRun run = config->run;
+    run.rebalanceInterval = result->interval;
+    run.engine = ENGINE_LOOP;
+    run.numThreads = 0;
+
+    balancerSeed(result->seed);
+    LoadBalancer* balancer = createRandomLoadBalancer(&balancerConfig);
+    if (balancer == NULL) {
+        return;
+    }
+    SimulationStats runStats;
+    runTasks(balancer, &run, config->vectorLoads, LOG_QUIET, &runStats);
+
+    LoadBalancerStats stats;
+    balancerStats(balancer, &stats);
+    LoadSummary summary = summarizeLoads(balancer);
+    result->imbalance = summary.maxLoad - summary.minLoad;
+    result->maxAvgLoad = (summary.avgLoad > 0.0f) ? summary.maxLoad / summary.avgLoad : 0.0f;
+    result->rebalances = stats.rebalances;
+    result->migratedLoad = stats.migratedLoad;
+    result->tasksPerSec = (runStats.wallSeconds > 0.0)
+                              ? stats.tasksAssigned / runStats.wallSeconds : 0.0;
+
+    freeLoadBalancer(balancer);
+}
+
+/* Worker thread: take jobs until the queue is empty */
+static void* sweepWorkerThread(void* arg) {
+    SweepRunner* runner = (SweepRunner*)arg;
+    for (;;) {
+        int job = atomic_fetch_add_explicit(&runner->nextJob, 1, memory_order_relaxed);
+        if (job >= runner->numJobs) {
+            break;
+        }
+        runSweepJob(runner->config, &runner->results[job]);
+    }
+    return NULL;
+}
+
+/* Print mean (and standard deviation) per cell, best cells marked
+ * Results are grouped cell by cell, runs consecutive.
+ * Time Complexity: O(jobs)
+ */
+static void printSweepSummary(const SweepResult* results, int numCells, int runs) {
+    printf("\n%9s %8s %18s %8s %12s %10s %12s\n", "threshold", "interval",
+           "imbalance (sd)", "max/avg", "migrated", "rebalances", "tasks/s");
+
+    int bestImbalance = 0, bestMigration = 0;
+    double bestImbalanceMean = 0.0, bestMigrationMean = 0.0;
+    for (int c = 0; c < numCells; c++) {
+        const SweepResult* cell = results + (size_t)c * runs;
+        double imbalance = 0.0, squares = 0.0, maxAvg = 0.0;
+        double migrated = 0.0, rebalances = 0.0, rate = 0.0;
+        for (int r = 0; r < runs; r++) {
+            imbalance += cell[r].imbalance;
+            squares += (double)cell[r].imbalance * cell[r].imbalance;
+            maxAvg += cell[r].maxAvgLoad;
+            migrated += cell[r].migratedLoad;
+            rebalances += cell[r].rebalances;
+            rate += cell[r].tasksPerSec;
+        }
+        imbalance /= runs;
+        double variance = squares / runs - imbalance * imbalance;
+        double deviation = (runs > 1 && variance > 0.0)
+                               ? sqrt(variance * runs / (runs - 1)) : 0.0;
+        migrated /= runs;
+
+        printf("%9.2f %8d %10.2f (%5.2f) %8.3f %12.1f %10.1f %12.0f\n",
+               cell[0].threshold, cell[0].interval, imbalance, deviation,
+               maxAvg / runs, migrated, rebalances / runs, rate / runs);
+
+        if (c == 0 || imbalance < bestImbalanceMean) {
+            bestImbalance = c;
+            bestImbalanceMean = imbalance;
+        }
+        if (c == 0 || migrated < bestMigrationMean) {
+            bestMigration = c;
+            bestMigrationMean = migrated;
+        }
+    }
+
+    const SweepResult* best = results + (size_t)bestImbalance * runs;
+    printf("\nLowest imbalance:  threshold %.2f, interval %d (%.2f)\n",
+           best->threshold, best->interval, bestImbalanceMean);
+    best = results + (size_t)bestMigration * runs;
+    printf("Least migration:   threshold %.2f, interval %d (%.1f)\n",
+           best->threshold, best->interval, bestMigrationMean);
+}
+
+/* Run every (threshold, interval) cell of the sweep config->sweepRuns times
+ * Each run builds its own handle (createRandomLoadBalancer) and seeds its
+ * worker's generator with baseSeed + run, so every cell sees the same
+ * fleets and task streams and cells differ only by their parameters. Runs
+ * are spread over config->sweepThreads workers (0 = one per online core);
+ * the summary is identical for any thread count except for tasks/s.
+ * Time Complexity: O(cells x runs x m log n / threads)
+ */
+void runParameterSweep(const SimulationConfig* config, unsigned int baseSeed) {
+    float thresholds[SWEEP_MAX_VALUES];
+    int intervals[SWEEP_MAX_VALUES];
+    int numThresholds = config->numSweepThresholds;
+    int numIntervals = config->numSweepIntervals;
+    if (numThresholds > 0) {
+        memcpy(thresholds, config->sweepThresholds, numThresholds * sizeof(float));
+    } else {
+        thresholds[0] = config->balancer.rebalanceThreshold;
+        numThresholds = 1;
+    }
+    if (numIntervals > 0) {
+        memcpy(intervals, config->sweepIntervals, numIntervals * sizeof(int));
+    } else {
+        intervals[0] = config->run.rebalanceInterval;
+        numIntervals = 1;
+    }
+
+    int runs = config->sweepRuns;
+    int numCells = numThresholds * numIntervals;
+    int numJobs = numCells * runs;
+    SweepResult* results = (SweepResult*)calloc(numJobs, sizeof(SweepResult));
+    for (int c = 0; c < numCells; c++) {
+        for (int r = 0; r < runs; r++) {
+            SweepResult* result = &results[c * runs + r];
+            result->threshold = thresholds[c / numIntervals];
+            result->interval = intervals[c % numIntervals];
+            result->seed = baseSeed + (unsigned int)r;
+        }
+    }
+
+    int numThreads = config->sweepThreads;
+    if (numThreads <= 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        numThreads = (cores > 0) ? (int)cores : 1;
+    }
+    if (numThreads > numJobs) {
+        numThreads = numJobs;
+    }
+
+    printf("\n--- Parameter Sweep: %d threshold(s) x %d interval(s) x %d run(s), "
+           "%d servers, %d tasks, %d thread(s) ---\n", numThresholds, numIntervals,
+           runs, config->balancer.numServers, config->run.numTasks, numThreads);
+
+    SweepRunner runner;
+    runner.config = config;
+    runner.results = results;
+    runner.numJobs = numJobs;
+    atomic_init(&runner.nextJob, 0);
+
+    // The calling thread is worker 0
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_t* workers = (pthread_t*)malloc(numThreads * sizeof(pthread_t));
+    int started = 0;
+    for (int t = 1; t < numThreads; t++) {
+        if (pthread_create(&workers[started], NULL, sweepWorkerThread, &runner) != 0) {
+            printf("Cannot start sweep worker; continuing with %d\n", started + 1);
+            break;
+        }
+        started++;
+    }
+    sweepWorkerThread(&runner);
+    for (int t = 0; t < started; t++) {
+        pthread_join(workers[t], NULL);
+    }
+    double seconds = secondsSince(&start);
+    free(workers);
+
+    printSweepSummary(results, numCells, runs);
+    printf("Sweep time:        %.2f s (%.1f runs/s)\n", seconds,
+           seconds > 0.0 ? numJobs / seconds : 0.0);
+    free(results);
+}
+
+/* ============================================================================
+ * MAIN SIMULATION
+ * ============================================================================ */
+
+int main(int argc, char** argv) {
+    SimulationConfig config = defaultSimulationConfig();
+    int status = parseCommandLine(&config, argc, argv);
+    if (status != 0) {
+        return (status > 0) ? 0 : 1;
+    }
+
+    LoadBalancerConfig* balancerConfig = &config.balancer;
+    LoadBalancerRun* run = &config.run;
+    int numServers = balancerConfig->numServers;
+
+    printf("╔════════════════════════════════════════════════════════════╗\n");
+    printf("║   DYNAMIC LOAD BALANCING SIMULATION - Distributed System   ║\n");
+    printf("╚════════════════════════════════════════════════════════════╝\n");
+
+    // Seed this thread's generator; the seed is printed so any run can be replayed
+    unsigned int seed = config.hasSeed ? config.seed : (unsigned int)time(NULL);
+    balancerSeed(seed);
+
+    // Snapshots hold scalar loads only
+    if (config.vectorLoads &&
+        (config.snapshotPath[0] != '\0' || config.restorePath[0] != '\0')) {
+        printf("Snapshots hold scalar loads; ignoring --save-snapshot and --restore\n");
+        config.snapshotPath[0] = '\0';
+        config.restorePath[0] = '\0';
+    }
+
+    // Vector loads have their own assignment and rebalancing path
+    if (config.vectorLoads) {
+        if (run->engine == ENGINE_EVENTS || run->numThreads > 0 ||
+            run->selectionPolicy != SELECT_HEAP ||
+            balancerConfig->rebalanceMode != REBALANCE_SINGLE_PAIR ||
+            config.capturePath[0] != '\0' || config.replayPath[0] != '\0') {
+            printf("Vector loads run the heap loop with single-pair rebalancing; ignoring "
+                   "--engine, --threads, --policy, --rebalance, --record-trace and --replay\n");
+        }
+        run->engine = ENGINE_LOOP;
+        run->numThreads = 0;
+        run->selectionPolicy = SELECT_HEAP;
+        balancerConfig->rebalanceMode = REBALANCE_SINGLE_PAIR;
+        balancerConfig->assignmentMode = ASSIGN_BY_DOMINANT_SHARE;
+        balancerConfig->resourceWeights = config.resourceWeights;
+        config.capturePath[0] = '\0';
+        config.replayPath[0] = '\0';
+    }
+
+    // Admission checks the heap's pick before placing a task
+    if (run->admission != ADMIT_ALL &&
+        (config.vectorLoads || run->selectionPolicy != SELECT_HEAP ||
+         (run->numThreads > 0 && run->engine == ENGINE_LOOP))) {
+        printf("Admission control needs heap selection, scalar loads and a single "
+               "producer; ignoring --admission\n");
+        run->admission = ADMIT_ALL;
+    }
+
+    // The hierarchy replaces the flat heap for selection and rebalancing
+    if (config.hierarchy != HIERARCHY_OFF &&
+        (config.vectorLoads || run->selectionPolicy != SELECT_HEAP ||
+         (run->numThreads > 0 && run->engine == ENGINE_LOOP))) {
+        printf("The hierarchical balancer needs heap selection, scalar loads and a single "
+               "producer; ignoring --hierarchy\n");
+        config.hierarchy = HIERARCHY_OFF;
+    }
+    if (config.hierarchy != HIERARCHY_OFF &&
+        balancerConfig->rebalanceMode != REBALANCE_SINGLE_PAIR) {
+        printf("The hierarchical balancer rebalances rack-local first; ignoring --rebalance\n");
+        balancerConfig->rebalanceMode = REBALANCE_SINGLE_PAIR;
+    }
+
+    // ========== PARAMETER SWEEP ==========
+    if (config.numSweepThresholds > 0 || config.numSweepIntervals > 0) {
+        if (run->engine == ENGINE_EVENTS || run->numThreads > 0) {
+            printf("The sweep runs the single-threaded loop; ignoring --engine and --threads\n");
+        }
+        if (config.eventPath[0] != '\0' || config.metricsPath[0] != '\0' ||
+            config.capturePath[0] != '\0' || config.replayPath[0] != '\0' ||
+            config.snapshotPath[0] != '\0' || config.restorePath[0] != '\0' ||
+            config.monitorMs > 0) {
+            printf("Sweep runs record nothing; ignoring --events, --metrics, "
+                   "--record-trace, --replay, --save-snapshot, --restore and --monitor\n");
+        }
+        if (config.hierarchy != HIERARCHY_OFF) {
+            printf("Sweep runs use the flat heap; ignoring --hierarchy\n");
+        }
+        runParameterSweep(&config, seed);
+        printf("\n✓ Sweep complete (seeds %u-%u).\n\n", seed,
+               seed + (unsigned int)config.sweepRuns - 1);
+        return 0;
+    }
+
+    // ========== INITIALIZATION ==========
+    // The event engine drops --threads below, so it keeps a single producer
+    int concurrent = (run->numThreads > 0 && run->engine == ENGINE_LOOP);
+    if (concurrent && balancerConfig->trackImbalance) {
+        printf("Imbalance tracking needs a single producer; ignoring --tracking\n");
+        balancerConfig->trackImbalance = 0;
+    }
+    if (concurrent && config.eventPath[0] != '\0') {
+        printf("Event recording needs a single producer; ignoring --events\n");
+        config.eventPath[0] = '\0';
+    }
+    if (run->engine == ENGINE_EVENTS && run->numThreads > 0) {
+        printf("The event engine is single-threaded; ignoring --threads\n");
+        run->numThreads = 0;
+    }
+    if (run->numThreads > 0 && run->taskLifetime > 0) {
+        printf("Task completion needs a single producer; ignoring --lifetime\n");
+        run->taskLifetime = 0;
+    }
+    if (run->numThreads > 0 &&
+        (config.capturePath[0] != '\0' || config.replayPath[0] != '\0')) {
+        printf("Trace capture and replay need a single producer; "
+               "ignoring --record-trace and --replay\n");
+        config.capturePath[0] = '\0';
+        config.replayPath[0] = '\0';
+    }
+    if (config.replayPath[0] != '\0' && run->engine == ENGINE_EVENTS &&
+        run->workload.arrivals == ARRIVAL_TRACE) {
+        printf("Replaying the binary trace; ignoring --trace\n");
+    }
+    run->capturePath = (config.capturePath[0] != '\0') ? config.capturePath : NULL;
+    run->replayPath = (config.replayPath[0] != '\0') ? config.replayPath : NULL;
+    balancerConfig->eventPath = (config.eventPath[0] != '\0') ? config.eventPath : NULL;
+
+    // The per-task loop tracks its running tasks in the handle
+    int perTask = !needsSimulationEngine(run, config.vectorLoads);
+    balancerConfig->maxTasks = (perTask && run->taskLifetime > 0) ? run->taskLifetime + 1 : 0;
+
+    // Random servers and topology (1-3 connections per server) under a min
+    // heap, optionally in one arena - or the saved loads, topology and heap
+    LoadBalancer* balancer;
+    if (config.restorePath[0] != '\0') {
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        balancer = restoreLoadBalancer(config.restorePath, balancerConfig);
+        if (balancer == NULL) {
+            return 1;
+        }
+        numServers = balancerNumServers(balancer);
+        printf("\n✓ Restored %d servers and %d links from %s in %.2f ms (seed %u)\n",
+               numServers, countLinks(balancer), config.restorePath,
+               secondsSince(&start) * 1000.0, seed);
+    } else {
+        printf("\n✓ Initializing %d servers (seed %u)...\n", numServers, seed);
+        balancer = createRandomLoadBalancer(balancerConfig);
+        if (balancer == NULL) {
+            return 1;
+        }
+    }
+    int listServers = (numServers <= MAX_PRINTED_SERVERS);
+
+    if (listServers) {
+        for (int i = 0; i < numServers; i++) {
+            printf("  Server %d: Capacity = %.2f\n", i, balancerServerCapacity(balancer, i));
+        }
+        printGraph(balancer);
+    }
+
+    printf("✓ Min-heap initialized with all servers\n");
+
+    // Replay streams the whole trace: its length replaces --tasks
+    if (run->replayPath) {
+        long long records = balancerTraceLength(run->replayPath);
+        if (records < 0) {
+            freeLoadBalancer(balancer);
+            return 1;
+        }
+        run->numTasks = (records < INT_MAX) ? (int)records : INT_MAX;
+        printf("✓ Replaying %d task arrivals from %s\n", run->numTasks, run->replayPath);
+    }
+
+    int exporting = 0;
+    if (config.metricsPath[0] != '\0') {
+        int started = balancerStartMetrics(config.metricsPath, config.metricsFormat,
+                                           config.metricsMs);
+        if (started < 0) {
+            freeLoadBalancer(balancer);
+            return 1;
+        }
+        if (started > 0) {
+            printf("Metrics are compiled out (LOAD_BALANCER_METRICS=0); ignoring --metrics\n");
+        }
+        exporting = (started == 0);
+    }
+
+    int monitoring = (config.monitorMs > 0 &&
+                      balancerStartMonitor(balancer, config.monitorMs) == 0);
+
+    // Two-level heaps over racks or topology components
+    if (config.hierarchy != HIERARCHY_OFF) {
+        int numGroups = balancerSetHierarchy(balancer, config.hierarchy, config.groupSize);
+        printf("✓ Hierarchy: %d groups (%s) under one top-level heap\n", numGroups,
+               (config.hierarchy == HIERARCHY_COMPONENTS) ? "topology components" : "racks");
+    }
+
+    // ========== TASK ASSIGNMENT PHASE ==========
+    SimulationStats runStats;
+    int runStatus = runTasks(balancer, run, config.vectorLoads, balancerConfig->logLevel,
+                             &runStats);
+
+    long snapshots = monitoring ? balancerStopMonitor(balancer) : 0;
+    long metricsExports = 0;
+    unsigned long long sifts = 0;
+    double siftLevels = 0.0;
+    if (exporting) {
+        metricsExports = balancerStopMetrics(&sifts, &siftLevels);
+    }
+
+    // An unreadable arrival trace leaves no run to report
+    if (runStatus < 0) {
+        freeLoadBalancer(balancer);
+        return 1;
+    }
+    if (runStatus > 0) {
+        status = 1;
+    }
+
+    // ========== FINAL STATE ==========
+    printf("\n╔════════════════════════════════════════════════════════════╗\n");
+    printf("║                    FINAL LOAD DISTRIBUTION                 ║\n");
+    printf("╚════════════════════════════════════════════════════════════╝\n");
+
+    if (listServers) {
+        printServerStates(balancer);
+    }
+
+    // Calculate final statistics
+    LoadBalancerStats stats;
+    balancerStats(balancer, &stats);
+    LoadSummary summary = summarizeLoads(balancer);
+    float imbalance = summary.maxLoad - summary.minLoad;
+
+    printf("\n--- Final Statistics ---\n");
+    printf("Average Load:    %.2f\n", summary.avgLoad);
+    printf("Max Load:        %.2f\n", summary.maxLoad);
+    printf("Min Load:        %.2f\n", summary.minLoad);
+    printf("Load Difference: %.2f\n", imbalance);
+    printf("Max/Avg Load:    %.3f\n",
+           summary.avgLoad > 0.0f ? summary.maxLoad / summary.avgLoad : 0.0f);
+    float avgUtil, maxUtil, minUtil;
+    const char* resource;
+    for (int d = 0; (resource = balancerResourceUtilization(balancer, d, &avgUtil, &maxUtil,
+                                                            &minUtil)) != NULL; d++) {
+        printf("%-8s util:   avg %.1f%%, max %.1f%%, min %.1f%%\n", resource,
+               avgUtil, maxUtil, minUtil);
+    }
+    if (run->engine == ENGINE_EVENTS) {
+        printf("Virtual Time:    %.3f s\n", runStats.virtualTime);
+        printf("Timed Events:    %lld processed (%.0f events/s)\n", runStats.eventsProcessed,
+               runStats.wallSeconds > 0.0
+                   ? runStats.eventsProcessed / runStats.wallSeconds : 0.0);
+        printf("Completed Tasks: %d (%d dropped, pool full)\n", runStats.tasksCompleted,
+               runStats.tasksDropped);
+    }
+    if (run->taskLifetime > 0 && run->engine == ENGINE_LOOP) {
+        printf("Completed Tasks: %lld (%lld still running)\n", stats.tasksCompleted,
+               stats.tasksAssigned - stats.tasksCompleted);
+    }
+    if (run->admission != ADMIT_ALL) {
+        int admittedLate = runStats.tasksQueued - runStats.tasksShed - runStats.tasksWaiting;
+        double meanWait = admittedLate > 0 ? runStats.queueWait / admittedLate : 0.0;
+        printf("Admission:       %d queued, %d rejected, %d shed, %d still waiting\n",
+               runStats.tasksQueued, runStats.tasksRejected, runStats.tasksShed,
+               runStats.tasksWaiting);
+        if (run->engine == ENGINE_EVENTS) {
+            printf("Queue Wait:      %.2f ms mean, max depth %d of %d\n", meanWait * 1000.0,
+                   runStats.maxQueueDepth, run->admissionQueue);
+        } else {
+            printf("Queue Wait:      %.1f arrivals mean, max depth %d of %d\n", meanWait,
+                   runStats.maxQueueDepth, run->admissionQueue);
+        }
+    }
+    printf("Rebalances:      %lld\n", stats.rebalances);
+    printf("Migrated Load:   %.2f\n", stats.migratedLoad);
+    if (balancerConfig->rebalanceMode == REBALANCE_TOPOLOGY) {
+        printf("Migration Cost:  %.2f load x hops\n", stats.migrationHopCost);
+    }
+    if (concurrent && runStats.wallSeconds > 0.0) {
+        printf("Throughput:      %.0f tasks/s (%d producer threads)\n",
+               run->numTasks / runStats.wallSeconds, run->numThreads);
+    }
+    if (balancerConfig->eventPath) {
+        printf("Events:          %lld written to %s (%ld writer stalls)\n",
+               stats.eventsWritten, balancerConfig->eventPath, stats.eventStalls);
+    }
+    if (runStats.arrivalsCaptured > 0) {
+        printf("Trace:           %lld arrivals captured to %s\n", runStats.arrivalsCaptured,
+               run->capturePath);
+    }
+    if (exporting) {
+        printf("Metrics:         %ld snapshot(s) to %s (%llu sifts, %.2f levels each)\n",
+               metricsExports, config.metricsPath, sifts, siftLevels);
+    }
+    if (stats.arenaBlocks > 0) {
+        printf("Arena:           %.2f MB in %d block(s)\n",
+               stats.arenaBytes / (1024.0 * 1024.0), stats.arenaBlocks);
+    }
+    if (monitoring) {
+        printf("Snapshots:       %ld\n", snapshots);
+    }
+    if (config.snapshotPath[0] != '\0') {
+        if (saveLoadBalancer(balancer, config.snapshotPath) == 0) {
+            printf("Saved State:     %d servers, %d links to %s\n", numServers,
+                   countLinks(balancer), config.snapshotPath);
+        } else {
+            status = 1;
+        }
+    }
+
+    if (imbalance < balancerConfig->rebalanceThreshold) {
+        printf("\n✓✓✓ System is WELL-BALANCED ✓✓✓\n");
+    } else {
+        printf("\n⚠ System could benefit from further rebalancing\n");
+    }
+
+    // ========== CLEANUP ==========
+    freeLoadBalancer(balancer);
+
+    printf("\n✓ Simulation complete. Resources freed.\n\n");
+
+    return status;
+}